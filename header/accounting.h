@@ -0,0 +1,17 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/ProgramStats.h"
+
+
+double WINAPI TscPerMicrosecond();
+
+BOOL   WINAPI EnableProgramAccounting(DWORD mode);
+void   WINAPI EnterProgramAccount    (uint programId);
+void   WINAPI LeaveProgramAccount    (uint programId);
+void   WINAPI ResetProgramAccount    (uint programId);
+int    WINAPI GetProgramStats        (PROGRAM_STATS stats[], int size);
+
+BOOL   WINAPI StartWatchdog          (uint interval, uint threshold);
+BOOL   WINAPI StopWatchdog();
+void   WINAPI ReleaseWatchdog();
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/ExecutionContext.h"
+#include "struct/xtrade/ReplayStats.h"
+
+
+/**
+ * Record of a captured call. The record is followed by the function's arguments (one of the CAPTURE_*_ARGS structs).
+ */
+#pragma pack(push, 1)
+struct CAPTURE_RECORD {                            // -- offset ---- size --- description ---------------------------------------------------
+   uint              function;                     //         0         4     CapturedFunction
+   uint              size;                         //         4         4     record size including the arguments
+   uint64            timestamp;                    //         8         8     TSC value at entry of the call
+   uint64            duration;                     //        16         8     TSC ticks of the call
+   DWORD             threadId;                     //        24         4     executing thread
+   uint              ecAddress;                    //        28         4     address of the passed context (identifies the context)
+   uint              programId;                    //        32         4     ec.programId after the call
+   EXECUTION_CONTEXT context;                      //        36       904     passed context at entry of the call
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 940
+
+
+/**
+ * Header of a capture file. The header is followed by CAPTURE_RECORDs in call order.
+ */
+#pragma pack(push, 1)
+struct CAPTURE_HEADER {                            // -- offset ---- size --- description ---------------------------------------------------
+   char   magic[4];                                //         0         4     "CAP1"
+   uint   contextSize;                             //         4         4     sizeof(EXECUTION_CONTEXT) of the capturing DLL
+   double tscPerMicro;                             //         8         8     TSC ticks per microsecond of the capturing machine
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 16
+
+
+// captured arguments
+#pragma pack(push, 1)
+struct CAPTURE_MAININIT_ARGS {
+   ProgramType        programType;
+   char               programName[MAX_PATH];
+   UninitializeReason uninitReason;
+   DWORD              initFlags;
+   DWORD              deinitFlags;
+   char               symbol[MAX_SYMBOL_LENGTH+1];
+   uint               period;
+   uint               sec;                                           // address of the super context
+   BOOL               isTesting;
+   BOOL               isVisualMode;
+   BOOL               isOptimization;
+   HWND               hChart;
+   int                droppedOnChart;
+   int                droppedOnPosX;
+   int                droppedOnPosY;
+};
+
+struct CAPTURE_START_ARGS {
+   datetime time;
+   double   bid;
+   double   ask;
+   uint     volume;
+};
+
+struct CAPTURE_DEINIT_ARGS {
+   UninitializeReason uninitReason;
+};
+
+struct CAPTURE_LIBINIT_ARGS {
+   UninitializeReason uninitReason;
+   DWORD              initFlags;
+   DWORD              deinitFlags;
+   char               moduleName[MAX_PATH];
+   char               symbol[MAX_SYMBOL_LENGTH+1];
+   uint               period;
+   BOOL               isOptimization;
+};
+
+struct CAPTURE_TESTDATA_ARGS {
+   datetime startTime;
+   datetime endTime;
+   double   bid;
+   double   ask;
+   uint     bars;
+   int      reportingId;
+   char     reportingSymbol[MAX_SYMBOL_LENGTH+1];
+};
+
+struct CAPTURE_OPENORDER_ARGS {
+   int      ticket;
+   int      type;
+   double   lots;
+   char     symbol[MAX_SYMBOL_LENGTH+1];
+   double   openPrice;
+   datetime openTime;
+   double   stopLoss;
+   double   takeProfit;
+   double   commission;
+   int      magicNumber;
+   char     comment[MAX_ORDER_COMMENT_LENGTH+1];
+};
+
+struct CAPTURE_CLOSEORDER_ARGS {
+   int      ticket;
+   double   closePrice;
+   datetime closeTime;
+   double   swap;
+   double   profit;
+};
+#pragma pack(pop)
+
+
+/**
+ * Scope guard recording an exported call while a capture is active (see Capture_Start()). Declared at the entry of a captured
+ * function, the caller fills the arguments if a capture is active and the destructor completes the record with the duration
+ * of the call and the resulting program id.
+ */
+struct CaptureScope {
+   CAPTURE_RECORD*    record;                                        // NULL if no capture is active
+   void*              args;                                          // arguments of the record or NULL
+   EXECUTION_CONTEXT* ec;
+
+   CaptureScope(CapturedFunction function, EXECUTION_CONTEXT* ec, uint argsSize);
+   ~CaptureScope();
+};
+
+
+void WINAPI CopyCaptureString(char* dest, const char* src, uint size);
+void WINAPI ReleaseCapture();
+BOOL WINAPI IsReplayThread();
+
+BOOL WINAPI Capture_Start(const char* fileName);
+BOOL WINAPI Capture_Stop();
+BOOL WINAPI Replay_Run   (const char* fileName, REPLAY_STATS* stats);
@@ -7,12 +7,16 @@
 // Context management functions
 BOOL             WINAPI SyncMainContext_init  (EXECUTION_CONTEXT* ec, ProgramType type, const char* name, UninitializeReason reason, DWORD initFlags, DWORD deinitFlags, const char* symbol, uint period, EXECUTION_CONTEXT* sec, BOOL isTesting, BOOL isVisualMode, BOOL isOptimization, HWND hChart, int droppedOnChart, int droppedOnPosX, int droppedOnPosY);
 BOOL             WINAPI SyncMainContext_start (EXECUTION_CONTEXT* ec, datetime time, double bid, double ask, uint volume);
+BOOL             WINAPI LeaveContext_start    (EXECUTION_CONTEXT* ec);
 BOOL             WINAPI SyncMainContext_deinit(EXECUTION_CONTEXT* ec, UninitializeReason reason);
 
 BOOL             WINAPI SyncLibContext_init   (EXECUTION_CONTEXT* ec, UninitializeReason uninitReason, DWORD initFlags, DWORD deinitFlags, const char* name, const char* symbol, uint period, BOOL isOptimization);
 BOOL             WINAPI SyncLibContext_deinit (EXECUTION_CONTEXT* ec, UninitializeReason uninitReason);
 
 BOOL             WINAPI LeaveContext          (EXECUTION_CONTEXT* ec);
+BOOL             WINAPI ReleaseProgram        (uint programId);
+uint             WINAPI FindPreviousTestExpert(DWORD threadId, uint programId);
+BOOL             WINAPI IsInitCycleReason     (UninitializeReason reason);
 
 int              WINAPI FindIndicatorInLimbo(HWND hChart, const char* name, UninitializeReason reason);
 HWND             WINAPI FindWindowHandle    (HWND hChart, const EXECUTION_CONTEXT* sec, ModuleType moduleType, const char* symbol, uint timeframe, BOOL isTesting, BOOL isVisualMode);
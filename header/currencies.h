@@ -0,0 +1,18 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/mt4/Symbol.h"
+#include "struct/mt4/SymbolSelected.h"
+
+
+#define MAX_CURRENCIES  64                                           // max. number of currencies of the currency graph
+
+
+int    WINAPI CurrencyGraph_Build      (const SYMBOL symbols[], int size);
+int    WINAPI CurrencyGraph_UpdateRates(const SYMBOL_SELECTED quotes[], int size);
+BOOL   WINAPI CurrencyGraph_UpdateRate (uint symbolId, double bid, double ask);
+
+uint   WINAPI GetProfitCurrency        (uint symbolId);
+uint   WINAPI GetMarginCurrency        (uint symbolId);
+double WINAPI GetConversionRate        (uint fromCurrency, uint toCurrency);
+int    WINAPI ConvertAmounts           (const uint currencies[], const double amounts[], int size, uint toCurrency, double results[]);
@@ -76,6 +76,96 @@ enum InitializeReason {                                     // +-- reason ------
 };                                                          // +-----------------------------------------------+-----------------+-------------+
 
 
+// Strategy Tester bar models
+enum BarModel {
+   BM_EVERYTICK         = 0,
+   BM_CONTROLPOINTS     = 1,
+   BM_BAROPEN           = 2
+};
+
+
+// program accounting modes (flags)
+enum AccountingMode {
+   AM_WALLTIME          = 1,                                // wall time, tick count and latencies of start() (TSC based)
+   AM_CPUTIME           = 2,                                // additionally CPU time of start() (two system calls per tick)
+   AM_WATCHDOG          = 4                                 // entry times of start() for the watchdog (set by StartWatchdog())
+};
+
+
+// context trace event types
+enum TraceEventType {
+   TE_SYNCMAIN_INIT     = 1,                                // SyncMainContext_init()
+   TE_SYNCMAIN_START    = 2,                                // SyncMainContext_start()
+   TE_SYNCMAIN_DEINIT   = 3,                                // SyncMainContext_deinit()
+   TE_SYNCLIB_INIT      = 4,                                // SyncLibContext_init()
+   TE_SYNCLIB_DEINIT    = 5,                                // SyncLibContext_deinit()
+   TE_LEAVE_START       = 6,                                // LeaveContext_start()
+   TE_LEAVE             = 7                                 // LeaveContext()
+};
+
+
+// exported functions recorded by the call capture
+enum CapturedFunction {
+   CF_SYNCMAIN_INIT     = 1,                                // SyncMainContext_init()
+   CF_SYNCMAIN_START    = 2,                                // SyncMainContext_start()
+   CF_SYNCMAIN_DEINIT   = 3,                                // SyncMainContext_deinit()
+   CF_SYNCLIB_INIT      = 4,                                // SyncLibContext_init()
+   CF_SYNCLIB_DEINIT    = 5,                                // SyncLibContext_deinit()
+   CF_LEAVE_START       = 6,                                // LeaveContext_start()
+   CF_LEAVE             = 7,                                // LeaveContext()
+   CF_COLLECTTESTDATA   = 8,                                // CollectTestData()
+   CF_TEST_OPENORDER    = 9,                                // Test_OpenOrder()
+   CF_TEST_CLOSEORDER   = 10                                // Test_CloseOrder()
+};
+
+
+// ORDER fields of a multi-key sort (negative values sort descending)
+enum OrderSortKey {
+   OSK_TICKET           = 1,
+   OSK_TYPE             = 2,
+   OSK_LOTS             = 3,
+   OSK_SYMBOL           = 4,
+   OSK_OPENPRICE        = 5,
+   OSK_OPENTIME         = 6,
+   OSK_CLOSEPRICE       = 7,
+   OSK_CLOSETIME        = 8,
+   OSK_PROFIT           = 9,                                // net profit (profit + swap + commission)
+   OSK_MAGICNUMBER      = 10,
+   OSK_COMMENT          = 11
+};
+
+
+// ORDER fields to group the order store by
+enum OrderGroupKey {
+   OGK_NONE             = 0,                                // a single group with all orders
+   OGK_SYMBOL           = 1,                                // interned symbol id
+   OGK_MAGICNUMBER      = 2,
+   OGK_CLOSEDAY         = 3                                 // start of the close day (server time)
+};
+
+
+// results of RiskEngine_CheckOrder()
+enum RiskCheckResult {
+   RC_ALLOW             = 0,                                // the order is within all limits
+   RC_SYMBOL_LOTS       = 1,                                // max. directional lots of the symbol exceeded
+   RC_GROUP_LOTS        = 2,                                // max. lots of the symbol's correlation group exceeded
+   RC_CURRENCY_EXPOSURE = 3,                                // max. exposure of a currency exceeded
+   RC_TOTAL_MARGIN      = 4,                                // max. total margin exceeded
+   RC_NO_RATE           = 5                                 // exposure or margin can't be evaluated (missing rates)
+};
+
+
+// status of a job of the process pool
+enum JobStatus {
+   JS_QUEUED            = 1,                                // waiting for a process slot
+   JS_RUNNING           = 2,
+   JS_FINISHED          = 3,                                // the process exited (see the exit code)
+   JS_FAILED            = 4,                                // the process could not be started
+   JS_TIMEOUT           = 5,                                // the process was terminated after the timeout
+   JS_KILLED            = 6                                 // the job was killed by JobPool_Kill()
+};
+
+
 // MQL program uninitialize reasons
 enum UninitializeReason {
    UR_UNDEFINED         = UNINITREASON_UNDEFINED,
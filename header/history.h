@@ -0,0 +1,44 @@
+#pragma once
+
+#include "expander.h"
+#include <vector>
+
+
+/**
+ * A read-only memory-mapped file.
+ */
+struct MAPPED_FILE {
+   HANDLE      hFile;
+   HANDLE      hMapping;
+   const BYTE* data;                                                 // start of the mapped view
+   uint        size;                                                 // file size in bytes
+};
+
+
+/**
+ * A decoded price sample of a history file (a bar) or of a tick file (a tick with open=high=low=close).
+ */
+struct PRICE_BAR {
+   datetime time;                                                    // bar open time or tick time (server time)
+   double   open;
+   double   high;
+   double   low;
+   double   close;
+};
+typedef std::vector<PRICE_BAR> PriceSeries;                          // price samples in ascending time order
+
+
+// history file types as detected by LoadPriceSeries()
+enum HistoryFileType {
+   HFT_UNKNOWN = 0,
+   HFT_HST_400 = 1,                                                  // "history/{server}/{symbol}{period}.hst", bar format 400
+   HFT_HST_401 = 2,                                                  // "history/{server}/{symbol}{period}.hst", bar format 401
+   HFT_FXT     = 3,                                                  // "tester/history/{symbol}{period}_{model}.fxt"
+   HFT_TICKS   = 4                                                   // "history/{server}/ticks.raw"
+};
+
+
+BOOL            WINAPI MapFile           (const char* fileName, MAPPED_FILE* mf);
+void            WINAPI UnmapFile         (MAPPED_FILE* mf);
+HistoryFileType WINAPI GetHistoryFileType(const MAPPED_FILE* mf);
+BOOL            WINAPI LoadPriceSeries   (const char* fileName, const char* symbol, datetime from, datetime to, PriceSeries& series, BOOL coverFrom = FALSE);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/JobInfo.h"
+
+
+#define MAX_JOB_CONCURRENCY   63                                     // max. number of concurrent processes (MAXIMUM_WAIT_OBJECTS-1)
+#define JOB_OUTPUT_SIZE       65536                                  // size of a job's output ring buffer in bytes
+
+
+int  WINAPI JobPool_SetConcurrency(int processes);
+int  WINAPI JobPool_Submit        (const char* cmdLine, const char* directory, int timeout);
+int  WINAPI JobPool_GetStatus     (int jobId);
+BOOL WINAPI JobPool_GetJobInfo    (int jobId, JOB_INFO* info);
+int  WINAPI JobPool_ReadOutput    (int jobId, char* buffer, int bufferSize);
+BOOL WINAPI JobPool_Kill          (int jobId);
+BOOL WINAPI JobPool_Release       (int jobId);
+void WINAPI ReleaseJobPool        ();
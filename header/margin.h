@@ -0,0 +1,10 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/mt4/Symbol.h"
+
+
+int    WINAPI MarginCalculator_Init(const SYMBOL symbols[], int size);
+uint   WINAPI GetBaseCurrency      (uint symbolId);
+double WINAPI GetContractSize      (uint symbolId);
+BOOL   WINAPI CalculateMarginSwap  (const uint symbolIds[], const int types[], const double lots[], const double openPrices[], int size, uint accountCurrency, int leverage, datetime rolloverTime, double margins[], double swaps[], double* totalMargin, double* totalSwap);
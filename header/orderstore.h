@@ -0,0 +1,11 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/Order.h"
+#include "struct/xtrade/OrderGroup.h"
+
+
+int  WINAPI OrderStore_AddOrders(const ORDER orders[], int size);
+BOOL WINAPI OrderStore_Reset    ();
+int  WINAPI OrderStore_Size     ();
+int  WINAPI OrderStore_GroupBy  (int groupBy, uint symbolId, BOOL magicFilter, int magicNumber, datetime from, datetime to, ORDER_GROUP results[], int size);
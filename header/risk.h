@@ -0,0 +1,16 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/RiskLimits.h"
+
+
+#define MAX_RISK_GROUPS  32                                          // max. number of correlation groups of the risk engine
+
+
+BOOL WINAPI RiskEngine_SetLimits          (const RISK_LIMITS* limits);
+BOOL WINAPI RiskEngine_SetSymbolLimit     (uint symbolId, double maxLots);
+BOOL WINAPI RiskEngine_SetCorrelationGroup(uint symbolId, int group, int sign);
+BOOL WINAPI RiskEngine_Reset              ();
+BOOL WINAPI RiskEngine_OnOrderOpen        (uint symbolId, int type, double lots, double openPrice);
+BOOL WINAPI RiskEngine_OnOrderClose       (uint symbolId, int type, double lots, double openPrice);
+int  WINAPI RiskEngine_CheckOrder         (uint symbolId, int type, double lots, double price, char* reason, int reasonSize);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/ExecutionContext.h"
+
+
+/**
+ * DLL-internal shadow of a program's master context. Holds the fields read by context walks (e.g. FindIndicatorInLimbo()) in
+ * a single cache line. The shared EXECUTION_CONTEXT spreads them over several cache lines between the 260-byte name arrays.
+ * Shadows are updated from the master context at the MQL boundary, i.e. at the end of each Sync*() and Leave*() call.
+ */
+struct __declspec(align(64)) PROGRAM_SHADOW {      // -- offset ---- size --- description ---------------------------------------------------
+   uint                     programId;             //         0         4     program id (0: unused slot)
+   ProgramType              programType;           //         4         4
+   RootFunction             rootFunction;          //         8         4
+   InitializeReason         initReason;            //        12         4
+   UninitializeReason       uninitReason;          //        16         4
+   DWORD                    threadId;              //        20         4
+   HWND                     hChart;                //        24         4
+   uint                     ticks;                 //        28         4
+   datetime                 currentTickTime;       //        32         4
+   datetime                 previousTickTime;      //        36         4
+   BOOL                     testing;               //        40         4
+   BOOL                     initCycle;             //        44         4
+   const EXECUTION_CONTEXT* master;                //        48         4     cold fields
+   uint                     reserved[3];           //        52        12
+};                                                 // -----------------------------------------------------------------------------------
+                                                   //                = 64
+
+const PROGRAM_SHADOW* WINAPI GetProgramShadow    (uint programId);
+void                  WINAPI SyncProgramShadow   (const EXECUTION_CONTEXT* master);
+void                  WINAPI ReleaseProgramShadow(uint programId);
+void                  WINAPI ReleaseProgramShadows();
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "expander.h"
+
+
+/**
+ * MT4 struct FXT_TICK (tick file record since version 405, builds >= 600)
+ *
+ * Each record holds the state of the current bar at the time of the tick. The price of the tick itself is 'close'.
+ *
+ * @see  MetaQuotes::TestHistory
+ */
+#pragma pack(push, 1)
+struct FXT_TICK {                                  // -- offset ---- size --- description -----------------------------------------
+   int64  barTime;                                 //         0         8     open time of the bar (timestamp)
+   double open;                                    //         8         8
+   double high;                                    //        16         8
+   double low;                                     //        24         8
+   double close;                                   //        32         8     price of the tick (Bid)
+   uint64 volume;                                  //        40         8     volume of the bar
+   uint   tickTime;                                //        48         4     time of the tick (timestamp)
+   uint   flag;                                    //        52         4     0=bar modified but expert not launched
+};                                                 // -------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 56
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "expander.h"
+
+
+/**
+ * XTrade struct ARRAY_STATS
+ *
+ * Descriptive statistics of an MQL double[] array as calculated by CalculateStats() and CalculateStatsEx(). Variance and
+ * standard deviation are population figures (divided by the number of values). Indexes are array indexes, ties resolve to the
+ * lowest index. Without values all fields are 0 and the indexes are EMPTY (-1).
+ */
+#pragma pack(push, 1)
+struct ARRAY_STATS {                               // -- offset ---- size --- description ---------------------------------------------------
+   int    count;                                   //         0         4     number of evaluated values
+   int    minIndex;                                //         4         4     index of the minimum
+   int    maxIndex;                                //         8         4     index of the maximum
+   double sum;                                     //        12         8     sum of the values
+   double mean;                                    //        20         8     arithmetic mean
+   double variance;                                //        28         8     population variance
+   double stdDev;                                  //        36         8     population standard deviation
+   double min;                                     //        44         8     minimum
+   double max;                                     //        52         8     maximum
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 60
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "expander.h"
+
+struct EXECUTION_CONTEXT;
+
+
+/**
+ * XTrade struct CONTEXT_SNAPSHOT
+ *
+ * Compact copy of the frequently used fields of an EXECUTION_CONTEXT, its master context and the calling thread. Filled by
+ * ec_Snapshot() with a single DLL call instead of one call per ec_* getter. Read by ec_SetSnapshot() to update the fields
+ * MQL may set (logging) at once.
+ */
+#pragma pack(push, 1)
+struct CONTEXT_SNAPSHOT {                          // -- offset ---- size --- description ---------------------------------------------------
+   uint               programId;                   //         0         4     ec.programId
+   ProgramType        programType;                 //         4         4     ec.programType
+   ModuleType         moduleType;                  //         8         4     ec.moduleType
+   LaunchType         launchType;                  //        12         4     ec.launchType
+   RootFunction       rootFunction;                //        16         4     ec.rootFunction
+   BOOL               initCycle;                   //        20         4     ec.initCycle
+   InitializeReason   initReason;                  //        24         4     ec.initReason
+   UninitializeReason uninitReason;                //        28         4     ec.uninitReason
+   BOOL               testing;                     //        32         4     ec.testing
+   BOOL               visualMode;                  //        36         4     ec.visualMode
+   BOOL               optimization;                //        40         4     ec.optimization
+   DWORD              initFlags;                   //        44         4     ec.initFlags
+   DWORD              deinitFlags;                 //        48         4     ec.deinitFlags
+   BOOL               logging;                     //        52         4     ec.logging                    (set by ec_SetSnapshot)
+   char               symbol[MAX_SYMBOL_LENGTH+1]; //        56        12     ec.symbol
+   uint               timeframe;                   //        68         4     ec.timeframe
+   HWND               hChart;                      //        72         4     ec.hChart
+   HWND               hChartWindow;                //        76         4     ec.hChartWindow
+   EXECUTION_CONTEXT* superContext;                //        80         4     ec.superContext
+   uint               threadId;                    //        84         4     ec.threadId
+   uint               ticks;                       //        88         4     ec.ticks
+   datetime           currentTickTime;             //        92         4     ec.currentTickTime
+   datetime           previousTickTime;            //        96         4     ec.previousTickTime
+   int                mqlError;                    //       100         4     ec.mqlError
+   int                dllError;                    //       104         4     ec.dllError
+   int                dllWarning;                  //       108         4     ec.dllWarning
+   RootFunction       masterRootFunction;          //       112         4     master.rootFunction           (0 without master context)
+   UninitializeReason masterUninitReason;          //       116         4     master.uninitReason
+   DWORD              masterInitFlags;             //       120         4     master.initFlags
+   int                masterMqlError;              //       124         4     master.mqlError
+   int                masterDllError;              //       128         4     master.dllError
+   uint               currentThreadId;             //       132         4     id of the calling thread
+   BOOL               isUIThread;                  //       136         4     whether the calling thread is the UI thread
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 140
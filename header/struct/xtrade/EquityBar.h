@@ -0,0 +1,25 @@
+#pragma once
+
+#include "expander.h"
+#include <vector>
+
+
+/**
+ * XTrade struct EQUITY_BAR
+ *
+ * Account state of a test at the close of a price bar, reconstructed from the order history (mark-to-market). The equity
+ * range of the bar is evaluated at the bar's high and low with the positions held at the bar's close.
+ */
+#pragma pack(push, 1)
+struct EQUITY_BAR {                                // -- offset ---- size --- description ---------------------------------------------------
+   datetime time;                                  //         0         4     open time of the price bar
+   double   balance;                               //         4         8     balance at the bar's close (closed trades only)
+   double   equity;                                //        12         8     equity at the bar's close (balance + floating profit)
+   double   equityHigh;                            //        20         8     highest equity during the bar
+   double   equityLow;                             //        28         8     lowest equity during the bar
+   double   margin;                                //        36         8     used margin at the bar's close
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 44
+
+
+typedef std::vector<EQUITY_BAR> EquitySeries;
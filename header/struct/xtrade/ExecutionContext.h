@@ -1,5 +1,6 @@
 #pragma once
 
+#include "struct/xtrade/ContextSnapshot.h"
 #include "struct/xtrade/Test.h"
 
 
@@ -159,6 +160,11 @@ int                WINAPI ec_SetDllWarning        (EXECUTION_CONTEXT* ec, int
 //                        ...
 
 
+// Bulk access
+BOOL               WINAPI ec_Snapshot   (const EXECUTION_CONTEXT* ec, CONTEXT_SNAPSHOT* snapshot);
+BOOL               WINAPI ec_SetSnapshot(EXECUTION_CONTEXT* ec, const CONTEXT_SNAPSHOT* snapshot);
+
+
 // Master context getters
 RootFunction       WINAPI mec_RootFunction(const EXECUTION_CONTEXT* ec);
 UninitializeReason WINAPI mec_UninitReason(const EXECUTION_CONTEXT* ec);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "expander.h"
+
+
+/**
+ * XTrade struct JOB_INFO
+ *
+ * Status and timings of a job of the process pool (see JobPool_GetJobInfo()). Times are measured with GetTickCount().
+ */
+#pragma pack(push, 1)
+struct JOB_INFO {                                  // -- offset ---- size --- description ---------------------------------------------------
+   int  id;                                        //         0         4     job id
+   int  status;                                    //         4         4     JobStatus
+   uint exitCode;                                  //         8         4     exit code of the process (valid if the job is no longer running)
+   uint queueTime;                                 //        12         4     milliseconds from submission to the start of the process
+   uint runTime;                                   //        16         4     milliseconds the process was running (so far)
+   uint outputSize;                                //        20         4     total number of bytes written by the process to stdout/stderr
+   uint outputDropped;                             //        24         4     number of bytes overwritten in the ring buffer before they were read
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 28
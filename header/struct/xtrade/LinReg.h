@@ -0,0 +1,42 @@
+#pragma once
+
+#include "expander.h"
+
+
+/**
+ * XTrade struct LINREG_FIT
+ *
+ * Least-squares line over a window of values (x = 0 for the oldest value, 1 per value). Regression channels are drawn at
+ * value +/- k*stdError, slope filters use the slope.
+ */
+#pragma pack(push, 1)
+struct LINREG_FIT {                                // -- offset ---- size --- description ---------------------------------------------------
+   int    count;                                   //         0         4     number of values in the window (< period during warm-up)
+   double slope;                                   //         4         8     slope per value
+   double value;                                   //        12         8     value of the line at the newest value of the window
+   double stdError;                                //        20         8     standard error of the residuals (sqrt(SSE/(n-2)))
+   double r2;                                      //        28         8     coefficient of determination
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 36
+
+
+/**
+ * XTrade struct LINREG_STATE
+ *
+ * Running sums of a sliding regression window over an MQL double[] array, updated by LinReg_Update() in O(1) per new value.
+ * The window's values stay in the caller's array, which provides the values leaving the window. All sums are taken of the
+ * values minus 'origin', which is periodically moved to the window's mean (recentering).
+ */
+#pragma pack(push, 1)
+struct LINREG_STATE {                              // -- offset ---- size --- description ---------------------------------------------------
+   int    period;                                  //         0         4     window length
+   int    last;                                    //         4         4     array index of the newest value in the sums (-1: empty)
+   int    count;                                   //         8         4     number of values in the sums
+   int    slides;                                  //        12         4     updates since the last recentering
+   double origin;                                  //        16         8     offset subtracted from all values
+   double lastValue;                               //        24         8     newest value as added to the sums
+   double sumY;                                    //        32         8     sum(y - origin)
+   double sumXY;                                   //        40         8     sum(x * (y - origin))
+   double sumYY;                                   //        48         8     sum((y - origin)^2)
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 56
@@ -35,4 +35,17 @@ typedef std::vector<ORDER> OrderVector;
 typedef OrderVector        OrderHistory;
 
 
+// comparators sorting indexes of an OrderHistory by open and close time
+struct OrderOpenTimeLess {
+   const OrderHistory& orders;
+   OrderOpenTimeLess(const OrderHistory& orders) : orders(orders) {}
+   bool operator()(uint a, uint b) const { return(orders[a].openTime < orders[b].openTime); }
+};
+struct OrderCloseTimeLess {
+   const OrderHistory& orders;
+   OrderCloseTimeLess(const OrderHistory& orders) : orders(orders) {}
+   bool operator()(uint a, uint b) const { return(orders[a].closeTime < orders[b].closeTime); }
+};
+
+
 const char* WINAPI ORDER_toStr(const ORDER* order, BOOL outputDebug=FALSE);
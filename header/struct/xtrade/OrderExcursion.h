@@ -0,0 +1,27 @@
+#pragma once
+
+#include "expander.h"
+#include <vector>
+
+
+/**
+ * XTrade struct ORDER_EXCURSION
+ *
+ * Maximum adverse and favorable price excursion of an ORDER during its lifetime. Array elements correspond one-to-one to the
+ * elements of the analyzed OrderHistory (same index). Excursions are measured in price units and are never negative.
+ */
+#pragma pack(push, 1)
+struct ORDER_EXCURSION {                           // -- offset ---- size --- description ---------------------------------------------------
+   int      ticket;                                //         0         4     ticket of the analyzed order (0: order was not analyzed)
+   double   mae;                                   //         4         8     maximum adverse excursion
+   double   mfe;                                   //        12         8     maximum favorable excursion
+   datetime maeTime;                               //        20         4     time of the MAE (0: no adverse excursion)
+   datetime mfeTime;                               //        24         4     time of the MFE (0: no favorable excursion)
+   uint     timeToMfe;                             //        28         4     seconds from the order's open time to the MFE
+   double   drawdown;                              //        32         8     maximum intra-trade drawdown from the running MFE
+   uint     samples;                               //        40         4     number of price samples covered by the order
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 44
+
+
+typedef std::vector<ORDER_EXCURSION> ExcursionVector;
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "expander.h"
+
+
+/**
+ * XTrade struct ORDER_GROUP
+ *
+ * Aggregated closed orders of a group of the order store (see OrderStore_GroupBy()).
+ */
+#pragma pack(push, 1)
+struct ORDER_GROUP {                               // -- offset ---- size --- description ---------------------------------------------------
+   int    key;                                     //         0         4     group key: symbol id, magic number or day (0: OGK_NONE)
+   int    count;                                   //         4         4     number of orders
+   double lots;                                    //         8         8     sum of the order sizes
+   double profit;                                  //        16         8     sum of the gross profits
+   double commission;                              //        24         8     sum of the commissions
+   double swap;                                    //        32         8     sum of the swaps
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 40
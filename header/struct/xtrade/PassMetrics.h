@@ -0,0 +1,22 @@
+#pragma once
+
+#include "expander.h"
+
+
+/**
+ * XTrade struct PASS_METRICS
+ *
+ * Summary metrics of a test pass calculated from its closed orders.
+ */
+#pragma pack(push, 1)
+struct PASS_METRICS {                              // -- offset ---- size --- description ---------------------------------------------------
+   int    trades;                                  //         0         4     number of closed market orders
+   double profit;                                  //         4         8     net profit (profit + swap + commission)
+   double grossProfit;                             //        12         8     sum of all winning trades
+   double grossLoss;                               //        20         8     sum of all losing trades (non-positive)
+   double profitFactor;                            //        28         8     grossProfit/-grossLoss (0: no losses)
+   double maxDrawdown;                             //        36         8     maximum drawdown of the closed-trade balance curve
+   double winRate;                                 //        44         8     ratio of winning trades
+   uint   duration;                                //        52         4     duration of the test pass in milliseconds
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 56
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "expander.h"
+
+
+#define PROGRAM_STATS_BUCKETS    16                                  // number of latency histogram buckets
+
+
+/**
+ * XTrade struct PROGRAM_STATS
+ *
+ * Snapshot of the accounting figures of an MQL program's start() function (see EnableProgramAccounting()) and of stalls
+ * detected by the watchdog (see StartWatchdog()). Times cover the span from SyncMainContext_start() to LeaveContext_start(). Latency bucket 0 counts ticks faster than 1 microsecond, bucket
+ * i counts ticks of [2^(i-1), 2^i) microseconds, the last bucket all slower ticks (from 16.384 milliseconds).
+ */
+#pragma pack(push, 1)
+struct PROGRAM_STATS {                             // -- offset ---- size --- description ---------------------------------------------------
+   uint   programId;                               //         0         4     program id
+   char   programName[MAX_PATH];                   //         4       260     program name
+   uint   ticks;                                   //       264         4     number of accounted start() calls
+   double wallTime;                                //       268         8     accumulated wall time in milliseconds
+   double cpuTime;                                 //       276         8     accumulated CPU time in milliseconds (only with AM_CPUTIME)
+   double maxLatency;                              //       284         8     maximum wall time of a single call in milliseconds
+   uint   latencies[PROGRAM_STATS_BUCKETS];        //       292        64     latency histogram (number of calls per bucket)
+   uint   stalls;                                  //       356         4     number of start() calls flagged by the watchdog
+   uint   stalledFor;                              //       360         4     milliseconds the current start() call is stalled (0: not stalled)
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 364
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "expander.h"
+
+
+#define CAPTURED_FUNCTIONS    11                                     // size of per-function arrays (index = CapturedFunction)
+
+
+/**
+ * XTrade struct REPLAY_STATS
+ *
+ * Results of the replay of a call capture (see Replay_Run()). A mismatch is a call resulting in a different program id than
+ * in the capture (program ids are translated between capture and replay).
+ */
+#pragma pack(push, 1)
+struct REPLAY_STATS {                              // -- offset ---- size --- description ---------------------------------------------------
+   uint   calls;                                   //         0         4     number of replayed calls
+   uint   failures;                                //         4         4     number of calls returning FALSE
+   uint   mismatches;                              //         8         4     number of calls with a result different from the capture
+   double capturedTime;                            //        12         8     duration of all calls during capture in milliseconds
+   double replayedTime;                            //        20         8     duration of all calls during replay in milliseconds
+   uint   functionCalls[CAPTURED_FUNCTIONS];       //        28        44     number of calls per function
+   double functionTime[CAPTURED_FUNCTIONS];        //        72        88     replay duration per function in milliseconds
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 160
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "expander.h"
+
+
+/**
+ * XTrade struct RISK_LIMITS
+ *
+ * Portfolio limits of the pre-trade risk engine. A limit of 0 is not checked.
+ */
+#pragma pack(push, 1)
+struct RISK_LIMITS {                               // -- offset ---- size --- description ---------------------------------------------------
+   uint   accountCurrency;                         //         0         4     interned id of the account currency
+   int    leverage;                                //         4         4     account leverage
+   double maxSymbolLots;                           //         8         8     max. directional lots per symbol (default for all symbols)
+   double maxGroupLots;                            //        16         8     max. directional lots per correlation group
+   double maxCurrencyExposure;                     //        24         8     max. net exposure per currency in account currency
+   double maxTotalMargin;                          //        32         8     max. total margin in account currency
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 40
@@ -28,7 +28,7 @@ struct TEST {                                            // - size --- descripti
    uint          duration;                               //      4     test duration in milliseconds
    OrderHistory* orders;                                 //      4     array of orders
 };                                                       // -------------------------------------------------------------------
-#pragma pack(pop)
+#pragma pack(pop)                                        //    = 360
 
 
 // Getters
@@ -44,11 +44,11 @@ const char* WINAPI test_SetSymbol         (TEST* test, const char* symbol   );
 uint        WINAPI test_SetTimeframe      (TEST* test, uint        timeframe);
 datetime    WINAPI test_SetStartTime      (TEST* test, datetime    time     );
 datetime    WINAPI test_SetEndTime        (TEST* test, datetime    time     );
-//uint      WINAPI test_SetBarModel       (TEST* test, uint        type     );   // TODO
+uint        WINAPI test_SetBarModel       (TEST* test, uint        type     );
 double      WINAPI test_SetSpread         (TEST* test, double      spread   );
 uint        WINAPI test_SetBars           (TEST* test, uint        bars     );
 uint        WINAPI test_SetTicks          (TEST* test, uint        ticks    );
-//uint      WINAPI test_SetTradeDirections(TEST* test, uint        types    );   // TODO
+uint        WINAPI test_SetTradeDirections(TEST* test, uint        types    );
 BOOL        WINAPI test_SetVisualMode     (TEST* test, BOOL        status   );
 uint        WINAPI test_SetDuration       (TEST* test, uint        duration );
 
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "expander.h"
+
+
+#define TICK_JITTER_BUCKETS      16                                  // number of jitter histogram buckets
+
+
+/**
+ * XTrade struct TICK_TIMER_STATS
+ *
+ * Jitter statistics of a high-resolution tick timer (see SetupHighResTickTimer()). The jitter of a tick is its delay after
+ * the scheduled time. Jitter bucket 0 counts ticks sent within 1 microsecond, bucket i counts ticks of [2^(i-1), 2^i)
+ * microseconds, the last bucket all later ticks (from 16.384 milliseconds).
+ */
+#pragma pack(push, 1)
+struct TICK_TIMER_STATS {                          // -- offset ---- size --- description ---------------------------------------------------
+   uint   timerId;                                 //         0         4     timer id
+   uint   period;                                  //         4         4     timer period in milliseconds
+   uint   ticks;                                   //         8         4     number of sent ticks
+   uint   missed;                                  //        12         4     number of skipped periods (the thread woke up more than a period late)
+   double meanJitter;                              //        16         8     mean jitter in microseconds
+   double stdDevJitter;                            //        24         8     standard deviation of the jitter in microseconds
+   double maxJitter;                               //        32         8     maximum jitter in microseconds
+   uint   jitters[TICK_JITTER_BUCKETS];            //        40        64     jitter histogram (number of ticks per bucket)
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 104
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "expander.h"
+
+
+/**
+ * XTrade struct TRACE_EVENT
+ *
+ * A context transition recorded in the per-thread trace rings (see TraceContext()). Fields hold the state of the passed
+ * EXECUTION_CONTEXT after the transition, except for TE_LEAVE which is recorded on entry of LeaveContext().
+ */
+#pragma pack(push, 1)
+struct TRACE_EVENT {                               // -- offset ---- size --- description ---------------------------------------------------
+   uint64 timestamp;                               //         0         8     TSC value of the event
+   DWORD  threadId;                                //         8         4     executing thread
+   uint   programId;                               //        12         4     program id of the context
+   BYTE   type;                                    //        16         1     TraceEventType
+   BYTE   moduleType;                              //        17         1     ModuleType of the context
+   BYTE   rootFunction;                            //        18         1     RootFunction of the context
+   BYTE   initReason;                              //        19         1     InitializeReason of the context
+   BYTE   uninitReason;                            //        20         1     UninitializeReason of the context
+   BYTE   reserved[3];                             //        21         3
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 24
+
+
+/**
+ * Header of a trace dump file. The header is followed by the recorded events of all threads in ascending timestamp order.
+ */
+#pragma pack(push, 1)
+struct TRACE_DUMP_HEADER {                         // -- offset ---- size --- description ---------------------------------------------------
+   char   magic[4];                                //         0         4     "TRC1"
+   uint   events;                                  //         4         4     number of events in the file
+   uint64 timestamp;                               //         8         8     TSC value at the time of the dump
+   DWORD  tickCount;                               //        16         4     GetTickCount() at the time of the dump
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 20
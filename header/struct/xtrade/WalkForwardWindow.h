@@ -0,0 +1,21 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/PassMetrics.h"
+
+
+/**
+ * XTrade struct WALKFORWARD_WINDOW
+ *
+ * Results of a window of a walk-forward analysis (see Test_RunWalkForward()).
+ */
+#pragma pack(push, 1)
+struct WALKFORWARD_WINDOW {                        // -- offset ---- size --- description ---------------------------------------------------
+   datetime     inSampleFrom;                      //         0         4     start time of the in-sample window
+   datetime     outOfSampleFrom;                   //         4         4     start time of the out-of-sample window (end of the in-sample window)
+   datetime     outOfSampleTo;                     //         8         4     end time of the out-of-sample window (exclusive)
+   double       efficiency;                        //        12         8     out-of-sample profit per day / in-sample profit per day
+   PASS_METRICS inSampleMetrics;                   //        20        56     metrics of the selected parameters in the in-sample window
+   PASS_METRICS outOfSampleMetrics;                //        76        56     metrics of the selected parameters in the out-of-sample window
+};                                                 // -----------------------------------------------------------------------------------
+#pragma pack(pop)                                  //                = 132
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "expander.h"
+
+
+#define MAX_INTERNED_SYMBOLS  4095                                   // max. number of interned symbols (ids 1...4095)
+
+
+uint        WINAPI InternSymbol   (const char* symbol);
+uint        WINAPI FindSymbolId   (const char* symbol);
+const char* WINAPI GetSymbolName  (uint id);
+uint        WINAPI GetSymbolsCount();
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "expander.h"
+#include "history.h"
+#include "struct/mt4/Symbol.h"
+#include "struct/xtrade/EquityBar.h"
+#include "struct/xtrade/ExecutionContext.h"
+
+
+BOOL WINAPI CalculateEquityCurve(const OrderHistory& orders, const PriceSeries& prices, const SYMBOL* symbol, double tickValue, uint leverage, double initialBalance, EquitySeries& series);
+BOOL WINAPI SaveEquityCurve     (const EquitySeries& series, const char* symbol, uint timeframe, const char* fileName);
+int  WINAPI Test_SaveEquityCurve(const EXECUTION_CONTEXT* ec, const char* priceFile, uint timeframe, const SYMBOL* symbol, double tickValue, uint leverage, double initialBalance, const char* serverName);
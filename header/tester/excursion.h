@@ -0,0 +1,10 @@
+#pragma once
+
+#include "expander.h"
+#include "history.h"
+#include "struct/xtrade/ExecutionContext.h"
+#include "struct/xtrade/OrderExcursion.h"
+
+
+BOOL WINAPI CalculateExcursions     (const OrderHistory& orders, const PriceSeries& prices, ExcursionVector& results);
+int  WINAPI Test_CalculateExcursions(const EXECUTION_CONTEXT* ec, const char* fileName, ORDER_EXCURSION results[], int size);
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/Order.h"
+#include "struct/xtrade/PassMetrics.h"
+
+
+BOOL WINAPI CalculatePassMetrics(const OrderHistory& orders, PASS_METRICS* metrics);
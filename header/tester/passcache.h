@@ -0,0 +1,11 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/ExecutionContext.h"
+#include "struct/xtrade/PassMetrics.h"
+
+
+BOOL WINAPI MemoizePass           (const EXECUTION_CONTEXT* ec, const TEST* test);
+void WINAPI ReleasePendingPass    (uint programId);
+int  WINAPI Test_RecallPass       (const EXECUTION_CONTEXT* ec, const char* fxtFile, const char* inputs, double spread, PASS_METRICS* metrics);
+int  WINAPI Test_GetPassCacheStats(int* hits, int* misses);
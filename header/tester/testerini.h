@@ -0,0 +1,20 @@
+#pragma once
+
+#include "expander.h"
+
+
+// settings of a tester .ini file "tester/{expert}.ini"
+struct TESTER_INI {
+   uint64 lastWrite;                                                 // modification time of the parsed file version
+   uint64 size;                                                      // file size of the parsed file version
+   int    barModel;                                                  // bar model or EMPTY (-1) if not specified
+   uint   tradeDirections;                                           // TRADE_DIRECTIONS_* or 0 if not specified
+   string inputs;                                                    // normalized input parameters
+};
+
+
+string WINAPI NormalizeInputs (const string& inputs);
+BOOL   WINAPI GetTesterIni    (const char* expert, TESTER_INI& ini);
+BOOL   WINAPI ReadTesterInputs(const char* expert, string& inputs);
+string WINAPI FindTestFxtFile (const char* symbol, uint timeframe);
+int    WINAPI GetFxtBarModel  (const string& fileName);
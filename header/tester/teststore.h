@@ -0,0 +1,16 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/Test.h"
+
+
+void WINAPI InitTestStore       ();
+void WINAPI ReleaseTestStore    ();
+BOOL WINAPI StoreTest           (TEST* test, const string& inputs);
+BOOL WINAPI LoadStoredTest      (int testId, TEST* test, OrderHistory* orders, string* inputs);
+
+int  WINAPI TestStore_Query     (const char* strategy, const char* symbol, uint timeframe, int reportingId, datetime from, datetime to, TEST results[], int size);
+int  WINAPI TestStore_GetOrders (int testId, ORDER orders[], int size);
+int  WINAPI TestStore_GetInputs (int testId, char* buffer, int bufferSize);
+BOOL WINAPI TestStore_DeleteTest(int testId);
+BOOL WINAPI TestStore_Compact();
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "expander.h"
+#include "history.h"
+#include "struct/xtrade/Order.h"
+#include "struct/xtrade/PassMetrics.h"
+#include "struct/xtrade/WalkForwardWindow.h"
+#include <vector>
+
+
+/**
+ * Strategy callback of a walk-forward analysis. Runs the strategy with the passed parameters over the price samples in the
+ * range [from, to) and adds the resulting orders to 'orders'. Samples before 'from' may be used as look-back data. The callback
+ * is called concurrently from multiple threads and must not modify shared state.
+ *
+ * @param  PriceSeries&  prices     - all price samples of the analysis
+ * @param  uint          from       - index of the first sample to trade
+ * @param  uint          to         - index after the last sample to trade
+ * @param  double        params[]   - strategy parameters
+ * @param  uint          paramsSize - number of parameters
+ * @param  OrderHistory& orders     - vector receiving the orders
+ * @param  void*         context    - user data passed with the configuration
+ *
+ * @return BOOL - success status
+ */
+typedef BOOL (WINAPI* WalkForwardStrategy)(const PriceSeries& prices, uint from, uint to, const double params[], uint paramsSize, OrderHistory& orders, void* context);
+
+
+// range of a strategy parameter in the parameter grid
+struct WF_PARAMETER {
+   double from;
+   double to;                                                        // inclusive
+   double step;                                                      // 0: only 'from' is tested
+};
+
+
+// selection metrics of the in-sample optimization
+enum WalkForwardMetric {
+   WFM_PROFIT        = 0,                                            // net profit
+   WFM_PROFITFACTOR  = 1,                                            // profit factor
+   WFM_RECOVERY      = 2,                                            // net profit / max. drawdown
+   WFM_WINRATE       = 3                                             // ratio of winning trades
+};
+
+
+// configuration of a walk-forward analysis
+struct WF_CONFIG {
+   WalkForwardStrategy       strategy;
+   void*                     context;                                // user data passed to the strategy
+   std::vector<WF_PARAMETER> grid;                                   // parameter grid (all combinations are tested)
+   uint                      inSample;                               // length of the in-sample windows in seconds
+   uint                      outOfSample;                            // length of the out-of-sample windows in seconds
+   WalkForwardMetric         metric;                                 // selection metric of the in-sample optimization
+   uint                      threads;                                // number of worker threads (0: number of processors)
+};
+
+
+// result of a walk-forward window
+struct WF_WINDOW {
+   datetime            inSampleFrom;
+   datetime            outOfSampleFrom;                              // = end of the in-sample window
+   datetime            outOfSampleTo;
+   std::vector<double> params;                                       // selected parameters
+   PASS_METRICS        inSampleMetrics;
+   PASS_METRICS        outOfSampleMetrics;
+   double              efficiency;                                   // out-of-sample profit per day / in-sample profit per day
+};
+
+
+// result of a walk-forward analysis
+struct WF_RESULT {
+   std::vector<WF_WINDOW> windows;
+   OrderHistory           orders;                                    // stitched out-of-sample orders of all windows
+   PASS_METRICS           metrics;                                   // metrics of the stitched out-of-sample orders
+   double                 efficiency;                                // overall walk-forward efficiency
+};
+
+
+BOOL WINAPI RunWalkForward    (const PriceSeries& prices, const WF_CONFIG& config, WF_RESULT& result);
+int  WINAPI Test_RunWalkForward(const char* priceFile, const char* symbol, const char* module, const char* function, const WF_PARAMETER grid[], int gridSize, uint inSample, uint outOfSample, int metric, uint threads, WALKFORWARD_WINDOW windows[], double params[], int size, PASS_METRICS* metrics, double* efficiency);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/ExecutionContext.h"
+#include "struct/xtrade/TraceEvent.h"
+
+
+BOOL WINAPI InitTrace();
+void WINAPI ReleaseTrace();
+void WINAPI ReleaseThreadTrace();
+void WINAPI TraceContext(TraceEventType type, const EXECUTION_CONTEXT* ec);
+void WINAPI OnTraceError();
+
+BOOL WINAPI Trace_Dump        (const char* fileName);
+BOOL WINAPI Trace_SetErrorDump(const char* fileName);
@@ -12,6 +12,8 @@ BOOL          WINAPI IsCustomTimeframe(int timeframe);
 HWND          WINAPI GetApplicationWindow();
 DWORD         WINAPI GetUIThreadId();
 BOOL          WINAPI IsUIThread();
+HANDLE        WINAPI CreateWorkerThread(LPTHREAD_START_ROUTINE worker, LPVOID arg);
+void          WINAPI ExitWorkerThread();
 HANDLE        WINAPI GetWindowProperty(HWND hWnd, const char* lpName);
 HANDLE        WINAPI RemoveWindowProperty(HWND hWnd, const char* lpName);
 BOOL          WINAPI SetWindowProperty(HWND hWnd, const char* lpName, HANDLE value);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "expander.h"
+
+
+#define MAX_PORTFOLIO_ASSETS     64                                  // max. number of assets of the matrix functions
+#define MAX_SOLVER_ITERATIONS 10000                                  // max. iterations of the weight solvers
+#define SOLVER_TOLERANCE      1e-10                                  // max. weight change of a converged solver
+
+
+BOOL WINAPI CalculateCovariance(const double returns[], int samples, int assets, double covariance[]);
+BOOL WINAPI CholeskyDecompose  (const double matrix[], int size, double lower[]);
+BOOL WINAPI CholeskySolve      (const double lower[], int size, const double b[], double x[]);
+int  WINAPI MinVarianceWeights (const double covariance[], int assets, BOOL longOnly, double weights[]);
+int  WINAPI RiskParityWeights  (const double covariance[], int assets, const double budgets[], double weights[]);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/LinReg.h"
+
+
+BOOL WINAPI LinReg_Init   (LINREG_STATE* state, int period);
+BOOL WINAPI LinReg_Update (LINREG_STATE* state, const double values[], int size, LINREG_FIT* fit);
+BOOL WINAPI LinReg_Array  (const double values[], int size, int period, LINREG_FIT fits[]);
+int  WINAPI LinReg_History(const char* fileName, const char* symbol, datetime from, datetime to, int period, LINREG_FIT fits[], int size);
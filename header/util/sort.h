@@ -0,0 +1,12 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/Order.h"
+
+
+BOOL WINAPI SortInts       (int values[], int size);
+BOOL WINAPI SortDoubles    (double values[], int size);
+BOOL WINAPI ArgSortInts    (const int values[], int size, int indexes[]);
+BOOL WINAPI ArgSortDoubles (const double values[], int size, int indexes[]);
+BOOL WINAPI ArgSortOrders  (const ORDER orders[], int size, const int keys[], int keysSize, int indexes[]);
+BOOL WINAPI SortOrders     (ORDER orders[], int size, const int keys[], int keysSize);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "expander.h"
+#include "struct/xtrade/ArrayStats.h"
+
+
+BOOL WINAPI CalculateStats        (const double values[], int size, ARRAY_STATS* stats);
+BOOL WINAPI CalculateStatsEx      (const double values[], int size, double emptyValue, ARRAY_STATS* stats);
+BOOL WINAPI CalculatePercentiles  (const double values[], int size, const double percents[], int count, double results[]);
+BOOL WINAPI CalculatePercentilesEx(const double values[], int size, double emptyValue, const double percents[], int count, double results[]);
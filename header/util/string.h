@@ -4,9 +4,18 @@
 #include "struct/mt4/MqlStr.h"
 
 
-const char* WINAPI GetString        (const char* value);
-uint        WINAPI GetStringAddress (const char* value);
-uint        WINAPI GetStringsAddress(const MqlStr values[]);
-BOOL        WINAPI StringCompare    (const char* s1, const char* s2);
-BOOL        WINAPI StringEndsWith   (const char* str, const char* suffix);
-BOOL        WINAPI StringIsNull     (const char* value);
+const char* WINAPI GetString         (const char* value);
+uint        WINAPI GetStringAddress  (const char* value);
+uint        WINAPI GetStringsAddress (const MqlStr values[]);
+BOOL        WINAPI StringCompare     (const char* s1, const char* s2);
+BOOL        WINAPI StringCompareI    (const char* s1, const char* s2);
+int         WINAPI StringCount       (const char* str, const char* substr, BOOL ignoreCase);
+BOOL        WINAPI StringEndsWith    (const char* str, const char* suffix);
+int         WINAPI StringFindEx      (const char* str, const char* substr, int start, BOOL ignoreCase);
+BOOL        WINAPI StringIsNull      (const char* value);
+int         WINAPI StringReplaceAll  (const char* str, const char* search, const char* replace, BOOL ignoreCase, char* buffer, int bufferSize);
+int         WINAPI StringSplitOffsets(const char* str, const char* separator, int offsets[], int size);
+
+size_t      WINAPI simdStrLen        (const char* s);
+BOOL        WINAPI simdEquals        (const char* a, const char* b, size_t len, BOOL ignoreCase);
+int         WINAPI simdFind          (const char* str, size_t strLen, const char* substr, size_t subLen, size_t start, BOOL ignoreCase);
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "expander.h"
+#include "struct/xtrade/TickTimerStats.h"
 
 uint WINAPI SetupTickTimer(HWND hWnd, int millis, DWORD flags=NULL);
+uint WINAPI SetupHighResTickTimer(HWND hWnd, int millis, DWORD flags=NULL);
 BOOL WINAPI RemoveTickTimer(int timerId);
 void WINAPI RemoveTickTimers();
+BOOL WINAPI GetTickTimerStats(int timerId, TICK_TIMER_STATS* stats);
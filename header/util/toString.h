@@ -3,6 +3,8 @@
 #include "expander.h"
 
 
+const char* WINAPI BarModelDescription(int model);
+const char* WINAPI BarModelToStr(int model);
 const char* WINAPI BoolToStr(BOOL value);
 string      WINAPI doubleQuoteStr(const string& value);
 string      WINAPI doubleQuoteStr(const char* value);
@@ -0,0 +1,369 @@
+#include "expander.h"
+#include "accounting.h"
+#include "struct/xtrade/ExecutionContext.h"
+#include "util/helper.h"
+
+#include <algorithm>
+#include <intrin.h>
+#include <vector>
+
+
+extern std::vector<ContextChain> g_contextChains;              // all context chains (= MQL programs, index = program id)
+extern CRITICAL_SECTION          g_terminalLock;               // application wide lock
+
+
+#define ACCOUNT_BLOCK_SIZE    256                                    // accounts per block
+#define ACCOUNT_BLOCKS        256                                    // max. number of blocks (program ids up to 65535)
+
+
+// accounting data of a single program
+struct PROGRAM_ACCOUNT {
+   uint64 enterTsc;                                                  // TSC at entry of start() (0: not in start())
+   uint64 enterCycles;                                               // thread cycles at entry of start()
+   uint   ticks;                                                     // number of accounted start() calls
+   uint64 wallTsc;                                                   // accumulated TSC ticks
+   uint64 cpuCycles;                                                 // accumulated thread cycles
+   uint64 maxTsc;                                                    // maximum TSC ticks of a single call
+   uint   latencies[PROGRAM_STATS_BUCKETS];                          // latency histogram
+   volatile DWORD startedAt;                                         // GetTickCount() at entry of start() (0: not in start())
+   DWORD  alertedAt;                                                 // entry time of the start() call flagged by the watchdog
+   uint   stalls;                                                    // number of flagged start() calls
+};
+
+
+// Accounts are stored in fixed blocks which never move, so the tick path accesses them without locking. A block is allocated
+// on first use of one of its program ids.
+PROGRAM_ACCOUNT* volatile accountBlocks[ACCOUNT_BLOCKS];
+volatile DWORD            accountingMode;                            // active AccountingMode flags (0: accounting disabled)
+double                    tscPerMicro;                               // calibrated TSC ticks per microsecond
+
+HANDLE                    hWatchdogThread;
+HANDLE                    hWatchdogStop;                             // event signaling the watchdog to stop
+uint                      watchdogInterval;                          // scan interval in milliseconds
+uint                      watchdogThreshold;                         // max. duration of a start() call in milliseconds
+
+
+/**
+ * Return the accounting data of a program. Allocates the program's account block if needed.
+ *
+ * @param  uint programId
+ *
+ * @return PROGRAM_ACCOUNT* - account or NULL if the program id is out of range
+ */
+PROGRAM_ACCOUNT* WINAPI getAccount(uint programId) {
+   uint block = programId / ACCOUNT_BLOCK_SIZE;
+   if (block >= ACCOUNT_BLOCKS) return(NULL);
+
+   PROGRAM_ACCOUNT* accounts = accountBlocks[block];
+   if (!accounts) {
+      EnterCriticalSection(&g_terminalLock);
+      if (!(accounts = accountBlocks[block])) {
+         accounts = new PROGRAM_ACCOUNT[ACCOUNT_BLOCK_SIZE]();
+         accountBlocks[block] = accounts;
+      }
+      LeaveCriticalSection(&g_terminalLock);
+   }
+   return(&accounts[programId % ACCOUNT_BLOCK_SIZE]);
+}
+
+
+/**
+ * Return the number of TSC ticks per microsecond. On first call the TSC frequency is calibrated against the performance
+ * counter (blocks the calling thread for about 20 milliseconds).
+ *
+ * @return double - TSC ticks per microsecond or 0 (zero) in case of errors
+ */
+double WINAPI TscPerMicrosecond() {
+   if (!tscPerMicro) {
+      LARGE_INTEGER frequency, counter1, counter2;
+      if (!QueryPerformanceFrequency(&frequency)) return(error(ERR_WIN32_ERROR+GetLastError(), "QueryPerformanceFrequency() failed"));
+
+      QueryPerformanceCounter(&counter1);
+      uint64 tsc1 = __rdtsc();
+      Sleep(20);
+      QueryPerformanceCounter(&counter2);
+      uint64 tsc2 = __rdtsc();
+
+      double micros = (counter2.QuadPart - counter1.QuadPart) * 1000000. / frequency.QuadPart;
+      tscPerMicro = (int64)(tsc2 - tsc1) / micros;
+   }
+   return(tscPerMicro);
+}
+
+
+/**
+ * Enable or disable the accounting of start() calls of all MQL programs. On first activation the TSC frequency is calibrated
+ * (see TscPerMicrosecond()).
+ *
+ * The wall time is measured with the TSC (requires an invariant TSC, i.e. any CPU of the last decade) and costs a few cycles
+ * per tick. AM_CPUTIME additionally queries the thread's CPU cycles which requires a system call at entry and exit of start().
+ *
+ * @param  DWORD mode - combination of AccountingMode flags or 0 (zero) to disable accounting
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI EnableProgramAccounting(DWORD mode) {
+   if (mode & ~(AM_WALLTIME|AM_CPUTIME)) return(error(ERR_INVALID_PARAMETER, "invalid parameter mode = %d", mode));
+   if (mode & AM_CPUTIME) mode |= AM_WALLTIME;
+   if (mode && !TscPerMicrosecond()) return(FALSE);
+
+   EnterCriticalSection(&g_terminalLock);
+   accountingMode = mode | (accountingMode & AM_WATCHDOG);           // keep a running watchdog
+   LeaveCriticalSection(&g_terminalLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Account the entry of a program's start() function. Called by SyncMainContext_start().
+ *
+ * @param  uint programId
+ */
+void WINAPI EnterProgramAccount(uint programId) {
+   DWORD mode = accountingMode;
+   if (!mode) return;
+
+   PROGRAM_ACCOUNT* account = getAccount(programId);
+   if (!account) return;
+
+   if (mode & AM_WATCHDOG) account->startedAt = GetTickCount() | 1;  // never 0
+   if (mode & AM_CPUTIME)  QueryThreadCycleTime(GetCurrentThread(), &account->enterCycles);
+   if (mode & AM_WALLTIME) account->enterTsc = __rdtsc();            // last, to not account the query
+}
+
+
+/**
+ * Account the exit of a program's start() function. Called by LeaveContext_start(). Calls without a matching entry (e.g.
+ * accounting was enabled during start()) are ignored.
+ *
+ * @param  uint programId
+ */
+void WINAPI LeaveProgramAccount(uint programId) {
+   uint64 tsc = __rdtsc();
+   DWORD mode = accountingMode;
+   if (!mode) return;
+
+   PROGRAM_ACCOUNT* account = getAccount(programId);
+   if (!account) return;
+   account->startedAt = 0;
+   if (!account->enterTsc) return;
+
+   uint64 elapsed = tsc - account->enterTsc;
+   account->enterTsc = 0;
+
+   if (mode & AM_CPUTIME) {
+      uint64 cycles;
+      QueryThreadCycleTime(GetCurrentThread(), &cycles);
+      account->cpuCycles += cycles - account->enterCycles;
+   }
+   account->ticks++;
+   account->wallTsc += elapsed;
+   if (elapsed > account->maxTsc) account->maxTsc = elapsed;
+
+   uint micros = (uint)((int64)elapsed / tscPerMicro);               // bucket = number of significant bits of the microseconds
+   DWORD bucket = 0;
+   if (micros) {
+      _BitScanReverse(&bucket, micros);
+      bucket = std::min(bucket+1, (DWORD)PROGRAM_STATS_BUCKETS-1);
+   }
+   account->latencies[bucket]++;
+}
+
+
+/**
+ * Reset the accounting data of a program. Called when a program is released and its id becomes reusable.
+ *
+ * @param  uint programId
+ */
+void WINAPI ResetProgramAccount(uint programId) {
+   uint block = programId / ACCOUNT_BLOCK_SIZE;
+   if (block < ACCOUNT_BLOCKS && accountBlocks[block]) {
+      accountBlocks[block][programId % ACCOUNT_BLOCK_SIZE] = PROGRAM_ACCOUNT();
+   }
+}
+
+
+/**
+ * Copy a snapshot of the accounting figures of all live programs with accounted or stalled start() calls to the passed array. Thread
+ * cycles are converted to time with the TSC frequency (the cycle counter of current CPUs runs at TSC frequency).
+ *
+ * @param  PROGRAM_STATS stats[] - array receiving the snapshot
+ * @param  int           size    - size of the passed array
+ *
+ * @return int - number of programs with accounting data (figures are written only up to the array size)
+ *               or EMPTY (-1) in case of errors
+ */
+int WINAPI GetProgramStats(PROGRAM_STATS stats[], int size) {
+   if (size && (uint)stats < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter stats = 0x%p (not a valid pointer)", stats)));
+   if (size < 0)                                return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+   if (!tscPerMicro) return(0);
+
+   double tscPerMilli = tscPerMicro * 1000;
+   int count = 0;
+
+   EnterCriticalSection(&g_terminalLock);
+   uint programs = g_contextChains.size();
+
+   for (uint id=1; id < programs; id++) {
+      const EXECUTION_CONTEXT* master = g_contextChains[id][0];
+      if (!master) continue;                                         // released program
+      uint block = id / ACCOUNT_BLOCK_SIZE;
+      if (block >= ACCOUNT_BLOCKS || !accountBlocks[block]) continue;
+      const PROGRAM_ACCOUNT& account = accountBlocks[block][id % ACCOUNT_BLOCK_SIZE];
+      if (!account.ticks && !account.stalls) continue;
+
+      if (count < size) {
+         PROGRAM_STATS& ps = stats[count];
+         ps.programId  = id;
+         strcpy(ps.programName, master->programName);
+         ps.ticks      = account.ticks;
+         ps.wallTime   = (int64)account.wallTsc   / tscPerMilli;
+         ps.cpuTime    = (int64)account.cpuCycles / tscPerMilli;
+         ps.maxLatency = (int64)account.maxTsc    / tscPerMilli;
+         memcpy(ps.latencies, account.latencies, sizeof(ps.latencies));
+         ps.stalls     = account.stalls;
+         DWORD startedAt = account.startedAt;
+         ps.stalledFor = (startedAt && startedAt==account.alertedAt) ? GetTickCount() - startedAt : 0;
+      }
+      count++;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   return(count);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Watchdog thread. Scans the entry times of all programs currently executing start() and flags calls exceeding the threshold.
+ * A stall is logged once per start() call, recovery is logged when the call returns. The watchdog only reads the programs'
+ * entry times and never suspends or inspects the stalled threads. As a stalled thread may hold the terminal lock, the lock
+ * is only tried for resolving program names. The thread holds a reference to the DLL until it ends.
+ *
+ * @param  LPVOID arg - unused
+ *
+ * @return DWORD - 0
+ */
+DWORD WINAPI watchdogWorker(LPVOID arg) {
+   while (WaitForSingleObject(hWatchdogStop, watchdogInterval) == WAIT_TIMEOUT) {
+      DWORD now = GetTickCount();
+
+      for (uint block=0; block < ACCOUNT_BLOCKS; block++) {
+         PROGRAM_ACCOUNT* accounts = accountBlocks[block];
+         if (!accounts) continue;
+
+         for (uint i=0; i < ACCOUNT_BLOCK_SIZE; i++) {
+            PROGRAM_ACCOUNT& account = accounts[i];
+            DWORD startedAt = account.startedAt;
+            uint  programId = block*ACCOUNT_BLOCK_SIZE + i;
+
+            if (account.alertedAt && account.alertedAt != startedAt) {   // the flagged call returned
+               debug("program id %d: start() returned after %d msec", programId, now - account.alertedAt);
+               account.alertedAt = 0;
+            }
+            if (!startedAt || startedAt == account.alertedAt || now - startedAt < watchdogThreshold)
+               continue;
+
+            account.alertedAt = startedAt;
+            account.stalls++;
+
+            char name[MAX_PATH] = "?";
+            if (TryEnterCriticalSection(&g_terminalLock)) {
+               if (programId < g_contextChains.size() && g_contextChains[programId][0])
+                  strcpy(name, g_contextChains[programId][0]->programName);
+               LeaveCriticalSection(&g_terminalLock);
+            }
+            warn(ERR_RUNTIME_ERROR, "program id %d (%s): start() stalled for %d msec", programId, name, now - startedAt);
+         }
+      }
+   }
+   ExitWorkerThread();                                               // releases the DLL reference, doesn't return
+   return(0);
+}
+
+
+/**
+ * Start the watchdog thread detecting stalled start() calls of MQL programs. A running watchdog is reconfigured. The tick path
+ * costs a single store of the entry time at entry and exit of start(). Fails if the thread of a timed out StopWatchdog() call
+ * is still running.
+ *
+ * @param  uint interval  - scan interval in milliseconds
+ * @param  uint threshold - max. duration of a start() call in milliseconds
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI StartWatchdog(uint interval, uint threshold) {
+   if ((int)interval  <= 0) return(error(ERR_INVALID_PARAMETER, "invalid parameter interval = %d", (int)interval));
+   if ((int)threshold <= 0) return(error(ERR_INVALID_PARAMETER, "invalid parameter threshold = %d", (int)threshold));
+
+   BOOL success = TRUE;
+   EnterCriticalSection(&g_terminalLock);
+   watchdogInterval  = interval;
+   watchdogThreshold = threshold;
+
+   if (hWatchdogThread && WaitForSingleObject(hWatchdogThread, 0) == WAIT_OBJECT_0) {
+      CloseHandle(hWatchdogThread);                                  // the thread of a timed out stop ended meanwhile
+      CloseHandle(hWatchdogStop);
+      hWatchdogThread = hWatchdogStop = NULL;
+   }
+
+   if (hWatchdogThread) {
+      if (WaitForSingleObject(hWatchdogStop, 0) == WAIT_OBJECT_0)
+         success = error(ERR_ILLEGAL_STATE, "the watchdog thread of a previous StopWatchdog() call is still stopping");
+   }
+   else if (!(hWatchdogStop = CreateEvent(NULL, TRUE, FALSE, NULL))) {
+      success = error(ERR_WIN32_ERROR+GetLastError(), "CreateEvent() failed");
+   }
+   else {
+      accountingMode |= AM_WATCHDOG;
+      hWatchdogThread = CreateWorkerThread(watchdogWorker, NULL);
+      if (!hWatchdogThread) {
+         accountingMode &= ~AM_WATCHDOG;
+         CloseHandle(hWatchdogStop);
+         hWatchdogStop = NULL;
+         success = FALSE;
+      }
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   return(success);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Stop a running watchdog thread and wait for its termination. As the thread holds a reference to the DLL, a running watchdog
+ * keeps the DLL loaded until this function is called. The watchdog thread never blocks on the terminal lock, so it's held
+ * while waiting.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI StopWatchdog() {
+   BOOL success = TRUE;
+   EnterCriticalSection(&g_terminalLock);
+
+   if (hWatchdogThread) {
+      accountingMode &= ~AM_WATCHDOG;
+      SetEvent(hWatchdogStop);
+      if (WaitForSingleObject(hWatchdogThread, 1000) == WAIT_OBJECT_0) {
+         CloseHandle(hWatchdogThread);
+         CloseHandle(hWatchdogStop);
+         hWatchdogThread = hWatchdogStop = NULL;
+      }
+      else success = error(ERR_RUNTIME_ERROR, "watchdog thread did not stop within 1 second");   // the handles are released by the next StartWatchdog()
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   return(success);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Release the watchdog's handles on DLL_PROCESS_DETACH. A watchdog thread can't be running at this point: it holds a reference
+ * to the DLL, so the DLL is unloaded either by the thread's own exit or on process termination (where cleanup is skipped).
+ */
+void WINAPI ReleaseWatchdog() {
+   if (hWatchdogThread) CloseHandle(hWatchdogThread);
+   if (hWatchdogStop)   CloseHandle(hWatchdogStop);
+   hWatchdogThread = hWatchdogStop = NULL;
+}
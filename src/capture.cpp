@@ -0,0 +1,382 @@
+#include "expander.h"
+#include "accounting.h"
+#include "capture.h"
+#include "context.h"
+
+#include <fstream>
+#include <intrin.h>
+#include <map>
+#include <set>
+#include <vector>
+
+
+extern std::vector<ContextChain> g_contextChains;                    // all context chains (i.e. MQL programs, index = program id)
+extern CRITICAL_SECTION          g_terminalLock;                     // application wide lock
+
+
+// forward declarations of captured functions not declared in a header
+BOOL WINAPI CollectTestData(EXECUTION_CONTEXT* ec, datetime startTime, datetime endTime, double bid, double ask, uint bars, int reportingId, const char* reportingSymbol);
+BOOL WINAPI Test_OpenOrder (EXECUTION_CONTEXT* ec, int ticket, int type, double lots, const char* symbol, double openPrice, datetime openTime, double stopLoss, double takeProfit, double commission, int magicNumber, const char* comment);
+BOOL WINAPI Test_CloseOrder(EXECUTION_CONTEXT* ec, int ticket, double closePrice, datetime closeTime, double swap, double profit);
+void WINAPI ReleaseTest    (TEST* test);
+
+
+#define CAPTURE_BUFFER_SIZE   (1024*1024)                            // records are written in chunks of this size
+
+
+std::ofstream     captureStream;
+std::vector<char> captureBuffer;
+volatile BOOL     capturing;                                         // whether a capture is active
+DWORD             replayThread;                                      // the thread running a replay (0: no replay is running)
+
+
+/**
+ * Start recording a call. If a capture is active the passed context is copied and space for the arguments is reserved.
+ *
+ * @param  CapturedFunction   function - captured function
+ * @param  EXECUTION_CONTEXT* ec       - context passed to the function
+ * @param  uint               argsSize - size of the function's arguments (one of the CAPTURE_*_ARGS structs)
+ */
+CaptureScope::CaptureScope(CapturedFunction function, EXECUTION_CONTEXT* ec, uint argsSize) : record(NULL), args(NULL), ec(ec) {
+   if (!capturing) return;
+
+   uint size = sizeof(CAPTURE_RECORD) + argsSize;
+   record = (CAPTURE_RECORD*) new char[size];
+   record->function  = function;
+   record->size      = size;
+   record->duration  = 0;
+   record->threadId  = GetCurrentThreadId();
+   record->ecAddress = (uint)ec;
+   record->programId = 0;
+   record->context   = *ec;
+   record->timestamp = __rdtsc();                                    // last, to not account the context copy
+   args = memset(record + 1, 0, argsSize);
+}
+
+
+/**
+ * Complete the record of a call and append it to the capture.
+ */
+CaptureScope::~CaptureScope() {
+   if (!record) return;
+   record->duration  = __rdtsc() - record->timestamp;
+   record->programId = ec->programId;
+
+   EnterCriticalSection(&g_terminalLock);
+   if (capturing) {
+      const char* data = (const char*)record;
+      captureBuffer.insert(captureBuffer.end(), data, data + record->size);
+      if (captureBuffer.size() >= CAPTURE_BUFFER_SIZE) {
+         captureStream.write(&captureBuffer[0], captureBuffer.size());
+         captureBuffer.clear();
+      }
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   delete[] (char*)record;
+}
+
+
+/**
+ * Copy a string argument to a fixed size capture buffer. NULL pointers are captured as empty strings, longer strings are
+ * truncated.
+ *
+ * @param  char* dest - destination buffer
+ * @param  char* src  - source string
+ * @param  uint  size - size of the destination buffer
+ */
+void WINAPI CopyCaptureString(char* dest, const char* src, uint size) {
+   if ((uint)src < MIN_VALID_POINTER) src = "";
+   strncpy(dest, src, size-1);
+   dest[size-1] = '\0';
+}
+
+
+/**
+ * Start capturing the calls of the context and tester functions of all MQL programs (see CapturedFunction). Each call is
+ * recorded with the passed context, its arguments, timestamp, duration and the resulting program id. The capture can be
+ * re-executed with Replay_Run().
+ *
+ * @param  char* fileName - full name of the capture file (an existing file is replaced)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Capture_Start(const char* fileName) {
+   if ((uint)fileName < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter fileName = 0x%p (not a valid pointer)", fileName));
+   if (capturing)                          return(error(ERR_ILLEGAL_STATE, "capture already active"));
+   if (replayThread)                       return(error(ERR_ILLEGAL_STATE, "capture not possible during replay"));
+
+   double tscPerMicro = TscPerMicrosecond();
+   if (!tscPerMicro) return(FALSE);
+
+   EnterCriticalSection(&g_terminalLock);
+   captureStream.open(fileName, std::ios::binary|std::ios::trunc);
+   if (!captureStream.is_open()) {
+      LeaveCriticalSection(&g_terminalLock);
+      return(error(ERR_FILE_CANNOT_OPEN, "captureStream.open(\"%s\") failed", fileName));
+   }
+   CAPTURE_HEADER header = {};
+   memcpy(header.magic, "CAP1", 4);
+   header.contextSize = sizeof(EXECUTION_CONTEXT);
+   header.tscPerMicro = tscPerMicro;
+   captureStream.write((const char*)&header, sizeof(header));
+
+   captureBuffer.reserve(CAPTURE_BUFFER_SIZE + sizeof(CAPTURE_RECORD) + sizeof(CAPTURE_MAININIT_ARGS));
+   capturing = TRUE;
+   LeaveCriticalSection(&g_terminalLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Stop an active capture and close the capture file.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Capture_Stop() {
+   EnterCriticalSection(&g_terminalLock);
+   if (!capturing) {
+      LeaveCriticalSection(&g_terminalLock);
+      return(TRUE);
+   }
+   capturing = FALSE;
+   if (!captureBuffer.empty()) captureStream.write(&captureBuffer[0], captureBuffer.size());
+   captureBuffer.clear();
+   BOOL success = captureStream.good();
+   captureStream.close();
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (!success) return(error(ERR_FILE_WRITE_ERROR, "writing of the capture file failed"));
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Flush and close an active capture on DLL_PROCESS_DETACH. No other thread executes code of this DLL at this point, the lock
+ * is not used as it may be orphaned on process termination.
+ */
+void WINAPI ReleaseCapture() {
+   if (!capturing) return;
+   capturing = FALSE;
+   if (!captureBuffer.empty()) captureStream.write(&captureBuffer[0], captureBuffer.size());
+   captureBuffer.clear();
+   captureStream.close();
+}
+
+
+/**
+ * Whether the current thread is running a replay. Calls executed by a replay must not have persistent side effects (e.g. the
+ * tester doesn't store replayed tests).
+ *
+ * @return BOOL
+ */
+BOOL WINAPI IsReplayThread() {
+   return(replayThread && replayThread == GetCurrentThreadId());
+}
+
+
+/**
+ * Restore a replay context from a captured context. Pointers owned by the replay (test data, messages) are kept, the super
+ * context and the program id are translated to their replay counterparts.
+ *
+ * @param  EXECUTION_CONTEXT*                   ec       - replay context
+ * @param  EXECUTION_CONTEXT&                   captured - captured context
+ * @param  std::map<uint, EXECUTION_CONTEXT*>&  contexts - replay contexts by captured address
+ * @param  std::map<uint, uint>&                ids      - replay program ids by captured program id
+ */
+void WINAPI restoreContext(EXECUTION_CONTEXT* ec, const EXECUTION_CONTEXT& captured, std::map<uint, EXECUTION_CONTEXT*>& contexts, std::map<uint, uint>& ids) {
+   TEST* test       = ec->test;
+   char* errorMsg   = ec->dllErrorMsg;
+   char* warningMsg = ec->dllWarningMsg;
+
+   *ec = captured;
+   ec->test          = test;
+   ec->dllErrorMsg   = errorMsg;
+   ec->dllWarningMsg = warningMsg;
+
+   std::map<uint, EXECUTION_CONTEXT*>::iterator context = contexts.find((uint)captured.superContext);
+   ec->superContext = (context != contexts.end()) ? context->second : NULL;
+
+   std::map<uint, uint>::iterator id = ids.find(captured.programId);
+   ec->programId = (id != ids.end()) ? id->second : 0;
+}
+
+
+/**
+ * Release the programs registered by a replay and free the replay contexts and the tests created by the replay. Programs are
+ * released regardless of their state (a capture may end in the middle of a program's lifetime). Program ids which were already
+ * released and reused by another program are skipped, as their chains don't contain replay contexts.
+ *
+ * @param  std::map<uint, EXECUTION_CONTEXT*>& contexts - replay contexts by captured address
+ */
+void WINAPI releaseReplayPrograms(std::map<uint, EXECUTION_CONTEXT*>& contexts) {
+   std::set<EXECUTION_CONTEXT*> replayContexts;
+   std::map<uint, EXECUTION_CONTEXT*>::iterator it, end=contexts.end();
+   for (it=contexts.begin(); it != end; ++it) {
+      replayContexts.insert(it->second);
+   }
+
+   EnterCriticalSection(&g_terminalLock);
+   for (it=contexts.begin(); it != end; ++it) {
+      uint id = it->second->programId;
+      if (!id || id >= g_contextChains.size() || !g_contextChains[id][0]) continue;
+
+      ContextChain& chain = g_contextChains[id];
+      BOOL isReplayProgram = FALSE;
+      for (uint i=1; i < chain.size() && !isReplayProgram; i++) {
+         isReplayProgram = (replayContexts.find(chain[i]) != replayContexts.end());
+      }
+      if (!isReplayProgram) continue;
+
+      for (uint i=1; i < chain.size(); i++) {
+         chain[i] = NULL;                                            // unregister all modules
+      }
+      chain[0]->initCycle = FALSE;
+      ReleaseProgram(id);
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   std::set<TEST*> tests;                                            // a test may be shared by copied contexts
+   for (it=contexts.begin(); it != end; ++it) {
+      if (it->second->test) tests.insert(it->second->test);
+      delete it->second;
+   }
+   contexts.clear();
+
+   for (std::set<TEST*>::iterator test=tests.begin(); test != tests.end(); ++test) {
+      ReleaseTest(*test);
+   }
+}
+
+
+/**
+ * Re-execute a call capture in the current thread and collect timing statistics. Calls are executed back-to-back (without
+ * the captured pauses) against contexts owned by the replay. Program ids are translated between capture and replay. Calls
+ * depending on the terminal's windows (e.g. SyncMainContext_init() with a chart) must be replayed in a terminal showing the
+ * same charts, the tick path replays anywhere.
+ *
+ * The replay registers its programs like real programs and releases them when it ends. Calls with persistent side effects are
+ * sandboxed: replayed tests are neither stored in the test store nor in the pass cache. Still, run it in a dedicated terminal
+ * or process, as replayed programs are visible to other programs while the replay runs.
+ *
+ * @param  char*         fileName - full name of the capture file
+ * @param  REPLAY_STATS* stats    - struct receiving the replay statistics
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Replay_Run(const char* fileName, REPLAY_STATS* stats) {
+   if ((uint)fileName < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter fileName = 0x%p (not a valid pointer)", fileName));
+   if ((uint)stats    < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter stats = 0x%p (not a valid pointer)", stats));
+   if (capturing)                          return(error(ERR_ILLEGAL_STATE, "replay not possible during capture"));
+   if (replayThread)                       return(error(ERR_ILLEGAL_STATE, "replay already running"));
+
+   std::ifstream fs(fileName, std::ios::binary);
+   if (!fs.is_open()) return(error(ERR_FILE_CANNOT_OPEN, "fs.open(\"%s\") failed", fileName));
+   std::vector<char> data((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+   fs.close();
+
+   if (data.size() < sizeof(CAPTURE_HEADER)) return(error(ERR_FILE_INCOMPATIBLE, "invalid or incompatible capture file \"%s\"", fileName));
+   const CAPTURE_HEADER* header = (const CAPTURE_HEADER*)&data[0];
+   if (memcmp(header->magic, "CAP1", 4) || header->contextSize != sizeof(EXECUTION_CONTEXT) || header->tscPerMicro <= 0)
+      return(error(ERR_FILE_INCOMPATIBLE, "invalid or incompatible capture file \"%s\"", fileName));
+
+   double tscPerMicro = TscPerMicrosecond();
+   if (!tscPerMicro) return(FALSE);
+   double capturedTscPerMilli = header->tscPerMicro * 1000;
+   double replayedTscPerMilli = tscPerMicro * 1000;
+
+   memset(stats, 0, sizeof(REPLAY_STATS));
+   std::map<uint, EXECUTION_CONTEXT*> contexts;
+   std::map<uint, uint> ids;
+   uint pos=sizeof(CAPTURE_HEADER), size=data.size();
+   replayThread = GetCurrentThreadId();
+
+   while (pos < size) {
+      const CAPTURE_RECORD* record = (const CAPTURE_RECORD*)&data[pos];
+      if (size-pos < sizeof(CAPTURE_RECORD) || record->size < sizeof(CAPTURE_RECORD) || record->size > size-pos || !record->function || record->function >= CAPTURED_FUNCTIONS) {
+         releaseReplayPrograms(contexts);
+         replayThread = NULL;
+         return(error(ERR_FILE_INCOMPATIBLE, "invalid capture record at offset %d of \"%s\"", pos, fileName));
+      }
+      pos += record->size;
+
+      EXECUTION_CONTEXT*& ec = contexts[record->ecAddress];
+      if (!ec) ec = new EXECUTION_CONTEXT();                         // released with the replay's programs
+      restoreContext(ec, record->context, contexts, ids);
+
+      const void* args = record + 1;
+      BOOL result = FALSE;
+      uint64 start = __rdtsc();
+
+      switch (record->function) {
+         case CF_SYNCMAIN_INIT: {
+            const CAPTURE_MAININIT_ARGS& a = *(const CAPTURE_MAININIT_ARGS*)args;
+            std::map<uint, EXECUTION_CONTEXT*>::iterator sec = contexts.find(a.sec);
+            result = SyncMainContext_init(ec, a.programType, a.programName, a.uninitReason, a.initFlags, a.deinitFlags, a.symbol, a.period, (sec != contexts.end()) ? sec->second : NULL, a.isTesting, a.isVisualMode, a.isOptimization, a.hChart, a.droppedOnChart, a.droppedOnPosX, a.droppedOnPosY);
+            break;
+         }
+         case CF_SYNCMAIN_START: {
+            const CAPTURE_START_ARGS& a = *(const CAPTURE_START_ARGS*)args;
+            result = SyncMainContext_start(ec, a.time, a.bid, a.ask, a.volume);
+            break;
+         }
+         case CF_SYNCMAIN_DEINIT:
+            result = SyncMainContext_deinit(ec, ((const CAPTURE_DEINIT_ARGS*)args)->uninitReason);
+            break;
+
+         case CF_SYNCLIB_INIT: {
+            const CAPTURE_LIBINIT_ARGS& a = *(const CAPTURE_LIBINIT_ARGS*)args;
+            result = SyncLibContext_init(ec, a.uninitReason, a.initFlags, a.deinitFlags, a.moduleName, a.symbol, a.period, a.isOptimization);
+            break;
+         }
+         case CF_SYNCLIB_DEINIT:
+            result = SyncLibContext_deinit(ec, ((const CAPTURE_DEINIT_ARGS*)args)->uninitReason);
+            break;
+
+         case CF_LEAVE_START:
+            result = LeaveContext_start(ec);
+            break;
+
+         case CF_LEAVE:
+            result = LeaveContext(ec);
+            break;
+
+         case CF_COLLECTTESTDATA: {
+            const CAPTURE_TESTDATA_ARGS& a = *(const CAPTURE_TESTDATA_ARGS*)args;
+            result = CollectTestData(ec, a.startTime, a.endTime, a.bid, a.ask, a.bars, a.reportingId, a.reportingSymbol);
+            break;
+         }
+         case CF_TEST_OPENORDER: {
+            const CAPTURE_OPENORDER_ARGS& a = *(const CAPTURE_OPENORDER_ARGS*)args;
+            result = Test_OpenOrder(ec, a.ticket, a.type, a.lots, a.symbol, a.openPrice, a.openTime, a.stopLoss, a.takeProfit, a.commission, a.magicNumber, a.comment);
+            break;
+         }
+         case CF_TEST_CLOSEORDER: {
+            const CAPTURE_CLOSEORDER_ARGS& a = *(const CAPTURE_CLOSEORDER_ARGS*)args;
+            result = Test_CloseOrder(ec, a.ticket, a.closePrice, a.closeTime, a.swap, a.profit);
+            break;
+         }
+      }
+      uint64 elapsed = __rdtsc() - start;
+
+      stats->calls++;
+      if (!result) stats->failures++;
+      stats->capturedTime += (int64)record->duration / capturedTscPerMilli;
+      stats->replayedTime += (int64)elapsed / replayedTscPerMilli;
+      stats->functionCalls[record->function]++;
+      stats->functionTime [record->function] += (int64)elapsed / replayedTscPerMilli;
+
+      if (record->programId) {                                       // compare the resulting program ids
+         std::map<uint, uint>::iterator id = ids.find(record->programId);
+         if (id == ids.end()) ids[record->programId] = ec->programId;
+         else if (id->second != ec->programId) stats->mismatches++;
+      }
+      else if (ec->programId) stats->mismatches++;
+   }
+
+   releaseReplayPrograms(contexts);
+   replayThread = NULL;
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
@@ -1,10 +1,16 @@
 #include "expander.h"
+#include "accounting.h"
+#include "capture.h"
 #include "context.h"
+#include "shadow.h"
+#include "trace.h"
+#include "tester/passcache.h"
 #include "struct/xtrade/ExecutionContext.h"
 #include "util/helper.h"
 #include "util/string.h"
 #include "util/toString.h"
 
+#include <deque>
 #include <vector>
 
 
@@ -14,6 +20,8 @@ extern std::vector<uint>         g_threadsPrograms;            // the last MQL p
 extern uint                      g_lastUIThreadProgram;        // the last MQL program executed by the UI thread
 extern CRITICAL_SECTION          g_terminalLock;               // application wide lock
 
+std::deque<uint>                 releasedProgramIds;           // ids of released programs (reused in release order)
+
 
 /**
  *  Init cycle of a single indicator using single and nested library calls:
@@ -85,6 +93,26 @@ BOOL WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
    if ((int)period <= 0)                      return(error(ERR_INVALID_PARAMETER, "invalid parameter period = %d", (int)period));
    if (sec && (uint)sec  < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter sec = 0x%p (not a valid pointer)", sec));
 
+   CaptureScope capture(CF_SYNCMAIN_INIT, ec, sizeof(CAPTURE_MAININIT_ARGS));
+   if (capture.args) {                                               // only if a capture is active
+      CAPTURE_MAININIT_ARGS* args = (CAPTURE_MAININIT_ARGS*)capture.args;
+      args->programType    = programType;
+      CopyCaptureString(args->programName, programName, sizeof(args->programName));
+      args->uninitReason   = uninitReason;
+      args->initFlags      = initFlags;
+      args->deinitFlags    = deinitFlags;
+      CopyCaptureString(args->symbol, symbol, sizeof(args->symbol));
+      args->period         = period;
+      args->sec            = (uint)sec;
+      args->isTesting      = isTesting;
+      args->isVisualMode   = isVisualMode;
+      args->isOptimization = isOptimization;
+      args->hChart         = hChart;
+      args->droppedOnChart = droppedOnChart;
+      args->droppedOnPosX  = droppedOnPosX;
+      args->droppedOnPosY  = droppedOnPosY;
+   }
+
    if (ec->programId)
       StoreThreadAndProgram(ec->programId);                          // store the last executed program (asap for error handling)
 
@@ -143,15 +171,22 @@ BOOL WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
          chain.push_back(ec);
 
          EnterCriticalSection(&g_terminalLock);
-         g_contextChains.push_back(chain);                           // Chain in der Chain-Liste speichern
-         uint size = g_contextChains.size();                         // g_contextChains.size ist immer > 1 (index[0] bleibt frei)
-         master->programId = ec->programId = size-1;                 // Index = neue ProgramID dem Master- und Hauptkontext zuweisen
+         uint id;
+         if (!releasedProgramIds.empty()) {                          // freigegebene ProgramID wiederverwenden
+            id = releasedProgramIds.front();
+            releasedProgramIds.pop_front();
+            g_contextChains[id].swap(chain);                         // Chain im freigegebenen Slot speichern
+         }
+         else {
+            g_contextChains.push_back(chain);                        // Chain in der Chain-Liste speichern
+            id = g_contextChains.size() - 1;                         // g_contextChains.size ist immer > 1 (index[0] bleibt frei)
+         }
+         master->programId = ec->programId = id;                     // Index = neue ProgramID dem Master- und Hauptkontext zuweisen
          //debug("%s::init()  programId=0  %snew chain => id=%d  thread=%s  hChart=%d", programName, (IsUIThread() ? "UI  ":""), ec->programId, IsUIThread() ? "UI":to_string(GetCurrentThreadId()).c_str(), hChart);
          LeaveCriticalSection(&g_terminalLock);
 
          // get last program executed by the current thread and store the currently executed one (asap)
          uint index = StoreThreadAndProgram(0);
-         lastProgramId = g_threadsPrograms[index];
          g_threadsPrograms[index] = ec->programId;
          isNewExpert = (programType==PT_EXPERT);
       }
@@ -195,7 +230,10 @@ BOOL WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
 
 
    // (3) Wenn Expert im Tester, dann ggf. dessen Libraries aus dem vorherigen Test finden und dem Expert zuordnen
-   if (isNewExpert && isTesting && lastProgramId) {
+   if (isNewExpert && isTesting) {
+      lastProgramId = FindPreviousTestExpert(GetCurrentThreadId(), ec->programId);
+   }
+   if (lastProgramId) {
       EXECUTION_CONTEXT *lib, *lastMaster=g_contextChains[lastProgramId][0];
 
       if (lastMaster && lastMaster->initCycle) {
@@ -225,8 +263,20 @@ BOOL WINAPI SyncMainContext_init(EXECUTION_CONTEXT* ec, ProgramType programType,
             }
          }
          lastMaster->initCycle = FALSE;
+         SyncProgramShadow(lastMaster);
+      }
+
+      // the previous test is finished: remaining library contexts weren't carried over and are released
+      if (lastMaster) {
+         ContextChain& lastChain = g_contextChains[lastProgramId];
+         for (uint i=2; i < lastChain.size(); i++) {
+            lastChain[i] = NULL;
+         }
+         ReleaseProgram(lastProgramId);
       }
    }
+   SyncProgramShadow(g_contextChains[ec->programId][0]);
+   TraceContext(TE_SYNCMAIN_INIT, ec);
    return(TRUE);
    #pragma EXPANDER_EXPORT
 }
@@ -247,12 +297,44 @@ BOOL WINAPI SyncMainContext_start(EXECUTION_CONTEXT* ec, datetime time, double b
 
    StoreThreadAndProgram(ec->programId);                             // store last executed program (asap)
 
+   CaptureScope capture(CF_SYNCMAIN_START, ec, sizeof(CAPTURE_START_ARGS));
+   if (capture.args) {
+      CAPTURE_START_ARGS* args = (CAPTURE_START_ARGS*)capture.args;
+      args->time   = time;
+      args->bid    = bid;
+      args->ask    = ask;
+      args->volume = volume;
+   }
+
    ec_SetRootFunction    (ec, RF_START            );                 // update context
    ec_SetThreadId        (ec, GetCurrentThreadId());
    ec_SetTicks           (ec, ec->ticks + 1       );
    ec_SetPreviousTickTime(ec, ec->currentTickTime );
    ec_SetCurrentTickTime (ec, time                );
 
+   if (g_contextChains[ec->programId][1] == ec)
+      SyncProgramShadow(g_contextChains[ec->programId][0]);
+   TraceContext(TE_SYNCMAIN_START, ec);
+   EnterProgramAccount(ec->programId);                               // no-op if accounting is disabled
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Signal leaving of an MQL program's start() function. Called at leaving of MQL::start() and needed only for the accounting
+ * of start() calls (see EnableProgramAccounting()).
+ *
+ * @param  EXECUTION_CONTEXT* ec - main module context of a program
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI LeaveContext_start(EXECUTION_CONTEXT* ec) {
+   if ((uint)ec < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter ec = 0x%p (not a valid pointer)", ec));
+   CaptureScope capture(CF_LEAVE_START, ec, 0);
+
+   LeaveProgramAccount(ec->programId);
+   TraceContext(TE_LEAVE_START, ec);
    return(TRUE);
    #pragma EXPANDER_EXPORT
 }
@@ -270,10 +352,16 @@ BOOL WINAPI SyncMainContext_deinit(EXECUTION_CONTEXT* ec, UninitializeReason uni
 
    StoreThreadAndProgram(ec->programId);                             // store last executed program (asap)
 
+   CaptureScope capture(CF_SYNCMAIN_DEINIT, ec, sizeof(CAPTURE_DEINIT_ARGS));
+   if (capture.args) ((CAPTURE_DEINIT_ARGS*)capture.args)->uninitReason = uninitReason;
+
    ec_SetRootFunction(ec, RF_DEINIT           );                     // update context
    ec_SetUninitReason(ec, uninitReason        );
    ec_SetThreadId    (ec, GetCurrentThreadId());
 
+   if (g_contextChains[ec->programId][1] == ec)
+      SyncProgramShadow(g_contextChains[ec->programId][0]);
+   TraceContext(TE_SYNCMAIN_DEINIT, ec);
    return(TRUE);
    #pragma EXPANDER_EXPORT
 }
@@ -326,6 +414,18 @@ BOOL WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninit
    if ((uint)symbol     < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbol=0x%p (not a valid pointer)", symbol));
    if ((int)period <= 0)                     return(error(ERR_INVALID_PARAMETER, "invalid parameter period=%d", (int)period));
 
+   CaptureScope capture(CF_SYNCLIB_INIT, ec, sizeof(CAPTURE_LIBINIT_ARGS));
+   if (capture.args) {
+      CAPTURE_LIBINIT_ARGS* args = (CAPTURE_LIBINIT_ARGS*)capture.args;
+      args->uninitReason   = uninitReason;
+      args->initFlags      = initFlags;
+      args->deinitFlags    = deinitFlags;
+      CopyCaptureString(args->moduleName, moduleName, sizeof(args->moduleName));
+      CopyCaptureString(args->symbol, symbol, sizeof(args->symbol));
+      args->period         = period;
+      args->isOptimization = isOptimization;
+   }
+
    // (1) If ec.ProgramID is not set: library is loaded the first time and the context is empty.
    //     - copy master context and update library specific fields
    //
@@ -388,10 +488,14 @@ BOOL WINAPI SyncLibContext_init(EXECUTION_CONTEXT* ec, UninitializeReason uninit
       ec_SetHChartWindow (ec, NULL                );                 // gets updated in Expert::init()
       ec_SetThreadId     (ec, GetCurrentThreadId());
 
-      g_contextChains[ec->programId][0]->initCycle = TRUE;           // mark master context
+      if (EXECUTION_CONTEXT* master = g_contextChains[ec->programId][0]) {
+         master->initCycle = TRUE;                                   // mark master context
+         SyncProgramShadow(master);
+      }
    }
 
    //debug("%s::%s::init()  ec=%s", ec->programName, ec->moduleName, EXECUTION_CONTEXT_toStr(ec));
+   TraceContext(TE_SYNCLIB_INIT, ec);
    return(TRUE);
    #pragma EXPANDER_EXPORT
 }
@@ -411,10 +515,14 @@ BOOL WINAPI SyncLibContext_deinit(EXECUTION_CONTEXT* ec, UninitializeReason unin
 
    StoreThreadAndProgram(ec->programId);                             // store last executed program (asap)
 
+   CaptureScope capture(CF_SYNCLIB_DEINIT, ec, sizeof(CAPTURE_DEINIT_ARGS));
+   if (capture.args) ((CAPTURE_DEINIT_ARGS*)capture.args)->uninitReason = uninitReason;
+
    ec_SetRootFunction(ec, RF_DEINIT   );                             // update library specific context fields
    ec_SetUninitReason(ec, uninitReason);
 
    //debug("%s::%s::deinit()  ec@%d=%s", ec->programName, ec->moduleName, ec, EXECUTION_CONTEXT_toStr(ec));
+   TraceContext(TE_SYNCLIB_DEINIT, ec);
    return(TRUE);
    #pragma EXPANDER_EXPORT
 }
@@ -449,32 +557,33 @@ BOOL WINAPI SyncLibContext_deinit(EXECUTION_CONTEXT* ec, UninitializeReason unin
  */
 int WINAPI FindIndicatorInLimbo(HWND hChart, const char* name, UninitializeReason reason) {
    if (hChart) {
-      EXECUTION_CONTEXT* master;
+      const PROGRAM_SHADOW* shadow;                                  // walk the shadows, the name is compared last
       int size=g_contextChains.size(), uiThreadId=GetUIThreadId();
 
       for (int i=1; i < size; i++) {                                 // index[0] is never occupied
-         master = g_contextChains[i][0];
-
-         if (master->threadId == uiThreadId) {
-            if (master->hChart == hChart) {
-               if (master->programType == MT_INDICATOR) {
-                  if (strcmp(master->programName, name) == 0) {
-                     if (master->uninitReason == reason) {
-                        if (master->rootFunction == NULL) {          // limbo = init cycle
-                           //debug("first %s indicator found in limbo: id=%d", name, master->programId);
-                           return(master->programId);
+         shadow = GetProgramShadow(i);
+         if (!shadow) continue;                                      // released program
+
+         if (shadow->threadId == uiThreadId) {
+            if (shadow->hChart == hChart) {
+               if (shadow->programType == MT_INDICATOR) {
+                  if (shadow->uninitReason == reason) {
+                     if (shadow->rootFunction == NULL) {             // limbo = init cycle
+                        if (strcmp(shadow->master->programName, name) == 0) {
+                           //debug("first %s indicator found in limbo: id=%d", name, shadow->programId);
+                           return(shadow->programId);
                         }
-                        //else debug("i=%d  %s  rootFunction not NULL:  master=%s", i, name, RootFunctionToStr(master->rootFunction));
+                        //else debug("i=%d  %s  name mis-match", i, name);
                      }
-                     //else debug("i=%d  %s  uninit reason mis-match:  master=%s  reason=%s", i, name, UninitReasonToStr(master->uninitReason), UninitReasonToStr(reason));
+                     //else debug("i=%d  %s  rootFunction not NULL:  master=%s", i, name, RootFunctionToStr(shadow->rootFunction));
                   }
-                  //else debug("i=%d  %s  name mis-match", i, name);
+                  //else debug("i=%d  %s  uninit reason mis-match:  master=%s  reason=%s", i, name, UninitReasonToStr(shadow->uninitReason), UninitReasonToStr(reason));
                }
                //else debug("i=%d  %s  no indicator", i, name);
             }
-            //else debug("i=%d  %s  chart mis-match  master=%d  hChart=%d", i, name, master->hChart, hChart);
+            //else debug("i=%d  %s  chart mis-match  master=%d  hChart=%d", i, name, shadow->hChart, hChart);
          }
-         //else debug("i=%d  %s  thread mis-match  master->threadId=%d  uiThreadId=%d", i, master->programName, master->threadId, uiThreadId);
+         //else debug("i=%d  %s  thread mis-match  master->threadId=%d  uiThreadId=%d", i, shadow->master->programName, shadow->threadId, uiThreadId);
       }
    }
 
@@ -486,6 +595,10 @@ int WINAPI FindIndicatorInLimbo(HWND hChart, const char* name, UninitializeReaso
 /**
  * Signal leaving of an MQL module's execution context. Called at leaving of MQL::deinit().
  *
+ * When a program leaves for good and all its modules (main module and libraries) have left, the program's master context is
+ * freed and its program id is released for reuse (see ReleaseProgram()). Experts in the Tester keep their chain until the next
+ * test of the same thread took over the loaded libraries.
+ *
  * @param  EXECUTION_CONTEXT* ec
  *
  * @return BOOL - success status
@@ -495,6 +608,8 @@ BOOL WINAPI LeaveContext(EXECUTION_CONTEXT* ec) {
    uint id = ec->programId;
    if ((int)id < 1)                   return(error(ERR_INVALID_PARAMETER, "invalid execution context (ec.programId=%d)  ec=%s", (int)id, EXECUTION_CONTEXT_toStr(ec)));
    if (ec->rootFunction != RF_DEINIT) return(error(ERR_INVALID_PARAMETER, "invalid execution context (ec.rootFunction not RF_DEINIT)  ec=%s", EXECUTION_CONTEXT_toStr(ec)));
+   CaptureScope capture(CF_LEAVE, ec, 0);
+   TraceContext(TE_LEAVE, ec);
 
    switch (ec->moduleType) {
       case MT_INDICATOR:
@@ -502,6 +617,8 @@ BOOL WINAPI LeaveContext(EXECUTION_CONTEXT* ec) {
          if (ec != g_contextChains[id][1]) return(error(ERR_ILLEGAL_STATE, "%s::%s::deinit()  illegal parameter ec=%d (doesn't match the stored main context=%d)  ec=%s", ec->programName, ec->moduleName, ec, g_contextChains[id][1], EXECUTION_CONTEXT_toStr(ec)));
          ec_SetRootFunction(ec, (RootFunction)NULL);                 // set main and master context to NULL
          g_contextChains[id][1] = NULL;                              // mark main context as released
+         if (ec->moduleType==MT_SCRIPT || !IsInitCycleReason(ec->uninitReason))
+            ReleaseProgram(id);                                      // released if the program has no libraries
          break;
 
       case MT_EXPERT:
@@ -512,23 +629,124 @@ BOOL WINAPI LeaveContext(EXECUTION_CONTEXT* ec) {
          }
 
          ec_SetRootFunction(ec, (RootFunction)NULL);                 // set main and master context to NULL
-         if (ec->uninitReason!=UR_CHARTCHANGE && ec->uninitReason!=UR_PARAMETERS && ec->uninitReason!=UR_ACCOUNT)
+         if (!IsInitCycleReason(ec->uninitReason)) {
             g_contextChains[id][1] = NULL;                           // mark main context as released if not in init cycle
+            if (!ec->testing) ReleaseProgram(id);                    // in Tester released by the next test (libraries may be re-used)
+         }
          break;
 
       case MT_LIBRARY:
          ec_SetRootFunction(ec, (RootFunction)NULL);                 // set library context to NULL
+         if (g_contextChains.size() > id && !g_contextChains[id][1]) {
+            EXECUTION_CONTEXT* master = g_contextChains[id][0];      // the main module has already left
+            if (master && !IsInitCycleReason(master->uninitReason) && !(master->programType==PT_EXPERT && master->testing)) {
+               ContextChain& chain = g_contextChains[id];
+               for (uint i=2; i < chain.size(); i++) {
+                  if (chain[i] == ec) chain[i] = NULL;               // mark library context as released
+               }
+               ReleaseProgram(id);
+            }
+         }
          return(FALSE);
 
       default:
          return(error(ERR_INVALID_PARAMETER, "invalid execution context:  ec.moduleType=%s", ModuleTypeToStr(ec->moduleType)));
    }
 
+   if (EXECUTION_CONTEXT* master = g_contextChains[id][0])          // NULL if the program was released
+      SyncProgramShadow(master);
    return(TRUE);
    #pragma EXPANDER_EXPORT
 }
 
 
+/**
+ * Release a program which left all its modules: free the master context, release the context chain's memory and mark the
+ * program id as reusable. Released ids are reused in release order, i.e. as late as possible. Ids of live programs never
+ * change. Programs with a module still registered in the chain are not released.
+ *
+ * @param  uint programId
+ *
+ * @return BOOL - whether the program was released
+ */
+BOOL WINAPI ReleaseProgram(uint programId) {
+   BOOL released = FALSE;
+
+   EnterCriticalSection(&g_terminalLock);
+   if (programId && programId < g_contextChains.size()) {
+      ContextChain&      chain  = g_contextChains[programId];
+      EXECUTION_CONTEXT* master = chain[0];
+
+      released = (master && !chain[1] && !master->initCycle);
+      for (uint i=2; released && i < chain.size(); i++) {
+         released = !chain[i];                                       // all libraries must have left
+      }
+      if (released) {
+         ContextChain(2).swap(chain);                                // keep [master, main] = [NULL, NULL] for existing checks
+         ReleaseProgramShadow(programId);
+         delete master;
+         ResetProgramAccount(programId);
+         ReleasePendingPass(programId);
+         releasedProgramIds.push_back(programId);
+
+         uint size = g_threadsPrograms.size();
+         for (uint i=0; i < size; i++) {                             // remove stale references to the program
+            if (g_threadsPrograms[i] == programId) g_threadsPrograms[i] = NULL;
+         }
+         if (g_lastUIThreadProgram == programId) g_lastUIThreadProgram = NULL;
+      }
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   return(released);
+}
+
+
+/**
+ * Find the expert of the previous test executed by a thread. The last program stored for the thread can't be used as it may
+ * be an indicator loaded by iCustom() or a reference cleared by a release. A candidate is verified by its master context:
+ * it must be an expert in the Tester last executed by the thread whose main module has left (chain[1] = NULL). A reused
+ * program id can't match as a new master context is created on reuse. If multiple candidates exist (a previous test whose
+ * chain wasn't released), the one with libraries in an init cycle is returned, the others are released by the next tests.
+ *
+ * @param  DWORD threadId  - thread executing the new test
+ * @param  uint  programId - program id of the new test's expert (skipped)
+ *
+ * @return uint - program id of the previous expert or NULL if there is none
+ */
+uint WINAPI FindPreviousTestExpert(DWORD threadId, uint programId) {
+   uint found = NULL;
+
+   EnterCriticalSection(&g_terminalLock);
+   uint size = g_contextChains.size();
+   for (uint id=1; id < size; id++) {
+      if (id == programId) continue;
+      const ContextChain& chain = g_contextChains[id];
+      const EXECUTION_CONTEXT* master = chain[0];
+      if (!master || chain[1])                                continue; // released or still running
+      if (master->programType!=PT_EXPERT || !master->testing) continue;
+      if (master->threadId != threadId)                       continue;
+
+      found = id;
+      if (master->initCycle) break;                                  // its libraries wait to be taken over
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   return(found);
+}
+
+
+/**
+ * Whether an UninitializeReason of a main module starts an init cycle, i.e. the program keeps its context chain and the main
+ * module re-enters init().
+ *
+ * @param  UninitializeReason reason
+ *
+ * @return BOOL
+ */
+BOOL WINAPI IsInitCycleReason(UninitializeReason reason) {
+   return(reason==UR_CHARTCHANGE || reason==UR_PARAMETERS || reason==UR_ACCOUNT);
+}
+
+
 /**
  * Find the chart of the current program and return its window handle. Replacement for the broken MQL function WindowHandle().
  * Also returns the correct window handle when the MQL function fails.
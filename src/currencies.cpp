@@ -0,0 +1,348 @@
+#include "expander.h"
+#include "currencies.h"
+#include "symbols.h"
+
+#include <vector>
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+// an edge of the currency graph: a currency pair quoted by one or more symbols (e.g. "EURUSD" and "EURUSD.mkt")
+struct CURRENCY_EDGE {
+   uint   base;                                                      // node index of the base currency
+   uint   quote;                                                     // node index of the quote currency
+   double rate;                                                      // mid price of the last quote (0: no quote yet)
+};
+
+
+// The graph is built from the symbol database and guarded by g_terminalLock. Currencies are nodes keyed by their interned
+// id, symbols map to edges by their interned id. The first edge of the path with the fewest conversions between each pair of
+// currencies is precomputed, so a rate update is O(1) and a cross rate is the product of the few rates along its path. Cross
+// rates are cached until the next rate update.
+uint                       currencyIds[MAX_CURRENCIES];              // interned currency id per node
+uint                       currencyCount;                            // number of nodes
+BYTE                       currencyNodes[MAX_INTERNED_SYMBOLS+1];    // node index + 1 per currency id (0: no node)
+std::vector<CURRENCY_EDGE> currencyEdges;
+WORD                       symbolEdges[MAX_INTERNED_SYMBOLS+1];      // edge index + 1 per symbol id (0: no edge)
+uint                       symbolProfitCurrencies[MAX_INTERNED_SYMBOLS+1];
+uint                       symbolMarginCurrencies[MAX_INTERNED_SYMBOLS+1];
+short                      nextEdges[MAX_CURRENCIES][MAX_CURRENCIES];  // first edge of the path between two nodes (-1: none)
+double                     crossRates[MAX_CURRENCIES][MAX_CURRENCIES];
+uint                       crossRateVersions[MAX_CURRENCIES][MAX_CURRENCIES];
+uint                       ratesVersion;                             // changed by every rate update (0: no graph)
+
+
+/**
+ * Return the quote currency of an FX-style symbol (the three characters following the base currency in the symbol name,
+ * e.g. "JPY" in "EURJPY.mkt").
+ *
+ * @param  SYMBOL& symbol
+ * @param  char    currency[] - buffer receiving the currency (min. 4 characters)
+ *
+ * @return BOOL - whether the symbol name starts with its base currency and contains a quote currency
+ */
+BOOL WINAPI symbolQuoteCurrency(const SYMBOL& symbol, char currency[]) {
+   const char* name = *symbol.altName ? symbol.altName : symbol.name;
+
+   if (strlen(symbol.baseCurrency) != 3 || strlen(name) < 6) return(FALSE);
+   if (strncmp(name, symbol.baseCurrency, 3) != 0)           return(FALSE);
+
+   for (int i=0; i < 3; ++i) {
+      char c = name[3+i];
+      if (c < 'A' || c > 'Z') return(FALSE);
+      currency[i] = c;
+   }
+   currency[3] = '\0';
+   return(TRUE);
+}
+
+
+/**
+ * Return the node index of a currency and add a node for it if the currency is not yet known.
+ *
+ * @param  uint currencyId - interned currency id
+ *
+ * @return int - node index or EMPTY (-1) if the graph is full
+ */
+int WINAPI currencyNode(uint currencyId) {
+   if (currencyNodes[currencyId]) return(currencyNodes[currencyId] - 1);
+   if (currencyCount >= MAX_CURRENCIES) return(EMPTY);
+
+   currencyIds[currencyCount] = currencyId;
+   currencyNodes[currencyId]  = (BYTE)++currencyCount;
+   return(currencyCount - 1);
+}
+
+
+/**
+ * Calculate the conversion rate between two nodes along their precomputed path. Must be called with g_terminalLock held.
+ *
+ * @param  uint from - node index of the source currency
+ * @param  uint to   - node index of the target currency
+ *
+ * @return double - rate (amount in 'to' per unit of 'from') or 0 if there is no path or a rate along the path is missing
+ */
+double WINAPI crossRate(uint from, uint to) {
+   if (crossRateVersions[from][to] == ratesVersion) return(crossRates[from][to]);
+
+   double rate = 1;
+   for (uint node=from; node != to; ) {
+      int e = nextEdges[node][to];
+      if (e < 0) { rate = 0; break; }
+      const CURRENCY_EDGE& edge = currencyEdges[e];
+      if (!edge.rate) { rate = 0; break; }
+
+      if (edge.base == node) { rate *= edge.rate; node = edge.quote; }
+      else                   { rate /= edge.rate; node = edge.base;  }
+   }
+   crossRates[from][to]        = rate;
+   crossRateVersions[from][to] = ratesVersion;
+   return(rate);
+}
+
+
+/**
+ * Build the currency graph from the symbol database. FX-style symbols (name starting with the base currency followed by the
+ * quote currency) become edges between their currencies. Symbols of the same currency pair share an edge which takes the
+ * rates of all of them. For each pair of currencies the path with the fewest conversions is precomputed (breadth-first
+ * search per currency). Rebuilding the graph discards all rates.
+ *
+ * The profit currency of a symbol is its quote currency. For other symbols (e.g. CFDs) it's the symbol's base currency.
+ *
+ * @param  SYMBOL symbols[] - symbol database (e.g. the content of "symbols.raw")
+ * @param  int    size      - number of symbols
+ *
+ * @return int - number of currencies in the graph or EMPTY (-1) in case of errors
+ */
+int WINAPI CurrencyGraph_Build(const SYMBOL symbols[], int size) {
+   if ((uint)symbols < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter symbols = 0x%p (not a valid pointer)", symbols)));
+   if (size < 0)                          return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+
+   EnterCriticalSection(&g_terminalLock);
+   currencyCount = 0;
+   currencyEdges.clear();
+   memset(currencyNodes,          0, sizeof(currencyNodes));
+   memset(symbolEdges,            0, sizeof(symbolEdges));
+   memset(symbolProfitCurrencies, 0, sizeof(symbolProfitCurrencies));
+   memset(symbolMarginCurrencies, 0, sizeof(symbolMarginCurrencies));
+
+   short pairEdges[MAX_CURRENCIES][MAX_CURRENCIES];                  // edge index per currency pair
+   memset(pairEdges, -1, sizeof(pairEdges));
+   char quote[4];
+
+   for (int i=0; i < size; ++i) {
+      const SYMBOL& symbol = symbols[i];
+      uint symbolId = InternSymbol(symbol.name);
+      if (!symbolId) continue;
+
+      BOOL isFx     = symbolQuoteCurrency(symbol, quote);
+      uint baseId   = *symbol.baseCurrency   ? InternSymbol(symbol.baseCurrency)   : 0;
+      uint quoteId  = isFx                   ? InternSymbol(quote)                 : 0;
+      uint marginId = *symbol.marginCurrency ? InternSymbol(symbol.marginCurrency) : 0;
+      symbolProfitCurrencies[symbolId] = isFx ? quoteId : baseId;
+      symbolMarginCurrencies[symbolId] = marginId;
+      if (!isFx || !baseId || !quoteId) continue;
+
+      int base = currencyNode(baseId), q = currencyNode(quoteId);
+      if (base < 0 || q < 0) {
+         warn(ERR_RUNTIME_ERROR, "skipping symbol \"%s\" (max. %d currencies)", symbol.name, MAX_CURRENCIES);
+         continue;
+      }
+      if (pairEdges[base][q] < 0) {
+         CURRENCY_EDGE edge = {base, q, 0};
+         pairEdges[base][q] = (short)currencyEdges.size();
+         currencyEdges.push_back(edge);
+      }
+      symbolEdges[symbolId] = pairEdges[base][q] + 1;
+   }
+
+   uint edgesSize = currencyEdges.size();
+   uint queue[MAX_CURRENCIES];
+   memset(nextEdges, -1, sizeof(nextEdges));
+
+   for (uint from=0; from < currencyCount; ++from) {                 // breadth-first search from each currency
+      short* first = nextEdges[from];
+      uint head=0, tail=0;
+      queue[tail++] = from;
+
+      while (head < tail) {
+         uint node = queue[head++];
+         for (uint e=0; e < edgesSize; ++e) {
+            const CURRENCY_EDGE& edge = currencyEdges[e];
+            uint next;
+            if      (edge.base  == node) next = edge.quote;
+            else if (edge.quote == node) next = edge.base;
+            else continue;
+            if (next == from || first[next] >= 0) continue;
+            first[next] = (node == from) ? (short)e : first[node];   // inherit the first edge of the path to 'node'
+            queue[tail++] = next;
+         }
+      }
+   }
+   memset(crossRateVersions, 0, sizeof(crossRateVersions));
+   ratesVersion = 1;
+   int count = currencyCount;
+   LeaveCriticalSection(&g_terminalLock);
+
+   return(count);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Update the rates of the currency graph from a quote snapshot. Each quote is matched to its edge by symbol id in O(1).
+ * Quotes of symbols without edge are ignored.
+ *
+ * @param  SYMBOL_SELECTED quotes[] - quotes (e.g. the content of "symbols.sel")
+ * @param  int             size     - number of quotes
+ *
+ * @return int - number of updated rates or EMPTY (-1) in case of errors
+ */
+int WINAPI CurrencyGraph_UpdateRates(const SYMBOL_SELECTED quotes[], int size) {
+   if ((uint)quotes < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter quotes = 0x%p (not a valid pointer)", quotes)));
+   if (size < 0)                         return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+
+   EnterCriticalSection(&g_terminalLock);
+   if (!ratesVersion) {
+      LeaveCriticalSection(&g_terminalLock);
+      return(_EMPTY(error(ERR_ILLEGAL_STATE, "currency graph not built")));
+   }
+   int updated = 0;
+   for (int i=0; i < size; ++i) {
+      const SYMBOL_SELECTED& quote = quotes[i];
+      uint symbolId = FindSymbolId(quote.symbol);
+      if (!symbolId || !symbolEdges[symbolId] || quote.bid <= 0 || quote.ask <= 0) continue;
+      currencyEdges[symbolEdges[symbolId]-1].rate = (quote.bid + quote.ask) / 2;
+      updated++;
+   }
+   if (updated && !++ratesVersion) ratesVersion = 1;                 // invalidate cached cross rates
+   LeaveCriticalSection(&g_terminalLock);
+
+   return(updated);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Update the rate of a single symbol of the currency graph.
+ *
+ * @param  uint   symbolId - interned symbol id
+ * @param  double bid
+ * @param  double ask
+ *
+ * @return BOOL - whether the symbol is an edge of the graph and the rate was updated
+ */
+BOOL WINAPI CurrencyGraph_UpdateRate(uint symbolId, double bid, double ask) {
+   if (!symbolId || symbolId > MAX_INTERNED_SYMBOLS) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d", symbolId));
+   if (bid <= 0 || ask <= 0)                         return(error(ERR_INVALID_PARAMETER, "invalid parameters bid = %f / ask = %f", bid, ask));
+
+   EnterCriticalSection(&g_terminalLock);
+   BOOL updated = FALSE;
+   if (ratesVersion && symbolEdges[symbolId]) {
+      currencyEdges[symbolEdges[symbolId]-1].rate = (bid + ask) / 2;
+      if (!++ratesVersion) ratesVersion = 1;
+      updated = TRUE;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   return(updated);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the profit currency of a symbol of the currency graph.
+ *
+ * @param  uint symbolId - interned symbol id
+ *
+ * @return uint - interned currency id or 0 if the symbol is unknown
+ */
+uint WINAPI GetProfitCurrency(uint symbolId) {
+   if (!symbolId || symbolId > MAX_INTERNED_SYMBOLS) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d", symbolId));
+   return(symbolProfitCurrencies[symbolId]);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the margin currency of a symbol of the currency graph.
+ *
+ * @param  uint symbolId - interned symbol id
+ *
+ * @return uint - interned currency id or 0 if the symbol is unknown
+ */
+uint WINAPI GetMarginCurrency(uint symbolId) {
+   if (!symbolId || symbolId > MAX_INTERNED_SYMBOLS) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d", symbolId));
+   return(symbolMarginCurrencies[symbolId]);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the conversion rate between two currencies (the mid price of a direct pair or the cross rate along the path with
+ * the fewest conversions).
+ *
+ * @param  uint fromCurrency - interned id of the source currency
+ * @param  uint toCurrency   - interned id of the target currency
+ *
+ * @return double - amount in 'toCurrency' per unit of 'fromCurrency' or 0 if no rate is available
+ */
+double WINAPI GetConversionRate(uint fromCurrency, uint toCurrency) {
+   if (!fromCurrency || fromCurrency > MAX_INTERNED_SYMBOLS) return(error(ERR_INVALID_PARAMETER, "invalid parameter fromCurrency = %d", fromCurrency));
+   if (!toCurrency   || toCurrency   > MAX_INTERNED_SYMBOLS) return(error(ERR_INVALID_PARAMETER, "invalid parameter toCurrency = %d", toCurrency));
+   if (fromCurrency == toCurrency) return(1);
+
+   EnterCriticalSection(&g_terminalLock);
+   uint from=currencyNodes[fromCurrency], to=currencyNodes[toCurrency];
+   double rate = (from && to) ? crossRate(from-1, to-1) : 0;
+   LeaveCriticalSection(&g_terminalLock);
+   return(rate);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Convert amounts in different currencies to a single currency (e.g. the P/L of orders to the account currency). The rate of
+ * each currency is resolved once per call.
+ *
+ * @param  uint   currencies[] - interned currency ids of the amounts (e.g. as returned by GetProfitCurrency())
+ * @param  double amounts[]    - amounts to convert
+ * @param  int    size         - number of amounts
+ * @param  uint   toCurrency   - interned id of the target currency
+ * @param  double results[]    - array receiving the converted amounts (may be the same as 'amounts')
+ *
+ * @return int - number of converted amounts or EMPTY (-1) in case of errors (e.g. a missing rate)
+ */
+int WINAPI ConvertAmounts(const uint currencies[], const double amounts[], int size, uint toCurrency, double results[]) {
+   if (size < 0)                                         return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+   if (size && (uint)currencies < MIN_VALID_POINTER)     return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter currencies = 0x%p (not a valid pointer)", currencies)));
+   if (size && (uint)amounts    < MIN_VALID_POINTER)     return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter amounts = 0x%p (not a valid pointer)", amounts)));
+   if (size && (uint)results    < MIN_VALID_POINTER)     return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter results = 0x%p (not a valid pointer)", results)));
+   if (!toCurrency || toCurrency > MAX_INTERNED_SYMBOLS) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter toCurrency = %d", toCurrency)));
+
+   EnterCriticalSection(&g_terminalLock);
+   uint to = currencyNodes[toCurrency];
+   double rates[MAX_CURRENCIES];                                     // rates to 'toCurrency' per node, resolved on first use
+   for (uint i=0; i < currencyCount; ++i) rates[i] = -1;
+
+   for (int i=0; i < size; ++i) {
+      uint currency = currencies[i];
+      double rate = 0;
+      if (currency == toCurrency) {
+         rate = 1;
+      }
+      else if (currency && currency <= MAX_INTERNED_SYMBOLS && to && currencyNodes[currency]) {
+         uint node = currencyNodes[currency] - 1;
+         if (rates[node] < 0) rates[node] = crossRate(node, to-1);
+         rate = rates[node];
+      }
+      if (!rate) {
+         LeaveCriticalSection(&g_terminalLock);
+         return(_EMPTY(error(ERR_RUNTIME_ERROR, "no conversion rate for currency id %d to currency id %d (amounts[%d])", currency, toCurrency, i)));
+      }
+      results[i] = amounts[i] * rate;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   return(size);
+   #pragma EXPANDER_EXPORT
+}
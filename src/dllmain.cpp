@@ -1,4 +1,10 @@
 #include "expander.h"
+#include "accounting.h"
+#include "capture.h"
+#include "jobs.h"
+#include "shadow.h"
+#include "trace.h"
+#include "tester/teststore.h"
 #include "util/ticktimer.h"
 #include "struct/xtrade/ExecutionContext.h"
 
@@ -14,7 +20,7 @@ CRITICAL_SECTION          g_terminalLock;                            // applicat
 
 // forward declarations
 BOOL WINAPI onProcessAttach();
-BOOL WINAPI onProcessDetach();
+BOOL WINAPI onProcessDetach(BOOL isTerminating);
 
 
 /**
@@ -24,10 +30,10 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fReason, LPVOID lpReserved) {
    BOOL result = TRUE;
 
    switch (fReason) {
-      case DLL_PROCESS_ATTACH: result = onProcessAttach(); break;
-      case DLL_THREAD_ATTACH :                             break;
-      case DLL_THREAD_DETACH :                             break;
-      case DLL_PROCESS_DETACH: result = onProcessDetach(); break;
+      case DLL_PROCESS_ATTACH: result = onProcessAttach();                   break;
+      case DLL_THREAD_ATTACH :                                               break;
+      case DLL_THREAD_DETACH : ReleaseThreadTrace();                         break;
+      case DLL_PROCESS_DETACH: result = onProcessDetach(lpReserved != NULL); break;
    }
    return(result);
 }
@@ -41,15 +47,29 @@ BOOL WINAPI onProcessAttach() {
    g_threadsPrograms.resize(0);
    g_contextChains  .resize(1);                             // index[0] stays empty (zero wouldn't be a valid MQL program id)
    InitializeCriticalSection(&g_terminalLock);
+   InitTrace();
+   InitTestStore();
    return(TRUE);
 }
 
 
 /**
- * Handler for DLL_PROCESS_DETACH events.
+ * Handler for DLL_PROCESS_DETACH events. Worker threads hold a reference to the DLL, so none of them is running when the DLL
+ * is unloaded and nothing has to be waited for. On process termination all other threads are already gone and may have left
+ * locks orphaned, the OS reclaims all resources and only an active capture is flushed.
+ *
+ * @param  BOOL isTerminating - whether the process is terminating (TRUE) or the DLL is unloaded by FreeLibrary() (FALSE)
  */
-BOOL WINAPI onProcessDetach() {
-   DeleteCriticalSection(&g_terminalLock);
+BOOL WINAPI onProcessDetach(BOOL isTerminating) {
+   ReleaseCapture();
+   if (isTerminating) return(TRUE);
+
+   ReleaseWatchdog();
+   ReleaseJobPool();
+   ReleaseTrace();
+   ReleaseProgramShadows();
    RemoveTickTimers();
+   ReleaseTestStore();
+   DeleteCriticalSection(&g_terminalLock);
    return(TRUE);
 }
@@ -1,4 +1,5 @@
 #include "expander.h"
+#include "trace.h"
 #include "util/helper.h"
 #include "util/toString.h"
 
@@ -248,6 +249,7 @@ void __error(const char* fileName, const char* funcName, int line, int code, con
    }
 
    OutputDebugString(fullMsg);
+   OnTraceError();                                                   // dump the context trace if configured
 }
 
 
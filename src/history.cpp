@@ -0,0 +1,248 @@
+#include "expander.h"
+#include "history.h"
+#include "struct/mt4/FxtHeader.h"
+#include "struct/mt4/FxtTick.h"
+#include "struct/mt4/HistoryBar400.h"
+#include "struct/mt4/HistoryBar401.h"
+#include "struct/mt4/HistoryHeader.h"
+#include "struct/mt4/Tick.h"
+#include "util/toString.h"
+
+
+/**
+ * Map a file read-only into memory. The file stays writable for other processes (the terminal keeps updating its history
+ * files while they are mapped).
+ *
+ * @param  char*        fileName - full file name
+ * @param  MAPPED_FILE* mf       - struct receiving the mapping
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI MapFile(const char* fileName, MAPPED_FILE* mf) {
+   if ((uint)fileName < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter fileName = 0x%p (not a valid pointer)", fileName));
+   if ((uint)mf       < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter mf = 0x%p (not a valid pointer)", mf));
+   ZeroMemory(mf, sizeof(MAPPED_FILE));
+
+   HANDLE hFile = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE) return(error(ERR_WIN32_ERROR+GetLastError(), "CreateFile(%s) failed", DoubleQuoteStr(fileName)));
+
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(hFile, &size)) {
+      error(ERR_WIN32_ERROR+GetLastError(), "GetFileSizeEx(%s) failed", DoubleQuoteStr(fileName));
+      return(_FALSE(CloseHandle(hFile)));
+   }
+   if (size.HighPart || size.LowPart > INT_MAX) {                    // a view must fit into the 32 bit address space
+      error(ERR_RUNTIME_ERROR, "file %s too large to be mapped (%I64d bytes)", DoubleQuoteStr(fileName), size.QuadPart);
+      return(_FALSE(CloseHandle(hFile)));
+   }
+   mf->hFile = hFile;
+   mf->size  = size.LowPart;
+   if (!mf->size) return(TRUE);                                      // empty files can't be mapped
+
+   mf->hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (!mf->hMapping) {
+      error(ERR_WIN32_ERROR+GetLastError(), "CreateFileMapping(%s) failed", DoubleQuoteStr(fileName));
+      UnmapFile(mf);
+      return(FALSE);
+   }
+   mf->data = (const BYTE*)MapViewOfFile(mf->hMapping, FILE_MAP_READ, 0, 0, 0);
+   if (!mf->data) {
+      error(ERR_WIN32_ERROR+GetLastError(), "MapViewOfFile(%s) failed", DoubleQuoteStr(fileName));
+      UnmapFile(mf);
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Release a file mapping created by MapFile().
+ *
+ * @param  MAPPED_FILE* mf
+ */
+void WINAPI UnmapFile(MAPPED_FILE* mf) {
+   if ((uint)mf < MIN_VALID_POINTER) return;
+
+   if (mf->data)     UnmapViewOfFile(mf->data);
+   if (mf->hMapping) CloseHandle(mf->hMapping);
+   if (mf->hFile)    CloseHandle(mf->hFile);
+   ZeroMemory(mf, sizeof(MAPPED_FILE));
+}
+
+
+/**
+ * Detect the type of a mapped history file by its content.
+ *
+ * @param  MAPPED_FILE* mf
+ *
+ * @return HistoryFileType - file type or HFT_UNKNOWN if the type could not be detected
+ */
+HistoryFileType WINAPI GetHistoryFileType(const MAPPED_FILE* mf) {
+   if (!mf->data) return(HFT_UNKNOWN);
+
+   if (mf->size >= sizeof(HISTORY_HEADER)) {
+      const HISTORY_HEADER* hh = (const HISTORY_HEADER*)mf->data;
+      if (hh->barFormat==400 && !((mf->size-sizeof(HISTORY_HEADER)) % sizeof(HISTORY_BAR_400))) return(HFT_HST_400);
+      if (hh->barFormat==401 && !((mf->size-sizeof(HISTORY_HEADER)) % sizeof(HISTORY_BAR_401))) return(HFT_HST_401);
+   }
+   if (mf->size >= sizeof(FXT_HEADER)) {
+      const FXT_HEADER* fh = (const FXT_HEADER*)mf->data;
+      if (fh->version==405 && !((mf->size-sizeof(FXT_HEADER)) % sizeof(FXT_TICK))) return(HFT_FXT);
+   }
+   if (!(mf->size % sizeof(TICK))) {                                 // "ticks.raw" has no header, a record starts with a symbol
+      const TICK* tick = (const TICK*)mf->data;
+      if (tick->symbol[0] && memchr(tick->symbol, 0, sizeof(tick->symbol))) return(HFT_TICKS);
+   }
+   return(HFT_UNKNOWN);
+}
+
+
+// record time accessors used by firstRecordAt()
+inline datetime recordTime(const HISTORY_BAR_400& bar ) { return(bar.time);                }
+inline datetime recordTime(const HISTORY_BAR_401& bar ) { return((datetime)bar.time);      }
+inline datetime recordTime(const FXT_TICK&        tick) { return((datetime)tick.tickTime); }
+
+
+/**
+ * Return the index of the first record with a time not less than the specified time (binary search).
+ *
+ * @param  T*       records - array of records sorted by time
+ * @param  uint     size    - number of records
+ * @param  datetime time
+ *
+ * @return uint - index or {size} if no such record exists
+ */
+template <typename T> uint firstRecordAt(const T* records, uint size, datetime time) {
+   uint lo=0, hi=size;
+   while (lo < hi) {
+      uint mid = lo + ((hi-lo) >> 1);
+      if (recordTime(records[mid]) < time) lo = mid + 1;
+      else                                 hi = mid;
+   }
+   return(lo);
+}
+
+
+/**
+ * Return the index of the first record to decode for a start time.
+ *
+ * @param  T*       records   - array of records sorted by time
+ * @param  uint     size      - number of records
+ * @param  datetime from      - start time
+ * @param  BOOL     coverFrom - whether to start with the record covering the start time, i.e. the last record at or before it
+ *
+ * @return uint - index or {size} if no such record exists
+ */
+template <typename T> uint firstRecordFrom(const T* records, uint size, datetime from, BOOL coverFrom) {
+   uint i = firstRecordAt(records, size, from);
+   if (coverFrom && i && (i==size || recordTime(records[i]) > from)) i--;
+   return(i);
+}
+
+
+/**
+ * Decode the price samples of a history or tick file into a PriceSeries. Bars of history files are decoded with their full
+ * OHLC range. Ticks of FXT files and of "ticks.raw" are decoded as samples with open=high=low=close=Bid. The file is mapped
+ * only during the call.
+ *
+ * @param  char*        fileName - full name of an HST, FXT or "ticks.raw" file
+ * @param  char*        symbol   - symbol to filter the ticks of "ticks.raw" by (ignored for other file types, NULL: no filter)
+ * @param  datetime     from     - start time of the samples to decode (inclusive, 0: from the beginning)
+ * @param  datetime     to       - end time of the samples to decode (inclusive, 0: up to the end)
+ * @param  PriceSeries& series    - vector receiving the samples in ascending time order (existing content is replaced)
+ * @param  BOOL         coverFrom - whether to start with the sample covering 'from', i.e. the last sample at or before it
+ *                                  (default: the first sample at or after 'from')
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI LoadPriceSeries(const char* fileName, const char* symbol, datetime from, datetime to, PriceSeries& series, BOOL coverFrom/*=FALSE*/) {
+   if (symbol && (uint)symbol < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbol = 0x%p (not a valid pointer)", symbol));
+   if (!to) to = INT_MAX;
+   if (from > to)                                  return(error(ERR_INVALID_PARAMETER, "invalid parameters from = %d / to = %d (from is larger than to)", from, to));
+   series.clear();
+
+   MAPPED_FILE mf;
+   if (!MapFile(fileName, &mf)) return(FALSE);
+
+   HistoryFileType type = GetHistoryFileType(&mf);
+   PRICE_BAR sample;
+
+   switch (type) {
+      case HFT_HST_400: {
+         const HISTORY_BAR_400* bars = (const HISTORY_BAR_400*)(mf.data + sizeof(HISTORY_HEADER));
+         uint size = (mf.size - sizeof(HISTORY_HEADER)) / sizeof(HISTORY_BAR_400);
+         uint i    = firstRecordFrom(bars, size, from, coverFrom);
+         uint end  = (to < INT_MAX) ? firstRecordAt(bars, size, to+1) : size;
+         series.reserve(end - i);
+         for (; i < end; ++i) {
+            sample.time  = bars[i].time;
+            sample.open  = bars[i].open;
+            sample.high  = bars[i].high;
+            sample.low   = bars[i].low;
+            sample.close = bars[i].close;
+            series.push_back(sample);
+         }
+         break;
+      }
+
+      case HFT_HST_401: {
+         const HISTORY_BAR_401* bars = (const HISTORY_BAR_401*)(mf.data + sizeof(HISTORY_HEADER));
+         uint size = (mf.size - sizeof(HISTORY_HEADER)) / sizeof(HISTORY_BAR_401);
+         uint i    = firstRecordFrom(bars, size, from, coverFrom);
+         uint end  = (to < INT_MAX) ? firstRecordAt(bars, size, to+1) : size;
+         series.reserve(end - i);
+         for (; i < end; ++i) {
+            sample.time  = (datetime)bars[i].time;
+            sample.open  = bars[i].open;
+            sample.high  = bars[i].high;
+            sample.low   = bars[i].low;
+            sample.close = bars[i].close;
+            series.push_back(sample);
+         }
+         break;
+      }
+
+      case HFT_FXT: {
+         const FXT_TICK* ticks = (const FXT_TICK*)(mf.data + sizeof(FXT_HEADER));
+         uint size = (mf.size - sizeof(FXT_HEADER)) / sizeof(FXT_TICK);
+         uint i    = firstRecordFrom(ticks, size, from, coverFrom);
+         uint end  = (to < INT_MAX) ? firstRecordAt(ticks, size, to+1) : size;
+         series.reserve(end - i);
+         for (; i < end; ++i) {
+            sample.time = (datetime)ticks[i].tickTime;
+            sample.open = sample.high = sample.low = sample.close = ticks[i].close;
+            series.push_back(sample);
+         }
+         break;
+      }
+
+      case HFT_TICKS: {                                              // "ticks.raw" mixes symbols, no binary search possible
+         const TICK* ticks = (const TICK*)mf.data;
+         uint size = mf.size / sizeof(TICK), covering = size;
+         for (uint i=0; i < size; ++i) {
+            if (symbol && strcmp(ticks[i].symbol, symbol) != 0) continue;
+            if (ticks[i].time < from) {
+               if (coverFrom && (covering==size || ticks[i].time >= ticks[covering].time)) covering = i;
+               continue;
+            }
+            if (ticks[i].time > to) continue;
+            sample.time = ticks[i].time;
+            sample.open = sample.high = sample.low = sample.close = ticks[i].bid;
+            series.push_back(sample);
+         }
+         if (covering < size && (series.empty() || series[0].time > from)) {
+            sample.time = ticks[covering].time;
+            sample.open = sample.high = sample.low = sample.close = ticks[covering].bid;
+            series.insert(series.begin(), sample);
+         }
+         break;
+      }
+
+      default:
+         UnmapFile(&mf);
+         return(error(ERR_FILE_INCOMPATIBLE, "unsupported file format of %s", DoubleQuoteStr(fileName)));
+   }
+
+   UnmapFile(&mf);
+   return(TRUE);
+}
@@ -0,0 +1,549 @@
+#include "expander.h"
+#include "jobs.h"
+#include "util/helper.h"
+#include "util/toString.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+#define JOB_POLL_INTERVAL     10                                     // interval of reading pipes and checking timeouts (msec)
+#define JOB_READ_CHUNK        4096                                   // bytes read from a pipe at once
+
+
+// a job of the process pool
+struct JOB {
+   int               id;
+   string            cmdLine;
+   string            directory;                                      // working directory (empty: the terminal's directory)
+   uint              timeout;                                        // max. run time in milliseconds (0: no limit)
+   volatile int      status;                                         // JobStatus
+   volatile BOOL     killRequested;
+   DWORD             exitCode;
+   DWORD             submittedAt;                                    // GetTickCount() values
+   DWORD             startedAt;
+   DWORD             finishedAt;
+   HANDLE            hProcess;                                       // owned by the manager thread while the job is running
+   HANDLE            hJob;                                           // job object of the process and its children (NULL: none)
+   HANDLE            hOutput;                                        // read end of the stdout/stderr pipe
+   std::vector<char> output;                                         // ring buffer of the captured output (allocated on start)
+   uint64            written;                                        // total bytes written to the ring buffer
+   uint64            read;                                           // total bytes consumed by JobPool_ReadOutput()
+   uint64            dropped;                                        // total bytes overwritten before they were read
+};
+
+
+// Jobs are started by a single manager thread. It waits for process exits and wakeup events and polls the output pipes
+// every JOB_POLL_INTERVAL while processes are running. The thread runs only while jobs are queued or running and holds a
+// reference to the DLL, so the DLL stays loaded until all jobs ended. Each process is assigned to its own job object, which
+// kills the process and all its children when the job object is closed (also if the terminal exits or crashes). The job list
+// is guarded by g_terminalLock, which is never held while a process is started or a pipe is read.
+std::vector<JOB*> jobs;                                              // all jobs (index = id-1, NULL: released)
+std::deque<int>   jobQueue;                                          // ids of submitted jobs waiting for a process slot
+uint              jobConcurrency;                                    // max. number of concurrent processes (0: not initialized)
+
+HANDLE            hJobManager;                                       // the current or last manager thread
+HANDLE            hJobWakeup;                                        // auto-reset event waking the manager thread
+BOOL              jobManagerActive;                                  // whether a manager thread runs and accepts new jobs
+
+
+/**
+ * Return the job with the specified id. Must be called with g_terminalLock held.
+ *
+ * @param  int jobId
+ *
+ * @return JOB* - job or NULL if the id is unknown or the job was released
+ */
+JOB* WINAPI getJob(int jobId) {
+   if (jobId < 1 || jobId > (int)jobs.size()) return(NULL);
+   return(jobs[jobId-1]);
+}
+
+
+/**
+ * Create a job object which kills all its processes when its last handle is closed.
+ *
+ * @return HANDLE - job object or NULL in case of errors
+ */
+HANDLE WINAPI createKillOnCloseJob() {
+   HANDLE hJob = CreateJobObject(NULL, NULL);
+   if (!hJob) return(NULL);
+
+   JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {};
+   limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+   if (!SetInformationJobObject(hJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits))) {
+      CloseHandle(hJob);
+      return(NULL);
+   }
+   return(hJob);
+}
+
+
+/**
+ * Start the process of a job with stdout and stderr redirected to a pipe. The process is started suspended and assigned to a
+ * job object before it runs, so all processes it creates belong to the job object, too. If the process can't be assigned (e.g.
+ * the terminal runs in a job object not allowing nested jobs on Windows 7 and older) only the process itself can be killed.
+ * Called by the manager thread.
+ *
+ * @param  JOB* job
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI startJobProcess(JOB* job) {
+   SECURITY_ATTRIBUTES sa = {sizeof(SECURITY_ATTRIBUTES), NULL, TRUE};
+   HANDLE hRead, hWrite;
+   if (!CreatePipe(&hRead, &hWrite, &sa, JOB_OUTPUT_SIZE)) return(warn(ERR_WIN32_ERROR+GetLastError(), "job %d: CreatePipe() failed", job->id));
+   SetHandleInformation(hRead, HANDLE_FLAG_INHERIT, 0);              // only the write end is inherited
+
+   HANDLE hJob = createKillOnCloseJob();
+   if (!hJob) {
+      DWORD lastError = GetLastError();
+      CloseHandle(hRead);
+      CloseHandle(hWrite);
+      return(warn(ERR_WIN32_ERROR+lastError, "job %d: creating the job object failed", job->id));
+   }
+
+   STARTUPINFOA si = {};
+   si.cb          = sizeof(si);
+   si.dwFlags     = STARTF_USESTDHANDLES|STARTF_USESHOWWINDOW;
+   si.wShowWindow = SW_HIDE;
+   si.hStdInput   = NULL;
+   si.hStdOutput  = hWrite;
+   si.hStdError   = hWrite;
+
+   PROCESS_INFORMATION pi = {};
+   std::vector<char> cmdLine(job->cmdLine.begin(), job->cmdLine.end());
+   cmdLine.push_back('\0');                                          // CreateProcess() may modify the command line
+   const char* directory = job->directory.empty() ? NULL : job->directory.c_str();
+
+   BOOL success = CreateProcessA(NULL, &cmdLine[0], NULL, NULL, TRUE, CREATE_NO_WINDOW|CREATE_SUSPENDED, NULL, directory, &si, &pi);
+   DWORD lastError = GetLastError();
+   CloseHandle(hWrite);                                              // the pipe breaks as soon as the child closes its end
+   if (!success) {
+      CloseHandle(hRead);
+      CloseHandle(hJob);
+      return(warn(ERR_WIN32_ERROR+lastError, "job %d: CreateProcess(%s) failed", job->id, DoubleQuoteStr(job->cmdLine.c_str())));
+   }
+   if (!AssignProcessToJobObject(hJob, pi.hProcess)) {
+      warn(ERR_WIN32_ERROR+GetLastError(), "job %d: AssignProcessToJobObject() failed (child processes can't be killed)", job->id);
+      CloseHandle(hJob);
+      hJob = NULL;
+   }
+   ResumeThread(pi.hThread);
+   CloseHandle(pi.hThread);
+   job->hProcess = pi.hProcess;
+   job->hJob     = hJob;
+   job->hOutput  = hRead;
+   return(TRUE);
+}
+
+
+/**
+ * Append data to the output ring buffer of a job. If the reader falls behind the oldest unread bytes are overwritten. Must be
+ * called with g_terminalLock held.
+ *
+ * @param  JOB*  job
+ * @param  char* data
+ * @param  uint  size - number of bytes (not more than JOB_OUTPUT_SIZE)
+ */
+void WINAPI appendJobOutput(JOB* job, const char* data, uint size) {
+   uint pos   = (uint)(job->written % JOB_OUTPUT_SIZE);
+   uint part1 = std::min(size, JOB_OUTPUT_SIZE - pos);
+   memcpy(&job->output[pos], data, part1);
+   memcpy(&job->output[0], data + part1, size - part1);
+   job->written += size;
+
+   if (job->written - job->read > JOB_OUTPUT_SIZE) {
+      uint64 lost = job->written - job->read - JOB_OUTPUT_SIZE;
+      job->dropped += lost;
+      job->read    += lost;
+   }
+}
+
+
+/**
+ * Read all data currently available in the output pipe of a job into its ring buffer. Never blocks. Called by the manager
+ * thread.
+ *
+ * @param  JOB* job
+ */
+void WINAPI drainJobOutput(JOB* job) {
+   char buffer[JOB_READ_CHUNK];
+   DWORD available, bytes;
+
+   while (PeekNamedPipe(job->hOutput, NULL, 0, NULL, &available, NULL) && available) {
+      if (!ReadFile(job->hOutput, buffer, std::min(available, (DWORD)JOB_READ_CHUNK), &bytes, NULL) || !bytes)
+         break;
+      EnterCriticalSection(&g_terminalLock);
+      appendJobOutput(job, buffer, bytes);
+      LeaveCriticalSection(&g_terminalLock);
+   }
+}
+
+
+/**
+ * Finish a running job. A process still running is terminated together with all its child processes. Child processes left
+ * running by a finished process are terminated when the job object is closed. Called by the manager thread.
+ *
+ * @param  JOB*      job
+ * @param  JobStatus status - final status of the job
+ */
+void WINAPI finishJob(JOB* job, JobStatus status) {
+   if (status != JS_FINISHED) {
+      if (job->hJob) TerminateJobObject(job->hJob, 1);
+      else           TerminateProcess(job->hProcess, 1);
+      WaitForSingleObject(job->hProcess, 1000);
+   }
+   drainJobOutput(job);                                              // output written right before the exit
+
+   DWORD exitCode = 0;
+   GetExitCodeProcess(job->hProcess, &exitCode);
+   CloseHandle(job->hProcess);
+   CloseHandle(job->hOutput);
+   if (job->hJob) CloseHandle(job->hJob);                            // kills remaining child processes
+
+   EnterCriticalSection(&g_terminalLock);
+   job->hProcess   = job->hJob = job->hOutput = NULL;
+   job->exitCode   = exitCode;
+   job->finishedAt = GetTickCount();
+   job->status     = status;                                         // last access of the manager thread
+   LeaveCriticalSection(&g_terminalLock);
+}
+
+
+/**
+ * Manager thread of the process pool. Starts queued jobs while process slots are free, captures the output of running jobs
+ * and finishes jobs which exited, timed out or were killed. The thread ends as soon as no jobs are queued or running.
+ *
+ * @param  LPVOID arg - unused
+ *
+ * @return DWORD - 0
+ */
+DWORD WINAPI jobManager(LPVOID arg) {
+   std::vector<JOB*> running;
+   HANDLE handles[MAX_JOB_CONCURRENCY+1];
+   BOOL idle = FALSE;
+
+   for (;;) {
+      for (;;) {                                                     // start queued jobs
+         JOB* job = NULL;
+         EnterCriticalSection(&g_terminalLock);
+         while (!job && !jobQueue.empty() && running.size() < jobConcurrency) {
+            job = getJob(jobQueue.front());
+            jobQueue.pop_front();
+            if (job && job->status != JS_QUEUED) job = NULL;         // killed or released while queued
+         }
+         if (job) {
+            job->status    = JS_RUNNING;
+            job->startedAt = GetTickCount();
+            job->output.resize(JOB_OUTPUT_SIZE);
+         }
+         else if (running.empty() && jobQueue.empty()) {
+            jobManagerActive = FALSE;                                // new jobs start a new thread
+            idle = TRUE;
+         }
+         LeaveCriticalSection(&g_terminalLock);
+         if (!job) break;
+
+         if (startJobProcess(job)) {
+            running.push_back(job);
+            continue;
+         }
+         EnterCriticalSection(&g_terminalLock);
+         job->finishedAt = GetTickCount();
+         job->status     = JS_FAILED;
+         LeaveCriticalSection(&g_terminalLock);
+      }
+      if (idle) break;
+
+      handles[0] = hJobWakeup;
+      for (uint i=0; i < running.size(); ++i) {
+         handles[i+1] = running[i]->hProcess;
+      }
+      WaitForMultipleObjects(running.size()+1, handles, FALSE, running.empty() ? INFINITE : JOB_POLL_INTERVAL);
+
+      DWORD now = GetTickCount();
+      for (uint i=0; i < running.size();) {                          // capture output and finish jobs
+         JOB* job = running[i];
+         drainJobOutput(job);
+
+         JobStatus status = JS_RUNNING;
+         if      (WaitForSingleObject(job->hProcess, 0) == WAIT_OBJECT_0)   status = JS_FINISHED;
+         else if (job->killRequested)                                       status = JS_KILLED;
+         else if (job->timeout && now - job->startedAt >= job->timeout)     status = JS_TIMEOUT;
+         if (status == JS_RUNNING) {
+            i++;
+            continue;
+         }
+         finishJob(job, status);
+         running.erase(running.begin() + i);
+      }
+   }
+
+   ExitWorkerThread();                                               // releases the DLL reference, doesn't return
+   return(0);
+}
+
+
+/**
+ * Return the default number of concurrent processes of the process pool (the number of processors).
+ *
+ * @return uint
+ */
+uint WINAPI defaultJobConcurrency() {
+   SYSTEM_INFO si;
+   GetSystemInfo(&si);
+   return(std::min((uint)si.dwNumberOfProcessors, (uint)MAX_JOB_CONCURRENCY));
+}
+
+
+/**
+ * Start the manager thread of the process pool if it isn't running. Must be called with g_terminalLock held.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI startJobManager() {
+   if (jobManagerActive) return(TRUE);
+
+   if (!jobConcurrency) jobConcurrency = defaultJobConcurrency();
+   if (!hJobWakeup) {
+      hJobWakeup = CreateEvent(NULL, FALSE, FALSE, NULL);
+      if (!hJobWakeup) return(error(ERR_WIN32_ERROR+GetLastError(), "CreateEvent() failed"));
+   }
+   if (hJobManager) CloseHandle(hJobManager);                        // a previous thread which ended when idle
+   hJobManager = CreateWorkerThread(jobManager, NULL);
+   if (!hJobManager) return(FALSE);
+
+   jobManagerActive = TRUE;
+   return(TRUE);
+}
+
+
+/**
+ * Set the max. number of concurrently running processes of the process pool. Running processes are not affected if the
+ * number is decreased. The default is the number of processors.
+ *
+ * @param  int processes - max. number of processes: 1...MAX_JOB_CONCURRENCY
+ *
+ * @return int - the previous value or EMPTY (-1) in case of errors
+ */
+int WINAPI JobPool_SetConcurrency(int processes) {
+   if (processes < 1 || processes > MAX_JOB_CONCURRENCY) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter processes = %d (must be 1...%d)", processes, MAX_JOB_CONCURRENCY)));
+
+   EnterCriticalSection(&g_terminalLock);
+   if (!jobConcurrency) jobConcurrency = defaultJobConcurrency();
+   int previous = jobConcurrency;
+   jobConcurrency = processes;
+   if (hJobWakeup) SetEvent(hJobWakeup);
+   LeaveCriticalSection(&g_terminalLock);
+   return(previous);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Submit a job to the process pool. The call returns immediately, the job is started as soon as a process slot is free. The
+ * output of the process (stdout and stderr) is captured in a ring buffer of JOB_OUTPUT_SIZE bytes, which is allocated when the
+ * process starts.
+ *
+ * @param  char* cmdLine   - command line of the process
+ * @param  char* directory - working directory of the process (NULL or empty: the terminal's working directory)
+ * @param  int   timeout   - max. run time of the process in milliseconds (0: no limit)
+ *
+ * @return int - job id or EMPTY (-1) in case of errors
+ */
+int WINAPI JobPool_Submit(const char* cmdLine, const char* directory, int timeout) {
+   if ((uint)cmdLine < MIN_VALID_POINTER)                  return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter cmdLine = 0x%p (not a valid pointer)", cmdLine)));
+   if (!*cmdLine)                                          return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter cmdLine = \"\" (empty)")));
+   if (directory && (uint)directory < MIN_VALID_POINTER)   return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter directory = 0x%p (not a valid pointer)", directory)));
+   if (timeout < 0)                                        return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter timeout = %d", timeout)));
+
+   JOB* job = new JOB;
+   job->id            = 0;
+   job->cmdLine       = cmdLine;
+   job->directory     = directory ? directory : "";
+   job->timeout       = timeout;
+   job->status        = JS_QUEUED;
+   job->killRequested = FALSE;
+   job->exitCode      = 0;
+   job->submittedAt   = GetTickCount();
+   job->startedAt     = job->finishedAt = 0;
+   job->hProcess      = job->hJob = job->hOutput = NULL;
+   job->written       = job->read = job->dropped = 0;
+
+   EnterCriticalSection(&g_terminalLock);
+   if (!startJobManager()) {
+      LeaveCriticalSection(&g_terminalLock);
+      delete job;
+      return(EMPTY);
+   }
+   jobs.push_back(job);
+   job->id = jobs.size();
+   jobQueue.push_back(job->id);
+   SetEvent(hJobWakeup);
+   LeaveCriticalSection(&g_terminalLock);
+   return(job->id);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the status of a job. Cheap enough to be polled on every tick.
+ *
+ * @param  int jobId
+ *
+ * @return int - JobStatus or EMPTY (-1) if the job is unknown
+ */
+int WINAPI JobPool_GetStatus(int jobId) {
+   EnterCriticalSection(&g_terminalLock);
+   JOB* job = getJob(jobId);
+   int status = job ? job->status : EMPTY;
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (!job) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter jobId = %d (unknown job)", jobId)));
+   return(status);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return status, exit code, timings and output counters of a job.
+ *
+ * @param  int       jobId
+ * @param  JOB_INFO* info - struct receiving the job information
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI JobPool_GetJobInfo(int jobId, JOB_INFO* info) {
+   if ((uint)info < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter info = 0x%p (not a valid pointer)", info));
+
+   EnterCriticalSection(&g_terminalLock);
+   JOB* job = getJob(jobId);
+   if (job) {
+      DWORD now = GetTickCount();
+      info->id            = job->id;
+      info->status        = job->status;
+      info->exitCode      = (job->status==JS_QUEUED || job->status==JS_RUNNING) ? 0 : job->exitCode;
+      info->queueTime     = (job->status==JS_QUEUED) ? now - job->submittedAt : job->startedAt - job->submittedAt;
+      info->runTime       = (job->status==JS_QUEUED) ? 0 : (job->status==JS_RUNNING) ? now - job->startedAt : job->finishedAt - job->startedAt;
+      info->outputSize    = (uint)job->written;
+      info->outputDropped = (uint)job->dropped;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (!job) return(error(ERR_INVALID_PARAMETER, "invalid parameter jobId = %d (unknown job)", jobId));
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Read the captured output of a job which was not yet read. Output can be read while the job is running. Bytes overwritten
+ * in the ring buffer before they were read are lost (see JOB_INFO.outputDropped).
+ *
+ * @param  int   jobId
+ * @param  char* buffer     - buffer receiving the output (null-terminated)
+ * @param  int   bufferSize - size of the buffer (at most bufferSize-1 bytes are read, the rest stays unread)
+ *
+ * @return int - number of bytes read or EMPTY (-1) in case of errors
+ */
+int WINAPI JobPool_ReadOutput(int jobId, char* buffer, int bufferSize) {
+   if ((uint)buffer < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter buffer = 0x%p (not a valid pointer)", buffer)));
+   if (bufferSize < 1)                   return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter bufferSize = %d", bufferSize)));
+
+   EnterCriticalSection(&g_terminalLock);
+   JOB* job = getJob(jobId);
+   uint size = 0;
+   if (job) {
+      size = (uint)std::min(job->written - job->read, (uint64)(bufferSize-1));
+      if (size) {                                                    // the ring buffer of a queued job is not yet allocated
+         uint pos   = (uint)(job->read % JOB_OUTPUT_SIZE);
+         uint part1 = std::min(size, JOB_OUTPUT_SIZE - pos);
+         memcpy(buffer, &job->output[pos], part1);
+         memcpy(buffer + part1, &job->output[0], size - part1);
+         job->read += size;
+      }
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (!job) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter jobId = %d (unknown job)", jobId)));
+   buffer[size] = '\0';
+   return(size);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Kill a job. A queued job is removed from the queue, the process of a running job is terminated by the manager thread. Killing
+ * a job which already ended has no effect.
+ *
+ * @param  int jobId
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI JobPool_Kill(int jobId) {
+   EnterCriticalSection(&g_terminalLock);
+   JOB* job = getJob(jobId);
+   if (job) {
+      if (job->status == JS_QUEUED) {
+         job->startedAt  = job->finishedAt = GetTickCount();
+         job->status     = JS_KILLED;
+      }
+      else if (job->status == JS_RUNNING) {
+         job->killRequested = TRUE;
+         SetEvent(hJobWakeup);
+      }
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (!job) return(error(ERR_INVALID_PARAMETER, "invalid parameter jobId = %d (unknown job)", jobId));
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Release a job which is no longer queued or running. Its id becomes invalid and its output is discarded.
+ *
+ * @param  int jobId
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI JobPool_Release(int jobId) {
+   EnterCriticalSection(&g_terminalLock);
+   JOB* job = getJob(jobId);
+   int status = job ? job->status : 0;
+   if (job && status!=JS_QUEUED && status!=JS_RUNNING) {
+      jobs[jobId-1] = NULL;
+      delete job;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (!job)                                   return(error(ERR_INVALID_PARAMETER, "invalid parameter jobId = %d (unknown job)", jobId));
+   if (status==JS_QUEUED || status==JS_RUNNING) return(error(ERR_ILLEGAL_STATE, "cannot release job %d (still %s)", jobId, status==JS_QUEUED ? "queued" : "running"));
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Release the process pool on DLL_PROCESS_DETACH. The manager thread can't be running at this point: it holds a reference to
+ * the DLL, so the DLL is unloaded either by the thread's own exit (no jobs are left) or on process termination (where cleanup
+ * is skipped and the job objects kill all processes).
+ */
+void WINAPI ReleaseJobPool() {
+   if (hJobManager) CloseHandle(hJobManager);
+   if (hJobWakeup)  CloseHandle(hJobWakeup);
+   hJobManager = hJobWakeup = NULL;
+   jobManagerActive = FALSE;
+
+   for (uint i=0; i < jobs.size(); ++i) {
+      delete jobs[i];
+   }
+   jobs.clear();
+   jobQueue.clear();
+}
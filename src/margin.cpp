@@ -0,0 +1,251 @@
+#include "expander.h"
+#include "currencies.h"
+#include "margin.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+// margin and swap parameters of a symbol
+struct MARGIN_SYMBOL {
+   BOOL   known;
+   uint   baseCurrency;                                              // interned currency id
+   double contractSize;
+   double marginNet;                                                 // margin per lot of the net position in margin currency
+   double marginHedged;                                              // margin per hedged lot in margin currency
+   double marginDivider;
+   double pointSize;
+   BOOL   swapEnabled;
+   uint   swapType;
+   double swapLong;
+   double swapShort;
+   uint   swapTripleDay;
+};
+
+
+// aggregated open positions of a symbol in a CalculateMarginSwap() call
+struct SYMBOL_EXPOSURE {
+   uint   symbolId;
+   double longLots;
+   double shortLots;
+   double marginPerLot;                                              // in account currency
+   double swapLong;                                                  // per lot (and per unit of the open price) in account currency
+   double swapShort;
+   BOOL   perPrice;                                                  // whether the swaps are per unit of the open price
+};
+
+
+std::vector<MARGIN_SYMBOL> marginSymbols;                            // symbol parameters by symbol id (guarded by g_terminalLock)
+
+
+/**
+ * Register the margin and swap parameters of the symbols of a symbol database. Registered symbols replace previously
+ * registered symbols of the same name.
+ *
+ * @param  SYMBOL symbols[] - symbol database (e.g. the content of "symbols.raw")
+ * @param  int    size      - number of symbols
+ *
+ * @return int - number of registered symbols or EMPTY (-1) in case of errors
+ */
+int WINAPI MarginCalculator_Init(const SYMBOL symbols[], int size) {
+   if ((uint)symbols < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter symbols = 0x%p (not a valid pointer)", symbols)));
+   if (size < 0)                          return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+
+   EnterCriticalSection(&g_terminalLock);
+   int registered = 0;
+
+   for (int i=0; i < size; ++i) {
+      const SYMBOL& symbol = symbols[i];
+      uint symbolId = InternSymbol(symbol.name);
+      if (!symbolId) continue;
+      if (symbolId >= marginSymbols.size()) marginSymbols.resize(symbolId + 1);
+
+      MARGIN_SYMBOL& ms = marginSymbols[symbolId];
+      ms.known         = TRUE;
+      ms.baseCurrency  = *symbol.baseCurrency ? InternSymbol(symbol.baseCurrency) : 0;
+      ms.contractSize  = symbol.contractSize;
+      ms.marginNet     = symbol.marginInit ? symbol.marginInit : symbol.contractSize;
+      ms.marginHedged  = symbol.marginHedged;
+      ms.marginDivider = symbol.marginDivider > 0 ? symbol.marginDivider : 1;
+      ms.pointSize     = symbol.pointSize;
+      ms.swapEnabled   = symbol.swapEnabled;
+      ms.swapType      = symbol.swapType;
+      ms.swapLong      = symbol.swapLongValue;
+      ms.swapShort     = symbol.swapShortValue;
+      ms.swapTripleDay = symbol.swapTripleRolloverDay;
+      registered++;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   return(registered);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the base currency of a symbol registered by MarginCalculator_Init().
+ *
+ * @param  uint symbolId - interned symbol id
+ *
+ * @return uint - interned currency id or 0 if the symbol is unknown
+ */
+uint WINAPI GetBaseCurrency(uint symbolId) {
+   if (!symbolId || symbolId > MAX_INTERNED_SYMBOLS) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d", symbolId));
+
+   EnterCriticalSection(&g_terminalLock);
+   uint currency = (symbolId < marginSymbols.size()) ? marginSymbols[symbolId].baseCurrency : 0;
+   LeaveCriticalSection(&g_terminalLock);
+   return(currency);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the contract size of a symbol registered by MarginCalculator_Init().
+ *
+ * @param  uint symbolId - interned symbol id
+ *
+ * @return double - contract size (units of the base currency per lot) or 0 if the symbol is unknown
+ */
+double WINAPI GetContractSize(uint symbolId) {
+   if (!symbolId || symbolId > MAX_INTERNED_SYMBOLS) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d", symbolId));
+
+   EnterCriticalSection(&g_terminalLock);
+   double size = (symbolId < marginSymbols.size()) ? marginSymbols[symbolId].contractSize : 0;
+   LeaveCriticalSection(&g_terminalLock);
+   return(size);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate the required margin and the swap of the next rollover of a set of open orders in account currency in one call.
+ *
+ * Margin is calculated per symbol from the netted position: the net lots require the symbol's initial margin (or contract
+ * size) per lot, the hedged lots the symbol's hedged margin, divided by the account leverage and the symbol's margin divider
+ * (interpreted as relative to the account leverage). An order's margin is the symbol's margin pro rata to its lots.
+ *
+ * Swaps depend on the symbol's swap type (0: points, 1: base currency, 2: interest p.a. of the open price, 3: margin
+ * currency). Rollovers on the symbol's triple rollover day count three times, rollovers on a weekend don't occur.
+ *
+ * Symbols must be registered by MarginCalculator_Init(), conversion rates are taken from the currency graph (see
+ * CurrencyGraph_Build()). Pending orders are ignored (margin and swap 0).
+ *
+ * @param  uint     symbolIds[]     - interned symbol ids of the orders
+ * @param  int      types[]         - order types
+ * @param  double   lots[]          - order sizes
+ * @param  double   openPrices[]    - open prices
+ * @param  int      size            - number of orders
+ * @param  uint     accountCurrency - interned id of the account currency
+ * @param  int      leverage        - account leverage
+ * @param  datetime rolloverTime    - server time of the rollover to calculate the swap for
+ * @param  double   margins[]       - array receiving the margin of each order (optional)
+ * @param  double   swaps[]         - array receiving the swap of each order (optional)
+ * @param  double*  totalMargin     - variable receiving the total margin (optional)
+ * @param  double*  totalSwap       - variable receiving the total swap (optional)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CalculateMarginSwap(const uint symbolIds[], const int types[], const double lots[], const double openPrices[], int size, uint accountCurrency, int leverage, datetime rolloverTime, double margins[], double swaps[], double* totalMargin, double* totalSwap) {
+   if (size < 0)                                                   return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if (size && (uint)symbolIds  < MIN_VALID_POINTER)               return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolIds = 0x%p (not a valid pointer)", symbolIds));
+   if (size && (uint)types      < MIN_VALID_POINTER)               return(error(ERR_INVALID_PARAMETER, "invalid parameter types = 0x%p (not a valid pointer)", types));
+   if (size && (uint)lots       < MIN_VALID_POINTER)               return(error(ERR_INVALID_PARAMETER, "invalid parameter lots = 0x%p (not a valid pointer)", lots));
+   if (size && (uint)openPrices < MIN_VALID_POINTER)               return(error(ERR_INVALID_PARAMETER, "invalid parameter openPrices = 0x%p (not a valid pointer)", openPrices));
+   if (!accountCurrency || accountCurrency > MAX_INTERNED_SYMBOLS) return(error(ERR_INVALID_PARAMETER, "invalid parameter accountCurrency = %d", accountCurrency));
+   if (leverage < 1)                                               return(error(ERR_INVALID_PARAMETER, "invalid parameter leverage = %d", leverage));
+   if (margins     && (uint)margins     < MIN_VALID_POINTER)       return(error(ERR_INVALID_PARAMETER, "invalid parameter margins = 0x%p (not a valid pointer)", margins));
+   if (swaps       && (uint)swaps       < MIN_VALID_POINTER)       return(error(ERR_INVALID_PARAMETER, "invalid parameter swaps = 0x%p (not a valid pointer)", swaps));
+   if (totalMargin && (uint)totalMargin < MIN_VALID_POINTER)       return(error(ERR_INVALID_PARAMETER, "invalid parameter totalMargin = 0x%p (not a valid pointer)", totalMargin));
+   if (totalSwap   && (uint)totalSwap   < MIN_VALID_POINTER)       return(error(ERR_INVALID_PARAMETER, "invalid parameter totalSwap = 0x%p (not a valid pointer)", totalSwap));
+
+   uint weekday = ((uint)rolloverTime / 86400 + 4) % 7;              // 01.01.1970 was a Thursday
+   BOOL weekend = (weekday==SATURDAY || weekday==SUNDAY);
+
+   std::vector<WORD>            slots(MAX_INTERNED_SYMBOLS+1, 0);    // exposure index + 1 per symbol id
+   std::vector<SYMBOL_EXPOSURE> exposures;
+
+   EnterCriticalSection(&g_terminalLock);
+   uint symbolsSize = marginSymbols.size();
+
+   for (int i=0; i < size; ++i) {                                    // aggregate long and short lots per symbol
+      if (types[i]!=OP_BUY && types[i]!=OP_SELL) continue;
+      uint symbolId = symbolIds[i];
+      if (!symbolId || symbolId >= symbolsSize || !marginSymbols[symbolId].known) {
+         LeaveCriticalSection(&g_terminalLock);
+         return(error(ERR_INVALID_PARAMETER, "invalid symbolIds[%d] = %d (unknown symbol)", i, symbolId));
+      }
+      if (!slots[symbolId]) {
+         SYMBOL_EXPOSURE exposure = {symbolId};
+         exposures.push_back(exposure);
+         slots[symbolId] = (WORD)exposures.size();
+      }
+      SYMBOL_EXPOSURE& exposure = exposures[slots[symbolId]-1];
+      if (types[i] == OP_BUY) exposure.longLots  += lots[i];
+      else                    exposure.shortLots += lots[i];
+   }
+
+   for (uint i=0; i < exposures.size(); ++i) {                       // margin and swap rates per symbol
+      SYMBOL_EXPOSURE& exposure = exposures[i];
+      const MARGIN_SYMBOL& ms = marginSymbols[exposure.symbolId];
+      uint profitCurrency = GetProfitCurrency(exposure.symbolId);
+      uint marginCurrency = GetMarginCurrency(exposure.symbolId);
+      if (!marginCurrency) marginCurrency = ms.baseCurrency;
+
+      double marginRate = marginCurrency ? GetConversionRate(marginCurrency, accountCurrency) : 0;
+      if (!marginRate) {
+         LeaveCriticalSection(&g_terminalLock);
+         return(error(ERR_RUNTIME_ERROR, "no conversion rate for the margin currency of symbol \"%s\"", GetSymbolName(exposure.symbolId)));
+      }
+      double totalLots = exposure.longLots + exposure.shortLots;
+      double netLots   = fabs(exposure.longLots - exposure.shortLots);
+      double margin    = (netLots * ms.marginNet + std::min(exposure.longLots, exposure.shortLots) * ms.marginHedged) / (leverage * ms.marginDivider);
+      exposure.marginPerLot = totalLots ? margin * marginRate / totalLots : 0;
+
+      double days = (!ms.swapEnabled || weekend) ? 0 : (weekday==ms.swapTripleDay ? 3 : 1);
+      if (!days) continue;
+
+      double unit;
+      uint   currency;
+      switch (ms.swapType) {
+         case 0: unit = ms.contractSize * ms.pointSize; currency = profitCurrency; break;
+         case 1: unit = 1;                              currency = ms.baseCurrency; break;
+         case 2: unit = ms.contractSize / 100 / 360;    currency = profitCurrency; exposure.perPrice = TRUE; break;
+         case 3: unit = 1;                              currency = marginCurrency; break;
+         default:
+            LeaveCriticalSection(&g_terminalLock);
+            return(error(ERR_RUNTIME_ERROR, "unsupported swap type %d of symbol \"%s\"", ms.swapType, GetSymbolName(exposure.symbolId)));
+      }
+      double swapRate = currency ? GetConversionRate(currency, accountCurrency) : 0;
+      if (!swapRate) {
+         LeaveCriticalSection(&g_terminalLock);
+         return(error(ERR_RUNTIME_ERROR, "no conversion rate for the swap currency of symbol \"%s\"", GetSymbolName(exposure.symbolId)));
+      }
+      exposure.swapLong  = ms.swapLong  * unit * days * swapRate;
+      exposure.swapShort = ms.swapShort * unit * days * swapRate;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   double sumMargin=0, sumSwap=0;
+   for (int i=0; i < size; ++i) {                                    // distribute to the orders
+      double margin=0, swap=0;
+      if (types[i]==OP_BUY || types[i]==OP_SELL) {
+         const SYMBOL_EXPOSURE& exposure = exposures[slots[symbolIds[i]]-1];
+         margin = lots[i] * exposure.marginPerLot;
+         swap   = lots[i] * (types[i]==OP_BUY ? exposure.swapLong : exposure.swapShort);
+         if (exposure.perPrice) swap *= openPrices[i];
+      }
+      if (margins) margins[i] = margin;
+      if (swaps)   swaps[i]   = swap;
+      sumMargin += margin;
+      sumSwap   += swap;
+   }
+   if (totalMargin) *totalMargin = sumMargin;
+   if (totalSwap)   *totalSwap   = sumSwap;
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
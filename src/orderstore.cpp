@@ -0,0 +1,302 @@
+#include "expander.h"
+#include "orderstore.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+// Closed orders are stored column-wise (one row per order), so an aggregation reads only the columns it needs. Each index
+// holds row numbers sorted by close time: one over all rows, one per symbol id and one per magic number. A query picks the
+// most selective index and limits it to the time range with a binary search. Added orders are sorted by close time and merged
+// into the indexes once per call, so adding a history in any order costs O(n log n). Orders arrive mostly in close time order,
+// then the merge is an append. The store is process wide and guarded by g_terminalLock.
+struct ORDER_COLUMNS {
+   std::vector<int>      ticket;
+   std::vector<uint>     symbolId;
+   std::vector<int>      type;
+   std::vector<int>      magicNumber;
+   std::vector<datetime> closeTime;
+   std::vector<double>   lots;
+   std::vector<double>   profit;
+   std::vector<double>   commission;
+   std::vector<double>   swap;
+};
+typedef std::vector<uint> RowIndex;                                  // row numbers sorted by close time
+
+
+ORDER_COLUMNS             storedOrders;
+RowIndex                  closeTimeIndex;                            // all rows
+std::vector<RowIndex>     symbolIndex;                               // rows by symbol id
+std::map<int, RowIndex>   magicNumberIndex;                          // rows by magic number
+std::map<int, uint>       ticketRows;                                // row by ticket (detection of known orders)
+
+
+/**
+ * Return the position of the first row of an index with a close time not less than the specified time (binary search).
+ * Must be called with g_terminalLock held.
+ *
+ * @param  RowIndex& index
+ * @param  datetime  time
+ *
+ * @return uint - position or the size of the index if no such row exists
+ */
+uint WINAPI firstRowAt(const RowIndex& index, datetime time) {
+   const datetime* closeTimes = &storedOrders.closeTime[0];
+   uint lo=0, hi=index.size();
+   while (lo < hi) {
+      uint mid = lo + ((hi-lo) >> 1);
+      if (closeTimes[index[mid]] < time) lo = mid + 1;
+      else                               hi = mid;
+   }
+   return(lo);
+}
+
+
+// orders rows by close time
+struct CloseTimeLess {
+   const datetime* closeTimes;
+   CloseTimeLess(const datetime* closeTimes) : closeTimes(closeTimes) {}
+   bool operator() (uint a, uint b) const { return(closeTimes[a] < closeTimes[b]); }
+};
+
+
+/**
+ * Add rows to an index. Rows closed after all indexed rows are appended, otherwise the rows are merged into the index. Rows
+ * with the same close time keep their order (indexed rows first). Must be called with g_terminalLock held.
+ *
+ * @param  RowIndex& index
+ * @param  RowIndex& rows  - rows sorted by close time
+ */
+void WINAPI indexRows(RowIndex& index, const RowIndex& rows) {
+   if (rows.empty()) return;
+   const datetime* closeTimes = &storedOrders.closeTime[0];
+   uint size = index.size();
+
+   index.insert(index.end(), rows.begin(), rows.end());
+   if (size && closeTimes[index[size-1]] > closeTimes[rows[0]]) {
+      std::inplace_merge(index.begin(), index.begin() + size, index.end(), CloseTimeLess(closeTimes));
+   }
+}
+
+
+/**
+ * Add closed orders to the order store. Orders which are still open, non-market orders (cancelled pending orders, balance
+ * and credit entries) and orders already in the store (by ticket) are skipped, so the full account history can be passed
+ * again whenever new orders were closed. If an order is invalid the orders before it are kept.
+ *
+ * @param  ORDER orders[] - orders in any order (ideally sorted by close time)
+ * @param  int   size     - number of orders
+ *
+ * @return int - number of added orders or EMPTY (-1) in case of errors
+ */
+int WINAPI OrderStore_AddOrders(const ORDER orders[], int size) {
+   if (size && (uint)orders < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter orders = 0x%p (not a valid pointer)", orders)));
+   if (size < 0)                                 return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+
+   EnterCriticalSection(&g_terminalLock);
+   ORDER_COLUMNS& columns = storedOrders;
+   uint rows = columns.ticket.size();
+   int added = 0, invalid = EMPTY;
+
+   for (int i=0; i < size; ++i) {
+      const ORDER& order = orders[i];
+      if (!order.closeTime || (order.type!=OP_BUY && order.type!=OP_SELL)) continue;
+      if (ticketRows.find(order.ticket) != ticketRows.end())            continue;
+
+      uint symbolId = InternSymbol(order.symbol);
+      if (!symbolId) {
+         invalid = i;                                                // orders added so far are kept
+         break;
+      }
+      uint row = rows + added;
+      columns.ticket     .push_back(order.ticket);
+      columns.symbolId   .push_back(symbolId);
+      columns.type       .push_back(order.type);
+      columns.magicNumber.push_back(order.magicNumber);
+      columns.closeTime  .push_back(order.closeTime);
+      columns.lots       .push_back(order.lots);
+      columns.profit     .push_back(order.profit);
+      columns.commission .push_back(order.commission);
+      columns.swap       .push_back(order.swap);
+      ticketRows[order.ticket] = row;
+      added++;
+   }
+
+   if (added) {                                                      // index the added rows in close time order
+      RowIndex newRows(added);
+      for (int i=0; i < added; ++i) {
+         newRows[i] = rows + i;
+      }
+      std::stable_sort(newRows.begin(), newRows.end(), CloseTimeLess(&columns.closeTime[0]));
+
+      std::map<uint, RowIndex> bySymbol;
+      std::map<int, RowIndex>  byMagicNumber;
+      for (int i=0; i < added; ++i) {
+         uint row = newRows[i];
+         bySymbol     [columns.symbolId[row]   ].push_back(row);
+         byMagicNumber[columns.magicNumber[row]].push_back(row);
+      }
+      indexRows(closeTimeIndex, newRows);
+
+      uint maxSymbolId = bySymbol.rbegin()->first;
+      if (maxSymbolId >= symbolIndex.size()) symbolIndex.resize(maxSymbolId + 1);
+      for (std::map<uint, RowIndex>::const_iterator it=bySymbol.begin(); it != bySymbol.end(); ++it) {
+         indexRows(symbolIndex[it->first], it->second);
+      }
+      for (std::map<int, RowIndex>::const_iterator it=byMagicNumber.begin(); it != byMagicNumber.end(); ++it) {
+         indexRows(magicNumberIndex[it->first], it->second);
+      }
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (invalid != EMPTY) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid orders[%d].symbol = \"%s\" (ticket #%d)", invalid, orders[invalid].symbol, orders[invalid].ticket)));
+   return(added);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Remove all orders from the order store (e.g. after an account change).
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI OrderStore_Reset() {
+   EnterCriticalSection(&g_terminalLock);
+   storedOrders = ORDER_COLUMNS();
+   closeTimeIndex.clear();
+   symbolIndex.clear();
+   magicNumberIndex.clear();
+   ticketRows.clear();
+   LeaveCriticalSection(&g_terminalLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the number of orders in the order store.
+ *
+ * @return int
+ */
+int WINAPI OrderStore_Size() {
+   EnterCriticalSection(&g_terminalLock);
+   int size = storedOrders.ticket.size();
+   LeaveCriticalSection(&g_terminalLock);
+   return(size);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Aggregate the rows of an index closed in a time range and append the resulting groups. Must be called with g_terminalLock
+ * held.
+ *
+ * @param  RowIndex&                 index
+ * @param  uint                      symbolId    - symbol id to filter by (0: no filter)
+ * @param  BOOL                      magicFilter - whether to filter by magic number
+ * @param  int                       magicNumber - magic number to filter by (ignored without magicFilter)
+ * @param  datetime                  from        - first close time (inclusive)
+ * @param  datetime                  to          - last close time (inclusive)
+ * @param  BOOL                      byDay       - whether to group by close day or to aggregate all rows in a single group
+ * @param  int                       key         - key of the single group (ignored if grouped by day)
+ * @param  std::vector<ORDER_GROUP>& groups      - vector receiving the groups (groups without orders are not appended)
+ */
+void WINAPI aggregateRows(const RowIndex& index, uint symbolId, BOOL magicFilter, int magicNumber, datetime from, datetime to, BOOL byDay, int key, std::vector<ORDER_GROUP>& groups) {
+   if (index.empty()) return;
+   const ORDER_COLUMNS& columns = storedOrders;
+   uint begin = firstRowAt(index, from);
+   uint end   = (to < INT_MAX) ? firstRowAt(index, to+1) : index.size();
+
+   ORDER_GROUP group = {};
+   group.key = byDay ? INT_MIN : key;
+
+   for (uint i=begin; i < end; ++i) {                                // rows are scanned in close time order
+      uint row = index[i];
+      if (symbolId    && columns.symbolId[row]    != symbolId)    continue;
+      if (magicFilter && columns.magicNumber[row] != magicNumber) continue;
+
+      if (byDay) {
+         datetime day = columns.closeTime[row] - columns.closeTime[row] % DAY;
+         if (day != group.key) {
+            if (group.count) groups.push_back(group);
+            ZeroMemory(&group, sizeof(group));
+            group.key = day;
+         }
+      }
+      group.count++;
+      group.lots       += columns.lots[row];
+      group.profit     += columns.profit[row];
+      group.commission += columns.commission[row];
+      group.swap       += columns.swap[row];
+   }
+   if (group.count) groups.push_back(group);
+}
+
+
+/**
+ * Aggregate the orders of the order store closed in a time range, optionally filtered by symbol and magic number, and grouped
+ * by a single key. Groups are returned in ascending key order. Groups by symbol and magic number are read from the respective
+ * index, other queries scan the most selective index.
+ *
+ * @param  int         groupBy     - group key: OrderGroupKey
+ * @param  uint        symbolId    - interned symbol id to filter by (0: all symbols)
+ * @param  BOOL        magicFilter - whether to filter by magic number (FALSE: all magic numbers)
+ * @param  int         magicNumber - magic number to filter by (ignored without magicFilter)
+ * @param  datetime    from        - first close time (inclusive, 0: no limit)
+ * @param  datetime    to          - last close time (inclusive, 0: no limit)
+ * @param  ORDER_GROUP results[]   - array receiving the groups
+ * @param  int         size        - size of the results array (the groups are copied only if the array is large enough)
+ *
+ * @return int - number of groups or EMPTY (-1) in case of errors
+ *
+ * @example  daily P/L of a strategy in March: OrderStore_GroupBy(OGK_CLOSEDAY, 0, true, magicNumber, D'2024.03.01', D'2024.03.31 23:59:59', ...)
+ */
+int WINAPI OrderStore_GroupBy(int groupBy, uint symbolId, BOOL magicFilter, int magicNumber, datetime from, datetime to, ORDER_GROUP results[], int size) {
+   if (groupBy < OGK_NONE || groupBy > OGK_CLOSEDAY) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter groupBy = %d (not an OrderGroupKey)", groupBy)));
+   if (symbolId > MAX_INTERNED_SYMBOLS)              return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d", symbolId)));
+   if (size && (uint)results < MIN_VALID_POINTER)    return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter results = 0x%p (not a valid pointer)", results)));
+   if (size < 0)                                     return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+   if (!to) to = INT_MAX;
+   if (from > to)                                    return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameters from = %d / to = %d (from is larger than to)", from, to)));
+   std::vector<ORDER_GROUP> groups;
+
+   EnterCriticalSection(&g_terminalLock);
+
+   if (groupBy==OGK_SYMBOL && !symbolId) {                           // one group per symbol index
+      for (uint id=1; id < symbolIndex.size(); ++id) {
+         aggregateRows(symbolIndex[id], 0, magicFilter, magicNumber, from, to, FALSE, id, groups);
+      }
+   }
+   else if (groupBy==OGK_MAGICNUMBER && !magicFilter) {                  // one group per magic number index (in key order)
+      std::map<int, RowIndex>::const_iterator it, end=magicNumberIndex.end();
+      for (it=magicNumberIndex.begin(); it != end; ++it) {
+         aggregateRows(it->second, symbolId, FALSE, 0, from, to, FALSE, it->first, groups);
+      }
+   }
+   else {                                                            // a single group or groups by day
+      int key = (groupBy==OGK_SYMBOL) ? symbolId : (groupBy==OGK_MAGICNUMBER) ? magicNumber : 0;
+      const RowIndex* index = &closeTimeIndex;                       // select the most selective index
+      if (symbolId) index = (symbolId < symbolIndex.size()) ? &symbolIndex[symbolId] : NULL;
+
+      if (magicFilter && index) {
+         std::map<int, RowIndex>::const_iterator it = magicNumberIndex.find(magicNumber);
+         if (it == magicNumberIndex.end()) index = NULL;
+         else if (it->second.size() < index->size() || !symbolId) {
+            index       = &it->second;
+            magicFilter = FALSE;                                     // the index needs no magic number filter
+         }
+      }
+      if (index) aggregateRows(*index, symbolId, magicFilter, magicNumber, from, to, (groupBy==OGK_CLOSEDAY), key, groups);
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   int groupsSize = groups.size();
+   if (groupsSize && size >= groupsSize) memcpy(results, &groups[0], groupsSize * sizeof(ORDER_GROUP));
+   return(groupsSize);
+   #pragma EXPANDER_EXPORT
+}
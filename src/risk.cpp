@@ -0,0 +1,404 @@
+#include "expander.h"
+#include "currencies.h"
+#include "margin.h"
+#include "risk.h"
+#include "symbols.h"
+
+#include <math.h>
+#include <vector>
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+#define LOTS_EPSILON  0.000001                                       // tolerance of lot comparisons
+
+
+// open position and settings of a symbol (lots aggregated like in POSITION_DATA)
+struct RISK_POSITION {
+   BOOL   known;
+   double longLots;
+   double shortLots;
+   double maxLots;                                                   // symbol limit (0: RISK_LIMITS.maxSymbolLots)
+   int    group;                                                     // correlation group (0: none)
+   int    groupSign;                                                 // direction of the symbol in its group (+1 or -1)
+   uint   baseCurrency;                                              // interned currency ids
+   uint   quoteCurrency;
+   double contractSize;
+   BOOL   unresolved;                                                // whether orders were applied before the currencies were known
+   double unresolvedLots;                                            // directional lots of these orders
+   double unresolvedValue;                                           // directional lots * open price of these orders
+};
+
+
+// Positions are aggregated per symbol, correlation group and currency and updated by the order events, so a pre-trade check
+// only evaluates the aggregates touched by the checked order. The engine is process wide and guarded by g_terminalLock.
+RISK_LIMITS                riskLimits;
+std::vector<RISK_POSITION> riskPositions;                            // by symbol id
+std::vector<uint>          riskSymbols;                              // ids of all symbols in riskPositions
+double                     riskGroupLots[MAX_RISK_GROUPS+1];         // directional lots per correlation group
+double                     riskCurrencyUnits[MAX_INTERNED_SYMBOLS+1];  // net exposure per currency in units of the currency
+uint                       riskUnresolvedSymbols;                    // number of positions with unresolved orders
+
+
+/**
+ * Return the position of a symbol and create it if the symbol is not yet known. Currencies and contract size are resolved as
+ * soon as the symbol is registered in both the currency graph and the margin calculator (in any order). The currency exposure
+ * of orders applied before is added on resolution. Must be called with g_terminalLock held.
+ *
+ * @param  uint symbolId - interned symbol id (validated by the caller)
+ *
+ * @return RISK_POSITION&
+ */
+RISK_POSITION& WINAPI riskPosition(uint symbolId) {
+   if (symbolId >= riskPositions.size()) riskPositions.resize(symbolId + 1);
+   RISK_POSITION& position = riskPositions[symbolId];
+
+   if (!position.known) {
+      position.known     = TRUE;
+      position.groupSign = 1;
+      riskSymbols.push_back(symbolId);
+   }
+   if (!position.contractSize || !position.baseCurrency || !position.quoteCurrency) {
+      if (!position.contractSize)  position.contractSize  = GetContractSize(symbolId);
+      if (!position.baseCurrency)  position.baseCurrency  = GetBaseCurrency(symbolId);
+      if (!position.quoteCurrency) position.quoteCurrency = GetProfitCurrency(symbolId);
+
+      uint base=position.baseCurrency, quote=position.quoteCurrency;  // add orders applied before the symbol was registered
+      if (position.unresolved && position.contractSize && base && quote) {
+         if (base != quote) {
+            riskCurrencyUnits[base]  += position.unresolvedLots  * position.contractSize;
+            riskCurrencyUnits[quote] -= position.unresolvedValue * position.contractSize;
+         }
+         position.unresolved     = FALSE;
+         position.unresolvedLots = position.unresolvedValue = 0;
+         riskUnresolvedSymbols--;
+      }
+   }
+   return(position);
+}
+
+
+/**
+ * Try to resolve the currencies of all positions with orders applied before their symbol was registered. Must be called with
+ * g_terminalLock held.
+ *
+ * @return BOOL - whether all positions are resolved
+ */
+BOOL WINAPI resolveRiskPositions() {
+   for (uint i=0; riskUnresolvedSymbols && i < riskSymbols.size(); ++i) {
+      if (riskPositions[riskSymbols[i]].unresolved) riskPosition(riskSymbols[i]);
+   }
+   return(!riskUnresolvedSymbols);
+}
+
+
+/**
+ * Add an order to or remove it from the aggregates. Must be called with g_terminalLock held.
+ *
+ * @param  RISK_POSITION& position
+ * @param  int            type  - OP_BUY | OP_SELL
+ * @param  double         lots  - order size (negative to remove the order)
+ * @param  double         price - open price
+ */
+void WINAPI applyRiskOrder(RISK_POSITION& position, int type, double lots, double price) {
+   int direction = (type == OP_BUY) ? 1 : -1;
+
+   double& side = (type == OP_BUY) ? position.longLots : position.shortLots;
+   side += lots;
+   if (fabs(side) < LOTS_EPSILON) side = 0;                          // discard rounding errors of closed positions
+
+   if (position.group) {
+      riskGroupLots[position.group] += position.groupSign * direction * lots;
+   }
+   uint base=position.baseCurrency, quote=position.quoteCurrency;
+   if (!position.contractSize || !base || !quote) {                  // currencies not yet known, added on resolution
+      if (!position.unresolved) {
+         position.unresolved = TRUE;
+         riskUnresolvedSymbols++;
+      }
+      position.unresolvedLots  += direction * lots;
+      position.unresolvedValue += direction * lots * price;
+   }
+   else if (base != quote) {
+      double units = direction * lots * position.contractSize;
+      riskCurrencyUnits[base]  += units;
+      riskCurrencyUnits[quote] -= units * price;
+   }
+}
+
+
+/**
+ * Set the portfolio limits of the risk engine.
+ *
+ * @param  RISK_LIMITS* limits
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI RiskEngine_SetLimits(const RISK_LIMITS* limits) {
+   if ((uint)limits < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter limits = 0x%p (not a valid pointer)", limits));
+   if (limits->maxTotalMargin && (!limits->accountCurrency || limits->leverage < 1))
+      return(error(ERR_INVALID_PARAMETER, "invalid limits.accountCurrency = %d / limits.leverage = %d (required by maxTotalMargin)", limits->accountCurrency, limits->leverage));
+   if (limits->maxCurrencyExposure && !limits->accountCurrency)
+      return(error(ERR_INVALID_PARAMETER, "invalid limits.accountCurrency = %d (required by maxCurrencyExposure)", limits->accountCurrency));
+
+   EnterCriticalSection(&g_terminalLock);
+   riskLimits = *limits;
+   LeaveCriticalSection(&g_terminalLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Set the limit of a single symbol (overrides RISK_LIMITS.maxSymbolLots).
+ *
+ * @param  uint   symbolId - interned symbol id
+ * @param  double maxLots  - max. directional lots of the symbol (0: use the default limit)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI RiskEngine_SetSymbolLimit(uint symbolId, double maxLots) {
+   if (!symbolId || symbolId > GetSymbolsCount())    return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d (not an interned symbol)", symbolId));
+   if (maxLots < 0)                                  return(error(ERR_INVALID_PARAMETER, "invalid parameter maxLots = %f", maxLots));
+
+   EnterCriticalSection(&g_terminalLock);
+   riskPosition(symbolId).maxLots = maxLots;
+   LeaveCriticalSection(&g_terminalLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Assign a symbol to a correlation group. The directional lots of all symbols of a group are added (with the symbol's sign)
+ * and checked against RISK_LIMITS.maxGroupLots. A symbol moving inversely to the group (e.g. USDCHF in a EUR group with
+ * EURUSD) is added with sign -1. Must be called while the symbol has no open position.
+ *
+ * @param  uint symbolId - interned symbol id
+ * @param  int  group    - correlation group: 1...MAX_RISK_GROUPS (0: remove the symbol from its group)
+ * @param  int  sign     - direction of the symbol in the group: +1 or -1
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI RiskEngine_SetCorrelationGroup(uint symbolId, int group, int sign) {
+   if (!symbolId || symbolId > GetSymbolsCount())    return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d (not an interned symbol)", symbolId));
+   if (group < 0 || group > MAX_RISK_GROUPS)         return(error(ERR_INVALID_PARAMETER, "invalid parameter group = %d (must be 0...%d)", group, MAX_RISK_GROUPS));
+   if (sign!=1 && sign!=-1)                          return(error(ERR_INVALID_PARAMETER, "invalid parameter sign = %d (must be +1 or -1)", sign));
+
+   EnterCriticalSection(&g_terminalLock);
+   RISK_POSITION& position = riskPosition(symbolId);
+   if (position.longLots || position.shortLots) {
+      LeaveCriticalSection(&g_terminalLock);
+      return(error(ERR_ILLEGAL_STATE, "cannot change the group of symbol \"%s\" with an open position", GetSymbolName(symbolId)));
+   }
+   position.group     = group;
+   position.groupSign = sign;
+   LeaveCriticalSection(&g_terminalLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Remove all positions from the risk engine (e.g. to resynchronize with the open orders). Limits and groups are kept.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI RiskEngine_Reset() {
+   EnterCriticalSection(&g_terminalLock);
+   for (uint i=0; i < riskPositions.size(); ++i) {
+      riskPositions[i].longLots        = 0;
+      riskPositions[i].shortLots       = 0;
+      riskPositions[i].unresolved      = FALSE;
+      riskPositions[i].unresolvedLots  = 0;
+      riskPositions[i].unresolvedValue = 0;
+   }
+   memset(riskGroupLots,     0, sizeof(riskGroupLots));
+   memset(riskCurrencyUnits, 0, sizeof(riskCurrencyUnits));
+   riskUnresolvedSymbols = 0;
+   LeaveCriticalSection(&g_terminalLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Notify the risk engine of an opened order (or of the open orders when the engine is synchronized).
+ *
+ * @param  uint   symbolId  - interned symbol id
+ * @param  int    type      - order type: OP_BUY | OP_SELL
+ * @param  double lots      - order size
+ * @param  double openPrice - open price
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI RiskEngine_OnOrderOpen(uint symbolId, int type, double lots, double openPrice) {
+   if (!symbolId || symbolId > GetSymbolsCount())    return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d (not an interned symbol)", symbolId));
+   if (type!=OP_BUY && type!=OP_SELL)                return(error(ERR_INVALID_PARAMETER, "invalid parameter type = %d (not a market order)", type));
+   if (lots <= 0)                                    return(error(ERR_INVALID_PARAMETER, "invalid parameter lots = %f", lots));
+
+   EnterCriticalSection(&g_terminalLock);
+   applyRiskOrder(riskPosition(symbolId), type, lots, openPrice);
+   LeaveCriticalSection(&g_terminalLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Notify the risk engine of a closed or partially closed order.
+ *
+ * @param  uint   symbolId  - interned symbol id
+ * @param  int    type      - order type: OP_BUY | OP_SELL
+ * @param  double lots      - closed lots
+ * @param  double openPrice - open price of the order
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI RiskEngine_OnOrderClose(uint symbolId, int type, double lots, double openPrice) {
+   if (!symbolId || symbolId > GetSymbolsCount())    return(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d (not an interned symbol)", symbolId));
+   if (type!=OP_BUY && type!=OP_SELL)                return(error(ERR_INVALID_PARAMETER, "invalid parameter type = %d (not a market order)", type));
+   if (lots <= 0)                                    return(error(ERR_INVALID_PARAMETER, "invalid parameter lots = %f", lots));
+
+   EnterCriticalSection(&g_terminalLock);
+   applyRiskOrder(riskPosition(symbolId), type, -lots, openPrice);
+   LeaveCriticalSection(&g_terminalLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate the total margin of all positions of the risk engine plus an optional additional order. Must be called with
+ * g_terminalLock held.
+ *
+ * @param  uint   symbolId - symbol of the additional order (0: none)
+ * @param  int    type     - type of the additional order
+ * @param  double lots     - size of the additional order
+ * @param  double margin   - variable receiving the margin
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI riskMargin(uint symbolId, int type, double lots, double& margin) {
+   std::vector<uint>   ids;
+   std::vector<int>    types;
+   std::vector<double> sizes;
+
+   for (uint i=0; i < riskSymbols.size(); ++i) {                     // one long and one short order per symbol
+      const RISK_POSITION& position = riskPositions[riskSymbols[i]];
+      if (position.longLots)  { ids.push_back(riskSymbols[i]); types.push_back(OP_BUY);  sizes.push_back(position.longLots);  }
+      if (position.shortLots) { ids.push_back(riskSymbols[i]); types.push_back(OP_SELL); sizes.push_back(position.shortLots); }
+   }
+   if (symbolId) {
+      ids.push_back(symbolId);
+      types.push_back(type);
+      sizes.push_back(lots);
+   }
+   margin = 0;
+   if (ids.empty()) return(TRUE);
+
+   std::vector<double> prices(ids.size(), 0);                        // the margin model doesn't use open prices
+   datetime noRollover = 2*86400;                                    // 03.01.1970 was a Saturday, no swaps are calculated
+   return(CalculateMarginSwap(&ids[0], &types[0], &sizes[0], &prices[0], ids.size(), riskLimits.accountCurrency, riskLimits.leverage, noRollover, NULL, NULL, &margin, NULL));
+}
+
+
+/**
+ * Check an order against the limits of the risk engine before it's sent. Orders reducing an exposure are always allowed,
+ * even if the exposure exceeds a limit. The checks run from cheap to expensive: symbol lots, group lots, currency exposure
+ * (base and quote currency of the symbol) and total margin (only if the cheaper checks pass).
+ *
+ * @param  uint   symbolId   - interned symbol id
+ * @param  int    type       - order type: OP_BUY | OP_SELL
+ * @param  double lots       - order size
+ * @param  double price      - expected open price
+ * @param  char*  reason     - buffer receiving a description of a denial (optional)
+ * @param  int    reasonSize - size of the buffer
+ *
+ * @return int - RC_ALLOW (0), a RiskCheckResult denying the order or EMPTY (-1) in case of errors
+ */
+int WINAPI RiskEngine_CheckOrder(uint symbolId, int type, double lots, double price, char* reason, int reasonSize) {
+   if (!symbolId || symbolId > GetSymbolsCount())      return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter symbolId = %d (not an interned symbol)", symbolId)));
+   if (type!=OP_BUY && type!=OP_SELL)                  return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter type = %d (not a market order)", type)));
+   if (lots <= 0)                                      return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter lots = %f", lots)));
+   if (reasonSize < 0)                                 return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter reasonSize = %d", reasonSize)));
+   if (reasonSize && (uint)reason < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter reason = 0x%p (not a valid pointer)", reason)));
+
+   char description[256] = "";
+   int result    = RC_ALLOW;
+   int direction = (type == OP_BUY) ? 1 : -1;
+
+   EnterCriticalSection(&g_terminalLock);
+   const RISK_LIMITS& limits = riskLimits;
+   RISK_POSITION& position = riskPosition(symbolId);
+
+   double current = position.longLots - position.shortLots;          // symbol lots
+   double next    = current + direction * lots;
+   double maxLots = position.maxLots ? position.maxLots : limits.maxSymbolLots;
+   if (maxLots && fabs(next) > maxLots + LOTS_EPSILON && fabs(next) > fabs(current)) {
+      result = RC_SYMBOL_LOTS;
+      sprintf_s(description, sizeof(description), "%s: directional lots %.2f exceed the symbol limit of %.2f", GetSymbolName(symbolId), next, maxLots);
+   }
+
+   if (!result && position.group && limits.maxGroupLots) {           // group lots
+      current = riskGroupLots[position.group];
+      next    = current + position.groupSign * direction * lots;
+      if (fabs(next) > limits.maxGroupLots + LOTS_EPSILON && fabs(next) > fabs(current)) {
+         result = RC_GROUP_LOTS;
+         sprintf_s(description, sizeof(description), "%s: lots %.2f of correlation group %d exceed the group limit of %.2f", GetSymbolName(symbolId), next, position.group, limits.maxGroupLots);
+      }
+   }
+
+   if (!result && limits.maxCurrencyExposure) {                      // currency exposure
+      uint base=position.baseCurrency, quote=position.quoteCurrency;
+      if (!base || !quote || !position.contractSize) {
+         result = RC_NO_RATE;
+         sprintf_s(description, sizeof(description), "%s: currencies unknown (symbol not registered)", GetSymbolName(symbolId));
+      }
+      else if (!resolveRiskPositions()) {                            // exposure of open orders is incomplete
+         result = RC_NO_RATE;
+         sprintf_s(description, sizeof(description), "%s: exposure incomplete, currencies of %d symbol(s) with open orders unknown", GetSymbolName(symbolId), riskUnresolvedSymbols);
+      }
+      else if (base != quote) {
+         uint   currencies[] = {base, quote};
+         double units = direction * lots * position.contractSize;
+         double changes[] = {units, -units * price};
+
+         for (int i=0; i < 2 && !result; ++i) {
+            double rate = GetConversionRate(currencies[i], limits.accountCurrency);
+            if (!rate) {
+               result = RC_NO_RATE;
+               sprintf_s(description, sizeof(description), "%s: no conversion rate for %s", GetSymbolName(symbolId), GetSymbolName(currencies[i]));
+               break;
+            }
+            double currentExposure = riskCurrencyUnits[currencies[i]] * rate;
+            double nextExposure    = currentExposure + changes[i] * rate;
+            if (fabs(nextExposure) > limits.maxCurrencyExposure && fabs(nextExposure) > fabs(currentExposure)) {
+               result = RC_CURRENCY_EXPOSURE;
+               sprintf_s(description, sizeof(description), "%s: exposure %.2f in %s exceeds the currency limit of %.2f", GetSymbolName(symbolId), nextExposure, GetSymbolName(currencies[i]), limits.maxCurrencyExposure);
+            }
+         }
+      }
+   }
+
+   if (!result && limits.maxTotalMargin) {                           // total margin
+      double nextMargin, currentMargin;
+      if (!riskMargin(symbolId, type, lots, nextMargin)) {
+         result = RC_NO_RATE;
+         sprintf_s(description, sizeof(description), "%s: margin cannot be calculated", GetSymbolName(symbolId));
+      }
+      else if (nextMargin > limits.maxTotalMargin && riskMargin(0, 0, 0, currentMargin) && nextMargin > currentMargin) {
+         result = RC_TOTAL_MARGIN;
+         sprintf_s(description, sizeof(description), "%s: total margin %.2f exceeds the limit of %.2f", GetSymbolName(symbolId), nextMargin, limits.maxTotalMargin);
+      }
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (reasonSize) {
+      strncpy(reason, description, reasonSize-1);
+      reason[reasonSize-1] = '\0';
+   }
+   return(result);
+   #pragma EXPANDER_EXPORT
+}
@@ -0,0 +1,101 @@
+#include "expander.h"
+#include "shadow.h"
+
+#include <malloc.h>
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+#define SHADOW_BLOCK_SIZE     256                                    // shadows per block
+#define SHADOW_BLOCKS         256                                    // max. number of blocks (program ids up to 65535)
+
+
+// Shadows are stored in cache line aligned blocks which never move, so readers access them without locking. A block is
+// allocated on first use of one of its program ids. Consecutive program ids occupy consecutive cache lines.
+PROGRAM_SHADOW* volatile shadowBlocks[SHADOW_BLOCKS];
+
+
+/**
+ * Return the shadow of a program.
+ *
+ * @param  uint programId
+ *
+ * @return PROGRAM_SHADOW* - shadow or NULL if the program has no shadow (yet)
+ */
+const PROGRAM_SHADOW* WINAPI GetProgramShadow(uint programId) {
+   uint block = programId / SHADOW_BLOCK_SIZE;
+   if (block >= SHADOW_BLOCKS || !shadowBlocks[block]) return(NULL);
+
+   const PROGRAM_SHADOW* shadow = &shadowBlocks[block][programId % SHADOW_BLOCK_SIZE];
+   return(shadow->programId ? shadow : NULL);
+}
+
+
+/**
+ * Update the shadow of a program from its master context.
+ *
+ * @param  EXECUTION_CONTEXT* master - master context of a program
+ */
+void WINAPI SyncProgramShadow(const EXECUTION_CONTEXT* master) {
+   uint programId = master->programId;
+   uint block     = programId / SHADOW_BLOCK_SIZE;
+   if (!programId || block >= SHADOW_BLOCKS) return;
+
+   PROGRAM_SHADOW* shadows = shadowBlocks[block];
+   if (!shadows) {
+      EnterCriticalSection(&g_terminalLock);
+      if (!(shadows = shadowBlocks[block])) {
+         shadows = (PROGRAM_SHADOW*)_aligned_malloc(SHADOW_BLOCK_SIZE * sizeof(PROGRAM_SHADOW), 64);
+         if (shadows) {
+            memset(shadows, 0, SHADOW_BLOCK_SIZE * sizeof(PROGRAM_SHADOW));
+            shadowBlocks[block] = shadows;
+         }
+      }
+      LeaveCriticalSection(&g_terminalLock);
+      if (!shadows) return;
+   }
+
+   PROGRAM_SHADOW& shadow = shadows[programId % SHADOW_BLOCK_SIZE];
+   shadow.programType      = master->programType;
+   shadow.rootFunction     = master->rootFunction;
+   shadow.initReason       = master->initReason;
+   shadow.uninitReason     = master->uninitReason;
+   shadow.threadId         = master->threadId;
+   shadow.hChart           = master->hChart;
+   shadow.ticks            = master->ticks;
+   shadow.currentTickTime  = master->currentTickTime;
+   shadow.previousTickTime = master->previousTickTime;
+   shadow.testing          = master->testing;
+   shadow.initCycle        = master->initCycle;
+   shadow.master           = master;
+   shadow.programId        = programId;                              // last, marks the slot as used
+}
+
+
+/**
+ * Release the shadow of a program. Called when a program is released and its id becomes reusable.
+ *
+ * @param  uint programId
+ */
+void WINAPI ReleaseProgramShadow(uint programId) {
+   uint block = programId / SHADOW_BLOCK_SIZE;
+   if (block < SHADOW_BLOCKS && shadowBlocks[block]) {
+      PROGRAM_SHADOW& shadow = shadowBlocks[block][programId % SHADOW_BLOCK_SIZE];
+      shadow.programId = 0;
+      shadow.master    = NULL;
+   }
+}
+
+
+/**
+ * Release all shadow blocks. Called on DLL_PROCESS_DETACH.
+ */
+void WINAPI ReleaseProgramShadows() {
+   for (uint i=0; i < SHADOW_BLOCKS; i++) {
+      if (shadowBlocks[i]) {
+         _aligned_free(shadowBlocks[i]);
+         shadowBlocks[i] = NULL;
+      }
+   }
+}
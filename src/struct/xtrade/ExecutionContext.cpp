@@ -1,6 +1,8 @@
 #include "expander.h"
+#include "shadow.h"
 #include "struct/xtrade/ExecutionContext.h"
 #include "util/format.h"
+#include "util/helper.h"
 #include "util/toString.h"
 
 
@@ -611,9 +613,13 @@ RootFunction WINAPI ec_SetRootFunction(EXECUTION_CONTEXT* ec, RootFunction id) {
 
    ec->rootFunction = id;
 
-   uint pid = ec->programId;                                         // synchronize main and master context
-   if (pid && g_contextChains.size() > pid && ec==g_contextChains[pid][1] && g_contextChains[pid][0])
-      return(ec_SetRootFunction(g_contextChains[pid][0], id));
+   uint pid = ec->programId;
+   if (pid && g_contextChains.size() > pid) {
+      if (ec==g_contextChains[pid][1] && g_contextChains[pid][0])    // synchronize main and master context
+         return(ec_SetRootFunction(g_contextChains[pid][0], id));
+      if (ec == g_contextChains[pid][0])
+         SyncProgramShadow(ec);                                      // shadowed field, may be called from MQL outside of Sync*()
+   }
    return(id);
    #pragma EXPANDER_EXPORT
 }
@@ -1159,6 +1165,93 @@ int WINAPI ec_SetDllWarning(EXECUTION_CONTEXT* ec, int error) {
 }
 
 
+/**
+ * Copy the frequently used fields of an EXECUTION_CONTEXT, its master context and the calling thread to a CONTEXT_SNAPSHOT.
+ * Replaces the separate ec_* and mec_* getter calls of an MQL program's start() function by a single DLL call.
+ *
+ * @param  EXECUTION_CONTEXT* ec
+ * @param  CONTEXT_SNAPSHOT*  snapshot - struct receiving the values
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI ec_Snapshot(const EXECUTION_CONTEXT* ec, CONTEXT_SNAPSHOT* snapshot) {
+   if ((uint)ec       < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter ec = 0x%p (not a valid pointer)", ec));
+   if ((uint)snapshot < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter snapshot = 0x%p (not a valid pointer)", snapshot));
+
+   snapshot->programId        = ec->programId;
+   snapshot->programType      = ec->programType;
+   snapshot->moduleType       = ec->moduleType;
+   snapshot->launchType       = ec->launchType;
+   snapshot->rootFunction     = ec->rootFunction;
+   snapshot->initCycle        = ec->initCycle;
+   snapshot->initReason       = ec->initReason;
+   snapshot->uninitReason     = ec->uninitReason;
+   snapshot->testing          = ec->testing;
+   snapshot->visualMode       = ec->visualMode;
+   snapshot->optimization     = ec->optimization;
+   snapshot->initFlags        = ec->initFlags;
+   snapshot->deinitFlags      = ec->deinitFlags;
+   snapshot->logging          = ec->logging;
+   memcpy(snapshot->symbol, ec->symbol, sizeof(snapshot->symbol));
+   snapshot->timeframe        = ec->timeframe;
+   snapshot->hChart           = ec->hChart;
+   snapshot->hChartWindow     = ec->hChartWindow;
+   snapshot->superContext     = ec->superContext;
+   snapshot->threadId         = ec->threadId;
+   snapshot->ticks            = ec->ticks;
+   snapshot->currentTickTime  = ec->currentTickTime;
+   snapshot->previousTickTime = ec->previousTickTime;
+   snapshot->mqlError         = ec->mqlError;
+   snapshot->dllError         = ec->dllError;
+   snapshot->dllWarning       = ec->dllWarning;
+
+   uint pid = ec->programId;
+   EXECUTION_CONTEXT* master = (pid && g_contextChains.size() > pid) ? g_contextChains[pid][0] : NULL;
+   if (master) {
+      snapshot->masterRootFunction = master->rootFunction;
+      snapshot->masterUninitReason = master->uninitReason;
+      snapshot->masterInitFlags    = master->initFlags;
+      snapshot->masterMqlError     = master->mqlError;
+      snapshot->masterDllError     = master->dllError;
+   }
+   else {
+      snapshot->masterRootFunction = (RootFunction)NULL;
+      snapshot->masterUninitReason = (UninitializeReason)NULL;
+      snapshot->masterInitFlags    = NULL;
+      snapshot->masterMqlError     = NO_ERROR;
+      snapshot->masterDllError     = NO_ERROR;
+   }
+   snapshot->currentThreadId = GetCurrentThreadId();
+   snapshot->isUIThread      = (snapshot->currentThreadId == GetUIThreadId());
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Set the fields of an EXECUTION_CONTEXT which MQL may set from a CONTEXT_SNAPSHOT in a single call (typically in init()).
+ * Currently this is only logging (see ec_SetLogging()). All other fields are resolved DLL-side and ignored. A main module
+ * context is synchronized with its master context.
+ *
+ * @param  EXECUTION_CONTEXT* ec
+ * @param  CONTEXT_SNAPSHOT*  snapshot - struct with the values to set
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI ec_SetSnapshot(EXECUTION_CONTEXT* ec, const CONTEXT_SNAPSHOT* snapshot) {
+   if ((uint)ec       < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter ec = 0x%p (not a valid pointer)", ec));
+   if ((uint)snapshot < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter snapshot = 0x%p (not a valid pointer)", snapshot));
+
+   ec->logging = snapshot->logging;
+
+   uint pid = ec->programId;                                         // synchronize main and master context
+   if (pid && g_contextChains.size() > pid && ec==g_contextChains[pid][1] && g_contextChains[pid][0])
+      return(ec_SetSnapshot(g_contextChains[pid][0], snapshot));
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
 /**
  * Return the RootFunction of an EXECUTION_CONTEXT's master context.
  *
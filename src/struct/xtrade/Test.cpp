@@ -167,6 +167,23 @@ datetime WINAPI test_SetEndTime(TEST* test, datetime time) {
 }
 
 
+/**
+ * Set the bar model used in a TEST.
+ *
+ * @param  TEST* test
+ * @param  uint  type - bar model: BM_EVERYTICK | BM_CONTROLPOINTS | BM_BAROPEN
+ *
+ * @return uint - the same bar model
+ */
+uint WINAPI test_SetBarModel(TEST* test, uint type) {
+   if ((uint)test < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter test: 0x%p (not a valid pointer)", test));
+   if (type > BM_BAROPEN)              return(error(ERR_INVALID_PARAMETER, "invalid parameter type: %d (not a bar model)", type));
+
+   test->barModel = type;
+   return(type);
+}
+
+
 /**
  * Set the spread used in a TEST.
  *
@@ -218,6 +235,23 @@ uint WINAPI test_SetTicks(TEST* test, uint ticks) {
 }
 
 
+/**
+ * Set the trade directions enabled in a TEST.
+ *
+ * @param  TEST* test
+ * @param  uint  types - trade directions: TRADE_DIRECTIONS_LONG | TRADE_DIRECTIONS_SHORT | TRADE_DIRECTIONS_BOTH
+ *
+ * @return uint - the same trade directions
+ */
+uint WINAPI test_SetTradeDirections(TEST* test, uint types) {
+   if ((uint)test < MIN_VALID_POINTER)                                 return(error(ERR_INVALID_PARAMETER, "invalid parameter test: 0x%p (not a valid pointer)", test));
+   if (types < TRADE_DIRECTIONS_LONG || types > TRADE_DIRECTIONS_BOTH) return(error(ERR_INVALID_PARAMETER, "invalid parameter types: %d (not a trade direction)", types));
+
+   test->tradeDirections = types;
+   return(types);
+}
+
+
 /**
  * Set the VisualMode status of a TEST.
  *
@@ -279,11 +313,11 @@ const char* WINAPI TEST_toStr(const TEST* test, BOOL outputDebug/*=FALSE*/) {
          << ", timeframe="       << TimeframeToStr(test->timeframe)
          << ", startTime="       <<               (test->startTime ? doubleQuoteStr(gmTimeFormat(test->startTime, "%a, %d-%b-%Y %H:%M:%S")) : "0")
          << ", endTime="         <<               (test->endTime   ? doubleQuoteStr(gmTimeFormat(test->endTime, "%a, %d-%b-%Y %H:%M:%S")) : "0")
-         << ", barModel="        <<                test->barModel           // TODO: EveryTick|ControlPoints|BarOpen
+         << ", barModel="        <<               (test->barModel <= BM_BAROPEN ? BarModelDescription(test->barModel) : "(unknown)")
          << ", spread="          <<   numberFormat(test->spread, "%.1f")
          << ", bars="            <<                test->bars
          << ", ticks="           <<                test->ticks
-         << ", tradeDirections=" <<                test->tradeDirections    // TODO: Long|Short|Both
+         << ", tradeDirections=" <<               (test->tradeDirections ? TradeDirectionDescription(test->tradeDirections) : "0")
          << ", visualMode="      <<      BoolToStr(test->visualMode)
          << ", duration="        <<               (test->duration ? numberFormat(test->duration/1000., "%.3f s") : "0")
          << ", orders="          <<               (test->orders   ? to_string(test->orders->size()) : "NULL")
@@ -0,0 +1,153 @@
+#include "expander.h"
+#include "symbols.h"
+
+#include <emmintrin.h>
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+#define SYMBOL_SLOTS          8192                                   // hash table size (power of 2, load factor <= 0.5)
+
+
+// Symbol names are stored zero-padded in 16-byte keys and compared with a single SSE2 instruction. The hash table uses linear
+// probing and never removes entries, so readers access it without locking. A slot is published by writing its id after the
+// key (writes are not reordered on x86 and volatile writes have release semantics). Writers are serialized by g_terminalLock.
+__declspec(align(16)) __m128i symbolKeys[SYMBOL_SLOTS];
+volatile uint                 symbolSlotIds[SYMBOL_SLOTS];           // symbol id per slot (0: empty slot)
+__declspec(align(16)) char    symbolNames[MAX_INTERNED_SYMBOLS+1][16];  // symbol names by id
+volatile uint                 symbolsCount;                          // number of interned symbols (= last assigned id)
+
+
+/**
+ * Convert a symbol name to a zero-padded 16-byte key. The name is copied byte by byte as reading 16 bytes from the passed
+ * string might cross a page boundary.
+ *
+ * @param  char*    symbol - symbol name
+ * @param  __m128i& key    - variable receiving the key
+ *
+ * @return BOOL - whether the name is a valid symbol name (1 to MAX_SYMBOL_LENGTH characters)
+ */
+BOOL WINAPI symbolKey(const char* symbol, __m128i& key) {
+   __declspec(align(16)) char buffer[16] = {};
+   uint i = 0;
+   for (; i < MAX_SYMBOL_LENGTH && symbol[i]; ++i) {
+      buffer[i] = symbol[i];
+   }
+   if (!i || symbol[i]) return(FALSE);
+   key = _mm_load_si128((const __m128i*)buffer);
+   return(TRUE);
+}
+
+
+/**
+ * Return the hash table slot to start probing for a key at.
+ *
+ * @param  __m128i& key
+ *
+ * @return uint - slot index
+ */
+uint WINAPI symbolSlot(const __m128i& key) {
+   const uint* k = (const uint*)&key;
+   uint hash = (k[0] * 0x9E3779B1) ^ (k[1] * 0x85EBCA77) ^ (k[2] * 0xC2B2AE3D);     // bytes 12-15 are always zero
+   return((hash ^ (hash >> 15)) & (SYMBOL_SLOTS-1));
+}
+
+
+/**
+ * Look up the id of a key.
+ *
+ * @param  __m128i& key
+ * @param  uint&    slot - variable receiving the matching or the first empty slot
+ *
+ * @return uint - symbol id or 0 if the symbol is not interned
+ */
+uint WINAPI findSymbolKey(const __m128i& key, uint& slot) {
+   for (slot=symbolSlot(key);; slot=(slot+1) & (SYMBOL_SLOTS-1)) {
+      uint id = symbolSlotIds[slot];
+      if (!id) return(0);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(symbolKeys[slot], key)) == 0xFFFF)
+         return(id);
+   }
+}
+
+
+/**
+ * Return the id of a symbol name and intern the name if it's not yet known. Ids are dense, start at 1 and stay valid for
+ * the lifetime of the process, so indexes, caches and lookup tables should key on the id instead of comparing names. Known
+ * names are resolved without locking.
+ *
+ * @param  char* symbol - symbol name (case-sensitive)
+ *
+ * @return uint - symbol id or 0 in case of errors
+ */
+uint WINAPI InternSymbol(const char* symbol) {
+   if ((uint)symbol < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbol = 0x%p (not a valid pointer)", symbol));
+
+   __m128i key;
+   if (!symbolKey(symbol, key)) return(error(ERR_INVALID_PARAMETER, "illegal length of parameter symbol = \"%s\" (must be 1 to %d characters)", symbol, MAX_SYMBOL_LENGTH));
+
+   uint slot, id = findSymbolKey(key, slot);
+   if (id) return(id);
+
+   EnterCriticalSection(&g_terminalLock);
+   id = findSymbolKey(key, slot);                                    // re-check, another thread may have interned the name
+   if (!id) {
+      if (symbolsCount >= MAX_INTERNED_SYMBOLS) {
+         LeaveCriticalSection(&g_terminalLock);
+         return(error(ERR_RUNTIME_ERROR, "cannot intern symbol \"%s\" (max. %d symbols)", symbol, MAX_INTERNED_SYMBOLS));
+      }
+      id = symbolsCount + 1;
+      _mm_store_si128((__m128i*)symbolNames[id], key);
+      _mm_store_si128(&symbolKeys[slot], key);
+      symbolSlotIds[slot] = id;                                      // publish the slot
+      symbolsCount = id;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   return(id);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the id of an interned symbol name without interning it.
+ *
+ * @param  char* symbol - symbol name (case-sensitive)
+ *
+ * @return uint - symbol id or 0 if the name is not interned or invalid
+ */
+uint WINAPI FindSymbolId(const char* symbol) {
+   if ((uint)symbol < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbol = 0x%p (not a valid pointer)", symbol));
+
+   __m128i key;
+   if (!symbolKey(symbol, key)) return(0);
+
+   uint slot;
+   return(findSymbolKey(key, slot));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the name of an interned symbol.
+ *
+ * @param  uint id - symbol id
+ *
+ * @return char* - symbol name or NULL if the id is unknown
+ */
+const char* WINAPI GetSymbolName(uint id) {
+   if (!id || id > symbolsCount) return((char*)error(ERR_INVALID_PARAMETER, "invalid parameter id = %d (unknown symbol id)", id));
+   return(symbolNames[id]);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the number of interned symbols. Valid symbol ids range from 1 to the returned value.
+ *
+ * @return uint
+ */
+uint WINAPI GetSymbolsCount() {
+   return(symbolsCount);
+   #pragma EXPANDER_EXPORT
+}
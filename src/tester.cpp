@@ -1,16 +1,26 @@
 #include "expander.h"
+#include "capture.h"
 #include "struct/xtrade/ExecutionContext.h"
+#include "tester/passcache.h"
+#include "tester/testerini.h"
+#include "tester/teststore.h"
 #include "util/helper.h"
 #include "util/math.h"
 #include "util/toString.h"
 #include "util/format.h"
 
 #include <fstream>
+#include <map>
 #include <time.h>
 
 
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+std::map<const TEST*, string> testInputs;                            // normalized input parameters of running tests (not part
+                                                                     // of the TEST struct shared with MQL)
+
 // forward declaration
-BOOL WINAPI SaveTest(TEST* test);
+BOOL WINAPI SaveTest(TEST* test, const string& inputs);
 
 
 /**
@@ -21,11 +31,27 @@ BOOL WINAPI CollectTestData(EXECUTION_CONTEXT* ec, datetime startTime, datetime
    if (!ec->programId)                             return(error(ERR_INVALID_PARAMETER, "invalid execution context:  ec.programId=%d", ec->programId));
    if (ec->programType!=PT_EXPERT || !ec->testing) return(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test"));
 
+   CaptureScope capture(CF_COLLECTTESTDATA, ec, sizeof(CAPTURE_TESTDATA_ARGS));
+   if (capture.args) {
+      CAPTURE_TESTDATA_ARGS* args = (CAPTURE_TESTDATA_ARGS*)capture.args;
+      args->startTime   = startTime;
+      args->endTime     = endTime;
+      args->bid         = bid;
+      args->ask         = ask;
+      args->bars        = bars;
+      args->reportingId = reportingId;
+      CopyCaptureString(args->reportingSymbol, reportingSymbol, sizeof(args->reportingSymbol));
+   }
+
    TEST* test;
 
    if (ec->rootFunction == RF_START) {
       if (ec->test) return(error(ERR_RUNTIME_ERROR, "multiple TEST initializations in %s::start()", ec->programName));
 
+      TESTER_INI ini;                                                // parsed only once per file version
+      BOOL hasIni = GetTesterIni(ec->programName, ini);
+      int barModel = (hasIni && ini.barModel!=EMPTY) ? ini.barModel : GetFxtBarModel(FindTestFxtFile(ec->symbol, ec->timeframe));
+
       ec->test = test = new TEST();
       test_SetTime           (test, time(NULL)      );
       test_SetStrategy       (test, ec->programName );
@@ -34,14 +60,20 @@ BOOL WINAPI CollectTestData(EXECUTION_CONTEXT* ec, datetime startTime, datetime
       test_SetSymbol         (test, ec->symbol      );
       test_SetTimeframe      (test, ec->timeframe   );
       test_SetStartTime      (test, startTime       );
-      //uint barModel;                                               // TODO
+      if (barModel != EMPTY) test_SetBarModel(test, barModel);
       test_SetSpread         (test, (ask-bid)/0.0001);               // TODO: statt 0.0001 Variable Pip
       test_SetBars           (test, bars            );
-      //uint tradeDirections;                                        // TODO: aus Expert.ini auslesen
+      if (hasIni && ini.tradeDirections) test_SetTradeDirections(test, ini.tradeDirections);
       test_SetVisualMode     (test, ec->visualMode  );
       test_SetDuration       (test, GetTickCount()  );
       test->orders = new OrderHistory(512);                          // reserve memory to speed-up testing
       test->orders->resize(0);
+
+      // During an optimization the tester .ini holds the base inputs, not the values of the running pass. The inputs of
+      // an optimization pass are unknown and not stored.
+      EnterCriticalSection(&g_terminalLock);
+      testInputs[test] = (hasIni && !ec->optimization) ? ini.inputs : "";
+      LeaveCriticalSection(&g_terminalLock);
    }
    else if (ec->rootFunction == RF_DEINIT) {
       test = ec->test;
@@ -52,7 +84,19 @@ BOOL WINAPI CollectTestData(EXECUTION_CONTEXT* ec, datetime startTime, datetime
       test_SetTicks   (test, ec->ticks                      );
       test_SetDuration(test, GetTickCount() - test->duration);
 
-      SaveTest(test);
+      string inputs;
+      EnterCriticalSection(&g_terminalLock);
+      std::map<const TEST*, string>::iterator it = testInputs.find(test);
+      if (it != testInputs.end()) {
+         inputs = it->second;
+         testInputs.erase(it);
+      }
+      LeaveCriticalSection(&g_terminalLock);
+
+      if (!IsReplayThread()) {                                       // a replayed test is not a real test
+         SaveTest(test, inputs);
+         MemoizePass(ec, test);
+      }
    }
    else return(error(ERR_FUNC_NOT_ALLOWED, "function not allowed in %s::%s()", ec->programName, RootFunctionDescription(ec->rootFunction)));
 
@@ -61,6 +105,22 @@ BOOL WINAPI CollectTestData(EXECUTION_CONTEXT* ec, datetime startTime, datetime
 }
 
 
+/**
+ * Free a TEST created by CollectTestData() together with its order history and discard its input parameters. Used for tests
+ * not owned by an MQL program (e.g. tests of a replay).
+ *
+ * @param  TEST* test
+ */
+void WINAPI ReleaseTest(TEST* test) {
+   EnterCriticalSection(&g_terminalLock);
+   testInputs.erase(test);
+   LeaveCriticalSection(&g_terminalLock);
+
+   delete test->orders;
+   delete test;
+}
+
+
 /**
  * TODO: validation
  */
@@ -71,6 +131,22 @@ BOOL WINAPI Test_OpenOrder(EXECUTION_CONTEXT* ec, int ticket, int type, double l
    TEST*         test   = ec->test;     if (!test)   return(error(ERR_RUNTIME_ERROR, "invalid TEST initialization,  ec.test=0x%p", ec->test));
    OrderHistory* orders = test->orders; if (!orders) return(error(ERR_RUNTIME_ERROR, "invalid OrderHistory initialization,  test.orders=0x%p", test->orders));
 
+   CaptureScope capture(CF_TEST_OPENORDER, ec, sizeof(CAPTURE_OPENORDER_ARGS));
+   if (capture.args) {
+      CAPTURE_OPENORDER_ARGS* args = (CAPTURE_OPENORDER_ARGS*)capture.args;
+      args->ticket      = ticket;
+      args->type        = type;
+      args->lots        = lots;
+      CopyCaptureString(args->symbol, symbol, sizeof(args->symbol));
+      args->openPrice   = openPrice;
+      args->openTime    = openTime;
+      args->stopLoss    = stopLoss;
+      args->takeProfit  = takeProfit;
+      args->commission  = commission;
+      args->magicNumber = magicNumber;
+      CopyCaptureString(args->comment, comment, sizeof(args->comment));
+   }
+
    ORDER order = {};
       order.ticket      = ticket;
       order.type        = type;
@@ -108,6 +184,16 @@ BOOL WINAPI Test_CloseOrder(EXECUTION_CONTEXT* ec, int ticket, double closePrice
    TEST*         test   = ec->test;     if (!test)   return(error(ERR_RUNTIME_ERROR, "invalid TEST initialization,  ec.test=0x%p", ec->test));
    OrderHistory* orders = test->orders; if (!orders) return(error(ERR_RUNTIME_ERROR, "invalid OrderHistory initialization,  test.orders=0x%p", test->orders));
 
+   CaptureScope capture(CF_TEST_CLOSEORDER, ec, sizeof(CAPTURE_CLOSEORDER_ARGS));
+   if (capture.args) {
+      CAPTURE_CLOSEORDER_ARGS* args = (CAPTURE_CLOSEORDER_ARGS*)capture.args;
+      args->ticket     = ticket;
+      args->closePrice = closePrice;
+      args->closeTime  = closeTime;
+      args->swap       = swap;
+      args->profit     = profit;
+   }
+
    uint i = orders->size()-1;
 
    for (; i >= 0; --i) {                                             // iterate in reverse order to speed-up
@@ -130,32 +216,15 @@ BOOL WINAPI Test_CloseOrder(EXECUTION_CONTEXT* ec, int ticket, double closePrice
 /**
  * Save the results of a TEST.
  *
- * @param  TEST* test
+ * @param  TEST*   test
+ * @param  string& inputs - normalized input parameters of the test
  *
  * @return BOOL - success status
  */
-BOOL WINAPI SaveTest(TEST* test) {
-   // save TEST to logfile
-   string testLogfile = getTerminalPath() +"/tester/files/testresults/"+ test->strategy +" #"+ to_string(test->reportingId) + localTimeFormat(test->time, "  %d.%m.%Y %H.%M.%S.log");
-   std::ofstream fs;
-   fs.open(testLogfile.c_str()); if (!fs.is_open()) return(error(ERR_RUNTIME_ERROR, "fs.open(\"%s\") failed", testLogfile.c_str()));
-   fs << "test=" << TEST_toStr(test) << "\n";
+BOOL WINAPI SaveTest(TEST* test, const string& inputs) {
+   // save TEST and orders to the test store
+   if (!test->orders) return(error(ERR_RUNTIME_ERROR, "invalid OrderHistory  test.orders=0x%p", test->orders));
+   if (!StoreTest(test, inputs)) return(FALSE);                     // the normalized input parameters are stored with the TEST
    debug("test=%s", TEST_toStr(test));
-
-   OrderHistory* orders = test->orders; if (!orders) return(error(ERR_RUNTIME_ERROR, "invalid OrderHistory  test.orders=0x%p", test->orders));
-   int size = orders->size();
-
-   for (int i=0; i < size; ++i) {
-      ORDER* order = &(*orders)[i];
-      fs << "order." << i << "=" << ORDER_toStr(order) << "\n";
-   }
-   fs.close();
-
-   // backup input parameters
-   // TODO: MetaTrader creates/updates the expert.ini file when the dialog "Expert properties" is confirmed.
-   string paramSrcFile  = getTerminalPath() +"/tester/"+ test->strategy +".ini";
-   string paramDestFile = getTerminalPath() +"/tester/files/testresults/"+ test->strategy +" #"+ to_string(test->reportingId) + localTimeFormat(test->time, "  %d.%m.%Y %H.%M.%S.ini");
-   if (!CopyFile(paramSrcFile.c_str(), paramDestFile.c_str(), TRUE))
-      return(error(ERR_WIN32_ERROR+GetLastError(), "CopyFile() failed"));
    return(TRUE);
 }
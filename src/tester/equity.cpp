@@ -0,0 +1,184 @@
+#include "expander.h"
+#include "tester/equity.h"
+#include "struct/mt4/HistoryBar401.h"
+#include "struct/mt4/HistoryHeader.h"
+#include "util/helper.h"
+#include "util/math.h"
+#include "util/toString.h"
+
+#include <algorithm>
+#include <fstream>
+
+
+/**
+ * Reconstruct the mark-to-market balance, equity and margin of a test at the close of each price bar. The sweep keeps running
+ * sums of the open long and short positions (lots and lots*openPrice) which are updated by the sorted open and close events,
+ * so the floating profit of all open positions is evaluated in constant time per bar.
+ *
+ * Profits are calculated from Bid prices with a constant tick value (exact for symbols quoted in the account currency). Margin
+ * is calculated from the symbol's contract size (or initial margin) for the net position and from the hedged margin for the
+ * hedged part of the position.
+ *
+ * @param  OrderHistory& orders         - order history of the test
+ * @param  PriceSeries&  prices         - price bars of the tested symbol in ascending time order (typically M1 bars)
+ * @param  SYMBOL*       symbol         - symbol definition of the tested symbol
+ * @param  double        tickValue      - value of a tick (point) per lot in account currency
+ * @param  uint          leverage       - account leverage
+ * @param  double        initialBalance - account balance at the start of the test
+ * @param  EquitySeries& series         - vector receiving the reconstructed account states, one element per price bar
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CalculateEquityCurve(const OrderHistory& orders, const PriceSeries& prices, const SYMBOL* symbol, double tickValue, uint leverage, double initialBalance, EquitySeries& series) {
+   if ((uint)symbol < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter symbol = 0x%p (not a valid pointer)", symbol));
+   if (symbol->pointSize <= 0)           return(error(ERR_INVALID_PARAMETER, "invalid symbol.pointSize = %f", symbol->pointSize));
+   if (symbol->contractSize <= 0)        return(error(ERR_INVALID_PARAMETER, "invalid symbol.contractSize = %f", symbol->contractSize));
+   if (tickValue <= 0)                   return(error(ERR_INVALID_PARAMETER, "invalid parameter tickValue = %f", tickValue));
+   if (!leverage)                        return(error(ERR_INVALID_PARAMETER, "invalid parameter leverage = %d", leverage));
+
+   double unitValue     = tickValue / symbol->pointSize;             // account currency per lot and price unit
+   double quoteValue    = unitValue / symbol->contractSize;          // account currency per quote currency unit
+   double marginNet     = symbol->marginInit ? symbol->marginInit : symbol->contractSize;
+   double marginHedged  = symbol->marginHedged;
+
+   std::vector<uint> opens, closes;                                  // indexes of market orders sorted by open and close time
+   uint ordersSize = orders.size();
+   for (uint i=0; i < ordersSize; ++i) {
+      const ORDER& order = orders[i];
+      if (order.type!=OP_BUY && order.type!=OP_SELL) continue;
+      if (strcmp(order.symbol, symbol->name) != 0)   continue;
+      opens.push_back(i);
+      if (order.closeTime) closes.push_back(i);
+   }
+   std::stable_sort(opens.begin(),  opens.end(),  OrderOpenTimeLess(orders));
+   std::stable_sort(closes.begin(), closes.end(), OrderCloseTimeLess(orders));
+
+   uint   pricesSize=prices.size(), opensSize=opens.size(), closesSize=closes.size(), o=0, c=0;
+   int    longOrders=0, shortOrders=0;
+   double longLots=0, longCost=0, shortLots=0, shortCost=0, balance=initialBalance;
+
+   series.clear();
+   series.reserve(pricesSize);
+   EQUITY_BAR bar = {};
+
+   for (uint p=0; p < pricesSize; ++p) {
+      const PRICE_BAR& price = prices[p];
+      datetime barEnd = (p+1 < pricesSize) ? prices[p+1].time : INT_MAX;
+
+      for (; o < opensSize && orders[opens[o]].openTime < barEnd; ++o) {
+         const ORDER& order = orders[opens[o]];
+         if (order.type == OP_BUY) { longOrders++;  longLots  += order.lots; longCost  += order.lots * order.openPrice; }
+         else                      { shortOrders++; shortLots += order.lots; shortCost += order.lots * order.openPrice; }
+      }
+      for (; c < closesSize && orders[closes[c]].closeTime < barEnd; ++c) {
+         const ORDER& order = orders[closes[c]];
+         if (order.type == OP_BUY) { longOrders--;  longLots  -= order.lots; longCost  -= order.lots * order.openPrice; }
+         else                      { shortOrders--; shortLots -= order.lots; shortCost -= order.lots * order.openPrice; }
+         balance += order.profit + order.swap + order.commission;
+      }
+      if (!longOrders)  longLots  = longCost  = 0;                   // reset accumulated rounding errors
+      if (!shortOrders) shortLots = shortCost = 0;
+
+      double netLots = longLots - shortLots;
+      double cost    = longCost - shortCost;
+      double atHigh  = balance + (netLots * price.high  - cost) * unitValue;
+      double atLow   = balance + (netLots * price.low   - cost) * unitValue;
+
+      bar.time       = price.time;
+      bar.balance    = balance;
+      bar.equity     = balance + (netLots * price.close - cost) * unitValue;
+      bar.equityHigh = std::max(atHigh, atLow);
+      bar.equityLow  = std::min(atHigh, atLow);
+      bar.margin     = (fabs(netLots) * marginNet + std::min(longLots, shortLots) * marginHedged) * price.close * quoteValue / leverage;
+      series.push_back(bar);
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Write an equity series to a history file (bar format 401) which can be opened in the terminal as an offline chart. A bar's
+ * open is the equity at the close of the previous bar, its close the equity at the bar's close. An existing file is replaced.
+ *
+ * @param  EquitySeries& series    - equity series
+ * @param  char*         symbol    - symbol of the history file
+ * @param  uint          timeframe - timeframe of the history file (should be the timeframe of the price bars of the series)
+ * @param  char*         fileName  - full file name
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI SaveEquityCurve(const EquitySeries& series, const char* symbol, uint timeframe, const char* fileName) {
+   if ((uint)symbol < MIN_VALID_POINTER)                            return(error(ERR_INVALID_PARAMETER, "invalid parameter symbol = 0x%p (not a valid pointer)", symbol));
+   if (!*symbol || strlen(symbol) > MAX_SYMBOL_LENGTH)              return(error(ERR_INVALID_PARAMETER, "invalid parameter symbol = %s", DoubleQuoteStr(symbol)));
+   if (!IsStdTimeframe(timeframe) && !IsCustomTimeframe(timeframe)) return(error(ERR_INVALID_PARAMETER, "invalid parameter timeframe = %d", timeframe));
+   if ((uint)fileName < MIN_VALID_POINTER)                          return(error(ERR_INVALID_PARAMETER, "invalid parameter fileName = 0x%p (not a valid pointer)", fileName));
+
+   std::ofstream fs;
+   fs.open(fileName, std::ios::binary|std::ios::trunc); if (!fs.is_open()) return(error(ERR_FILE_CANNOT_OPEN, "fs.open(\"%s\") failed", fileName));
+
+   HISTORY_HEADER hh = {};
+   hh.barFormat = 401;
+   strcpy(hh.copyright, "equity curve");
+   strcpy(hh.symbol, symbol);
+   hh.period    = timeframe;
+   hh.digits    = 2;
+   fs.write((const char*)&hh, sizeof(hh));
+
+   uint size = series.size();
+   std::vector<HISTORY_BAR_401> bars(size);                          // write all bars at once
+
+   for (uint i=0; i < size; ++i) {
+      const EQUITY_BAR& eb  = series[i];
+      HISTORY_BAR_401&  bar = bars[i];
+      bar.time   = eb.time;
+      bar.open   = round(i ? series[i-1].equity : eb.equity, 2);
+      bar.close  = round(eb.equity, 2);
+      bar.high   = std::max(round(eb.equityHigh, 2), std::max(bar.open, bar.close));
+      bar.low    = std::min(round(eb.equityLow,  2), std::min(bar.open, bar.close));
+      bar.ticks  = 1;
+      bar.spread = 0;
+      bar.volume = 0;
+   }
+   if (size) fs.write((const char*)&bars[0], size * sizeof(HISTORY_BAR_401));
+
+   BOOL success = fs.good();
+   fs.close();
+   if (!success) return(error(ERR_FILE_WRITE_ERROR, "writing of \"%s\" failed", fileName));
+   return(TRUE);
+}
+
+
+/**
+ * Reconstruct the equity curve of the running test and save it to the history directory of the specified trade server under
+ * the test's reporting symbol.
+ *
+ * @param  EXECUTION_CONTEXT* ec             - execution context of an expert under test
+ * @param  char*              priceFile      - full name of the history file with the prices of the test symbol (typically M1)
+ * @param  uint               timeframe      - timeframe of the price file and of the resulting history file
+ * @param  SYMBOL*            symbol         - symbol definition of the tested symbol
+ * @param  double             tickValue      - value of a tick (point) per lot in account currency
+ * @param  uint               leverage       - account leverage
+ * @param  double             initialBalance - account balance at the start of the test
+ * @param  char*              serverName     - name of the trade server directory receiving the history file
+ *
+ * @return int - number of written bars or EMPTY (-1) in case of errors
+ */
+int WINAPI Test_SaveEquityCurve(const EXECUTION_CONTEXT* ec, const char* priceFile, uint timeframe, const SYMBOL* symbol, double tickValue, uint leverage, double initialBalance, const char* serverName) {
+   if ((uint)ec         < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec = 0x%p (not a valid pointer)", ec)));
+   if (!ec->test || !ec->test->orders)       return(_EMPTY(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if ((uint)serverName < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter serverName = 0x%p (not a valid pointer)", serverName)));
+   const TEST* test = ec->test;
+   if (!*test->reportingSymbol)              return(_EMPTY(error(ERR_ILLEGAL_STATE, "test.reportingSymbol not set")));
+
+   PriceSeries prices;
+   if (!LoadPriceSeries(priceFile, ec->symbol, test->startTime, test->endTime, prices)) return(EMPTY);
+
+   EquitySeries series;
+   if (!CalculateEquityCurve(*test->orders, prices, symbol, tickValue, leverage, initialBalance, series)) return(EMPTY);
+
+   string fileName = getTerminalPath() +"/history/"+ serverName +"/"+ test->reportingSymbol + to_string(timeframe) +".hst";
+   if (!SaveEquityCurve(series, test->reportingSymbol, timeframe, fileName.c_str())) return(EMPTY);
+
+   return(series.size());
+   #pragma EXPANDER_EXPORT
+}
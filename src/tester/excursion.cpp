@@ -0,0 +1,128 @@
+#include "expander.h"
+#include "tester/excursion.h"
+#include "util/toString.h"
+
+#include <algorithm>
+
+
+/**
+ * Calculate the maximum adverse and favorable excursion (MAE/MFE), the time to the MFE and the maximum intra-trade drawdown
+ * of all market orders of an order history in a single sweep over the price series. Orders are activated in open time order
+ * and stay active until their close time (open orders until the end of the series), so the cost is O(n*log(n) + samples +
+ * covered samples) instead of a separate price scan per order.
+ *
+ * Prices are Bid prices. An order is activated at the sample covering its open time (the last sample at or before it), as in
+ * CalculateEquityCurve(). With bar data (e.g. M1) the full range of a bar is attributed to every order active in it, i.e. bar
+ * data may overstate the excursions of the bars an order was opened or closed in.
+ *
+ * @param  OrderHistory&    orders  - orders to analyze
+ * @param  PriceSeries&     prices  - price samples in ascending time order
+ * @param  ExcursionVector& results - vector receiving the results, one element per order (same index as in 'orders')
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CalculateExcursions(const OrderHistory& orders, const PriceSeries& prices, ExcursionVector& results) {
+   uint ordersSize = orders.size();
+   results.assign(ordersSize, ORDER_EXCURSION());
+
+   std::vector<uint> queue;                                          // indexes of market orders sorted by open time
+   queue.reserve(ordersSize);
+   for (uint i=0; i < ordersSize; ++i) {
+      if (orders[i].type==OP_BUY || orders[i].type==OP_SELL) {
+         queue.push_back(i);
+         results[i].ticket = orders[i].ticket;
+      }
+   }
+   std::stable_sort(queue.begin(), queue.end(), OrderOpenTimeLess(orders));
+
+   std::vector<uint>   active;                                       // indexes of the currently active orders
+   std::vector<double> peaks(ordersSize, 0);                         // running maximum profit per order in price units
+   uint next=0, queueSize=queue.size(), pricesSize=prices.size();
+
+   for (uint p=0; p < pricesSize && (next < queueSize || !active.empty()); ++p) {
+      const PRICE_BAR& bar = prices[p];
+      datetime barEnd = (p+1 < pricesSize) ? prices[p+1].time : INT_MAX;
+
+      while (next < queueSize && orders[queue[next]].openTime < barEnd) {
+         active.push_back(queue[next++]);
+      }
+
+      for (uint a=0; a < active.size(); ) {
+         uint i = active[a];
+         const ORDER& order = orders[i];
+
+         if (order.closeTime && order.closeTime < bar.time) {        // remove closed orders (swap with the last element)
+            active[a] = active.back();
+            active.pop_back();
+            continue;
+         }
+         BOOL   isLong     = (order.type == OP_BUY);
+         double favorable  = isLong ? bar.high - order.openPrice : order.openPrice - bar.low;
+         double adverse    = isLong ? order.openPrice - bar.low  : bar.high - order.openPrice;
+         double lastProfit = isLong ? bar.close - order.openPrice : order.openPrice - bar.close;
+         ORDER_EXCURSION& ex = results[i];
+
+         if (favorable > ex.mfe) {
+            ex.mfe       = favorable;
+            ex.mfeTime   = bar.time;
+            ex.timeToMfe = (uint)std::max(bar.time - order.openTime, (datetime)0);
+         }
+         if (adverse > ex.mae) {
+            ex.mae     = adverse;
+            ex.maeTime = bar.time;
+         }
+         // drawdown: the adverse extreme is compared against the peak of the previous samples, the close against the new peak
+         double& peak = peaks[i];
+         ex.drawdown = std::max(ex.drawdown, peak + adverse);
+         peak        = std::max(peak, favorable);
+         ex.drawdown = std::max(ex.drawdown, peak - lastProfit);
+         ex.samples++;
+         ++a;
+      }
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Calculate MAE/MFE figures for the orders of the running test. The orders are matched against the price samples of the
+ * specified history file (an M1 history file, the test's FXT file or "ticks.raw").
+ *
+ * @param  EXECUTION_CONTEXT* ec       - execution context of an expert under test
+ * @param  char*              fileName - full name of the history file with the prices of the test symbol
+ * @param  ORDER_EXCURSION    results  - array receiving the results (one element per order in the order history)
+ * @param  int                size     - size of the passed array
+ *
+ * @return int - number of orders in the history (results are written only if the array is large enough)
+ *               or EMPTY (-1) in case of errors
+ */
+int WINAPI Test_CalculateExcursions(const EXECUTION_CONTEXT* ec, const char* fileName, ORDER_EXCURSION results[], int size) {
+   if ((uint)ec       < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec = 0x%p (not a valid pointer)", ec)));
+   if (!ec->test)                          return(_EMPTY(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if (!ec->test->orders)                  return(_EMPTY(error(ERR_ILLEGAL_STATE, "order history of the test not initialized: ec.test.orders = NULL")));
+   if ((uint)results  < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter results = 0x%p (not a valid pointer)", results)));
+   if (size < 0)                           return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+
+   const OrderHistory& orders = *ec->test->orders;
+   int ordersSize = orders.size();
+   if (!ordersSize || size < ordersSize) return(ordersSize);
+
+   datetime from=INT_MAX, to=0;
+   BOOL hasOpenOrders = FALSE;
+   for (int i=0; i < ordersSize; ++i) {
+      from = std::min(from, orders[i].openTime);
+      if (orders[i].closeTime) to = std::max(to, orders[i].closeTime);
+      else                     hasOpenOrders = TRUE;
+   }
+   if (hasOpenOrders) to = ec->test->endTime;                        // 0 (not yet set) loads up to the end of the file
+
+   PriceSeries prices;                                               // start with the bar containing the first open time
+   if (!LoadPriceSeries(fileName, ec->symbol, from, to, prices, TRUE)) return(EMPTY);
+
+   ExcursionVector excursions;
+   if (!CalculateExcursions(orders, prices, excursions)) return(EMPTY);
+
+   memcpy(results, &excursions[0], ordersSize * sizeof(ORDER_EXCURSION));
+   return(ordersSize);
+   #pragma EXPANDER_EXPORT
+}
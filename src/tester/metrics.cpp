@@ -0,0 +1,47 @@
+#include "expander.h"
+#include "tester/metrics.h"
+
+#include <algorithm>
+
+
+/**
+ * Calculate the summary metrics of a test pass from its closed market orders. Trades are evaluated in close time order, the
+ * drawdown is the largest decline of the closed-trade balance from its running maximum. PASS_METRICS.duration is not modified.
+ *
+ * @param  OrderHistory& orders  - orders of the test pass
+ * @param  PASS_METRICS* metrics - struct receiving the metrics
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CalculatePassMetrics(const OrderHistory& orders, PASS_METRICS* metrics) {
+   if ((uint)metrics < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter metrics = 0x%p (not a valid pointer)", metrics));
+
+   std::vector<uint> closed;                                         // indexes of closed market orders sorted by close time
+   uint size = orders.size();
+   for (uint i=0; i < size; ++i) {
+      if ((orders[i].type==OP_BUY || orders[i].type==OP_SELL) && orders[i].closeTime) closed.push_back(i);
+   }
+   std::stable_sort(closed.begin(), closed.end(), OrderCloseTimeLess(orders));
+
+   int    winners = 0;
+   double balance=0, peak=0, grossProfit=0, grossLoss=0, maxDrawdown=0;
+
+   for (uint i=0; i < closed.size(); ++i) {
+      const ORDER& order = orders[closed[i]];
+      double profit = order.profit + order.swap + order.commission;
+
+      if (profit > 0) { grossProfit += profit; winners++; }
+      else              grossLoss   += profit;
+      balance    += profit;
+      peak        = std::max(peak, balance);
+      maxDrawdown = std::max(maxDrawdown, peak - balance);
+   }
+   metrics->trades       = closed.size();
+   metrics->profit       = balance;
+   metrics->grossProfit  = grossProfit;
+   metrics->grossLoss    = grossLoss;
+   metrics->profitFactor = grossLoss ? grossProfit/-grossLoss : 0;
+   metrics->maxDrawdown  = maxDrawdown;
+   metrics->winRate      = closed.empty() ? 0 : (double)winners/closed.size();
+   return(TRUE);
+}
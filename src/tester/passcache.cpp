@@ -0,0 +1,297 @@
+#include "expander.h"
+#include "history.h"
+#include "tester/metrics.h"
+#include "tester/passcache.h"
+#include "tester/testerini.h"
+#include "struct/mt4/FxtHeader.h"
+#include "util/helper.h"
+#include "util/toString.h"
+
+#include <map>
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+/**
+ * The pass cache memoizes the metrics of optimization passes. A pass is identified by a hash of the strategy name, the
+ * normalized input parameters, the content checksum of the FXT file, the bar model and the spread. An expert looks up its pass
+ * in init() with Test_RecallPass() and may skip the pass on a hit. The metrics of executed passes are stored when the test
+ * finishes. Entries are appended to the cache file "tester/files/testresults/passcache.dat" and are shared between terminals.
+ */
+#pragma pack(push, 1)
+struct PASS_CACHE_RECORD {
+   uint64       key;                                                 // pass hash
+   PASS_METRICS metrics;
+};
+#pragma pack(pop)
+
+
+// checksum of an FXT file version
+struct FXT_CHECKSUM {
+   uint64 lastWrite;                                                 // modification time of the file
+   uint64 size;
+   uint64 checksum;
+   uint   model;                                                     // bar model of the file
+};
+
+std::map<uint64, PASS_METRICS> passCache;                            // all known pass results
+uint                           passCacheOffset;                      // bytes of the cache file read so far
+std::map<string, FXT_CHECKSUM> fxtChecksums;                         // checksums of FXT files (key: file name)
+std::map<uint, uint64>         pendingPasses;                        // pass hashes of running tests missed in the cache (key:
+                                                                     // program id)
+int                            passCacheHits;
+int                            passCacheMisses;
+
+
+/**
+ * Update a 64-bit FNV-1a hash with the content of a buffer. Full 64-bit words are hashed as a unit, which is not the canonical
+ * FNV-1a but eight times faster for large files.
+ */
+uint64 WINAPI hash64(const void* data, uint size, uint64 hash = 14695981039346656037ULL) {
+   const uint64 prime = 1099511628211ULL;
+   const BYTE* p = (const BYTE*)data;
+   uint words = size >> 3;
+
+   for (uint i=0; i < words; ++i, p += 8) {
+      hash = (hash ^ *(const uint64*)p) * prime;
+   }
+   for (uint i=words << 3; i < size; ++i, ++p) {
+      hash = (hash ^ *p) * prime;
+   }
+   return(hash);
+}
+
+
+/**
+ * Return the content checksum of an FXT file. Checksums are cached per file version (modification time and size), so the file
+ * is read only once per version. The file is hashed without holding the terminal lock.
+ *
+ * @param  string  fileName
+ * @param  uint64* checksum - variable receiving the checksum
+ * @param  uint*   model    - variable receiving the bar model of the file
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI getFxtChecksum(const string& fileName, uint64* checksum, uint* model) {
+   WIN32_FILE_ATTRIBUTE_DATA fad;
+   if (!GetFileAttributesEx(fileName.c_str(), GetFileExInfoStandard, &fad))
+      return(error(ERR_WIN32_ERROR+GetLastError(), "GetFileAttributesEx(%s) failed", DoubleQuoteStr(fileName.c_str())));
+
+   FXT_CHECKSUM version;
+   version.lastWrite = (uint64)fad.ftLastWriteTime.dwHighDateTime << 32 | fad.ftLastWriteTime.dwLowDateTime;
+   version.size      = (uint64)fad.nFileSizeHigh << 32 | fad.nFileSizeLow;
+
+   EnterCriticalSection(&g_terminalLock);
+   std::map<string, FXT_CHECKSUM>::const_iterator it = fxtChecksums.find(fileName);
+   BOOL cached = (it != fxtChecksums.end() && it->second.lastWrite == version.lastWrite && it->second.size == version.size);
+   if (cached) {
+      version.checksum = it->second.checksum;
+      version.model    = it->second.model;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (!cached) {
+      MAPPED_FILE mf;
+      if (!MapFile(fileName.c_str(), &mf)) return(FALSE);
+      if (GetHistoryFileType(&mf) != HFT_FXT) {
+         UnmapFile(&mf);
+         return(error(ERR_FILE_INCOMPATIBLE, "not an FXT file: %s", DoubleQuoteStr(fileName.c_str())));
+      }
+      version.checksum = hash64(mf.data, mf.size);
+      version.model    = ((const FXT_HEADER*)mf.data)->modelType;
+      UnmapFile(&mf);
+
+      EnterCriticalSection(&g_terminalLock);
+      fxtChecksums[fileName] = version;
+      LeaveCriticalSection(&g_terminalLock);
+   }
+   *checksum = version.checksum;
+   *model    = version.model;
+   return(TRUE);
+}
+
+
+/**
+ * Read the records appended to the cache file since the last call. The file is read without holding the terminal lock, the
+ * records are merged under it. Records read concurrently by multiple threads are merged more than once, which is harmless.
+ */
+void WINAPI loadPassCache() {
+   string fileName = getTerminalPath() +"/tester/files/testresults/passcache.dat";
+   HANDLE hFile = CreateFile(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE) return;                        // no cache file yet
+
+   EnterCriticalSection(&g_terminalLock);
+   uint offset = passCacheOffset;
+   LeaveCriticalSection(&g_terminalLock);
+
+   DWORD size = GetFileSize(hFile, NULL), bytes = 0;
+   uint records = (size - std::min(size, (DWORD)offset)) / sizeof(PASS_CACHE_RECORD);
+   std::vector<PASS_CACHE_RECORD> buffer(records);
+
+   if (records) {
+      SetFilePointer(hFile, offset, NULL, FILE_BEGIN);
+      if (!ReadFile(hFile, &buffer[0], records * sizeof(PASS_CACHE_RECORD), &bytes, NULL)) bytes = 0;
+      records = bytes / sizeof(PASS_CACHE_RECORD);
+   }
+   CloseHandle(hFile);
+   if (!records) return;
+
+   EnterCriticalSection(&g_terminalLock);
+   for (uint i=0; i < records; ++i) {
+      passCache[buffer[i].key] = buffer[i].metrics;
+   }
+   passCacheOffset = std::max(passCacheOffset, offset + records * (uint)sizeof(PASS_CACHE_RECORD));
+   LeaveCriticalSection(&g_terminalLock);
+}
+
+
+/**
+ * Append a record to the cache file. Must be called without holding the terminal lock.
+ */
+BOOL WINAPI appendPassCache(const PASS_CACHE_RECORD& record) {
+   string fileName = getTerminalPath() +"/tester/files/testresults/passcache.dat";
+   HANDLE hFile = CreateFile(fileName.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE) return(error(ERR_WIN32_ERROR+GetLastError(), "CreateFile(%s) failed", DoubleQuoteStr(fileName.c_str())));
+
+   DWORD written;
+   BOOL success = WriteFile(hFile, &record, sizeof(record), &written, NULL) && written==sizeof(record);
+   if (!success) error(ERR_WIN32_ERROR+GetLastError(), "WriteFile(%s) failed", DoubleQuoteStr(fileName.c_str()));
+   CloseHandle(hFile);
+   return(success);
+}
+
+
+/**
+ * Look up the result of the current test pass in the pass cache. Must be called by an expert under test before the test
+ * starts (in init()). On a hit the expert may skip the pass, on a miss the pass result is stored when the test finishes.
+ *
+ * @param  EXECUTION_CONTEXT* ec      - execution context of an expert under test
+ * @param  char*              fxtFile - full name of the test's FXT file (NULL or empty: the latest FXT file of the symbol and
+ *                                      timeframe)
+ * @param  char*              inputs  - input parameters of the pass (NULL: the inputs of the tester .ini file; not allowed
+ *                                      during optimizations as the .ini file doesn't hold the values of the pass)
+ * @param  double             spread  - spread of the test in pips
+ * @param  PASS_METRICS*      metrics - struct receiving the metrics on a hit
+ *
+ * @return int - 1 on a hit, 0 on a miss or EMPTY (-1) in case of errors
+ */
+int WINAPI Test_RecallPass(const EXECUTION_CONTEXT* ec, const char* fxtFile, const char* inputs, double spread, PASS_METRICS* metrics) {
+   if ((uint)ec < MIN_VALID_POINTER)                 return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter ec = 0x%p (not a valid pointer)", ec)));
+   if (ec->programType!=PT_EXPERT || !ec->testing)   return(_EMPTY(error(ERR_FUNC_NOT_ALLOWED, "function allowed only in experts under test")));
+   if (fxtFile && (uint)fxtFile < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter fxtFile = 0x%p (not a valid pointer)", fxtFile)));
+   if (inputs  && (uint)inputs  < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter inputs = 0x%p (not a valid pointer)", inputs)));
+   if (!inputs && ec->optimization)                  return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter inputs = NULL (the actual input values are required during optimizations)")));
+   if ((uint)metrics < MIN_VALID_POINTER)            return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter metrics = 0x%p (not a valid pointer)", metrics)));
+
+   string normalized;
+   if (inputs) normalized = NormalizeInputs(inputs);
+   else if (!ReadTesterInputs(ec->programName, normalized)) return(EMPTY);
+
+   string fileName = (fxtFile && *fxtFile) ? fxtFile : FindTestFxtFile(ec->symbol, ec->timeframe);
+   if (fileName.empty()) return(_EMPTY(error(ERR_FILE_NOT_FOUND, "FXT file of %s,%s not found", ec->symbol, PeriodDescription(ec->timeframe))));
+
+   uint64 checksum;
+   uint model;
+   if (!getFxtChecksum(fileName, &checksum, &model)) return(EMPTY);
+
+   char buffer[32];
+   sprintf(buffer, "%u|%.1f", model, spread);                        // spread is rounded to the precision of TEST.spread
+
+   uint64 key = hash64(ec->programName, strlen(ec->programName) + 1);
+   key = hash64(normalized.c_str(), normalized.length() + 1, key);
+   key = hash64(&checksum, sizeof(checksum), key);
+   key = hash64(buffer, strlen(buffer), key);
+
+   EnterCriticalSection(&g_terminalLock);
+   BOOL cached = (passCache.find(key) != passCache.end());
+   LeaveCriticalSection(&g_terminalLock);
+   if (!cached) loadPassCache();                                     // check for results added by other terminals
+
+   EnterCriticalSection(&g_terminalLock);
+   std::map<uint64, PASS_METRICS>::const_iterator it = passCache.find(key);
+   int result = (it != passCache.end());
+   if (result) {
+      *metrics = it->second;
+      pendingPasses.erase(ec->programId);                            // the expert is expected to skip the pass
+      passCacheHits++;
+   }
+   else {
+      pendingPasses[ec->programId] = key;
+      passCacheMisses++;
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   return(result);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Store the metrics of a finished test in the pass cache if the pass was looked up with Test_RecallPass() before.
+ *
+ * @param  EXECUTION_CONTEXT* ec   - execution context of the expert under test
+ * @param  TEST*              test - the finished test
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI MemoizePass(const EXECUTION_CONTEXT* ec, const TEST* test) {
+   if (!test->orders) return(error(ERR_RUNTIME_ERROR, "invalid OrderHistory  test.orders=0x%p", test->orders));
+
+   PASS_CACHE_RECORD record = {};
+   BOOL pending = FALSE;
+
+   EnterCriticalSection(&g_terminalLock);
+   std::map<uint, uint64>::iterator it = pendingPasses.find(ec->programId);
+   if (it != pendingPasses.end()) {
+      record.key = it->second;
+      pendingPasses.erase(it);
+      pending = (passCache.find(record.key) == passCache.end());
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   if (!pending) return(TRUE);
+
+   if (!CalculatePassMetrics(*test->orders, &record.metrics)) return(FALSE);
+   record.metrics.duration = test->duration;
+
+   EnterCriticalSection(&g_terminalLock);
+   BOOL added = passCache.insert(std::make_pair(record.key, record.metrics)).second;
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (added) return(appendPassCache(record));                       // the file is written without holding the lock
+   return(TRUE);
+}
+
+
+/**
+ * Discard the pass looked up by a program which finished without storing its result. Called when the program is released,
+ * so a later program reusing the id doesn't store its metrics under the stale pass hash.
+ *
+ * @param  uint programId
+ */
+void WINAPI ReleasePendingPass(uint programId) {
+   EnterCriticalSection(&g_terminalLock);
+   pendingPasses.erase(programId);
+   LeaveCriticalSection(&g_terminalLock);
+}
+
+
+/**
+ * Return the hit/miss statistics of the pass cache of the current terminal.
+ *
+ * @param  int* hits   - variable receiving the number of hits
+ * @param  int* misses - variable receiving the number of misses
+ *
+ * @return int - number of cached pass results
+ */
+int WINAPI Test_GetPassCacheStats(int* hits, int* misses) {
+   if ((uint)hits   < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter hits = 0x%p (not a valid pointer)", hits)));
+   if ((uint)misses < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter misses = 0x%p (not a valid pointer)", misses)));
+
+   EnterCriticalSection(&g_terminalLock);
+   *hits   = passCacheHits;
+   *misses = passCacheMisses;
+   int size = passCache.size();
+   LeaveCriticalSection(&g_terminalLock);
+   return(size);
+   #pragma EXPANDER_EXPORT
+}
@@ -0,0 +1,245 @@
+#include "expander.h"
+#include "tester/testerini.h"
+#include "struct/mt4/FxtHeader.h"
+#include "util/helper.h"
+#include "util/toString.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+/**
+ * Trim leading and trailing white space of a string.
+ */
+string WINAPI trim(const string& str) {
+   size_t first = str.find_first_not_of(" \t");
+   if (first == string::npos) return("");
+   size_t last = str.find_last_not_of(" \t");
+   return(str.substr(first, last-first+1));
+}
+
+
+/**
+ * Normalize a list of input parameters to a canonical form: one "name=value" pair per line, white space trimmed, numeric values
+ * in a uniform format, lines sorted by name. Optimization settings of tester .ini files ("name,F=", "name,1=" etc.) and
+ * trailing semicolons are removed. The result doesn't depend on the order, formatting or separators of the passed inputs.
+ *
+ * @param  string inputs - input parameters separated by line breaks or semicolons
+ *
+ * @return string - normalized inputs
+ */
+string WINAPI NormalizeInputs(const string& inputs) {
+   std::vector<string> lines;
+   std::istringstream is(inputs);
+   string line;
+
+   while (!getLine(is, line).eof()) {
+      std::istringstream ls(line);
+      string pair;
+      while (std::getline(ls, pair, ';')) {
+         size_t pos = pair.find('=');
+         if (pos == string::npos) continue;
+         string name = trim(pair.substr(0, pos)), value = trim(pair.substr(pos+1));
+         if (name.empty() || name.find(',') != string::npos) continue;
+
+         const char* begin = value.c_str();
+         char* end;
+         double number = strtod(begin, &end);
+         if (end != begin && !*end) {                                // a number: use a uniform format
+            char buffer[32];
+            sprintf(buffer, "%.10g", number);
+            value = buffer;
+         }
+         lines.push_back(name +"="+ value);
+      }
+   }
+   std::sort(lines.begin(), lines.end());
+
+   string result;
+   for (uint i=0; i < lines.size(); ++i) {
+      if (i) result.append("\n");
+      result.append(lines[i]);
+   }
+   return(result);
+}
+
+
+/**
+ * Return the modification time and size of a file.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI getFileVersion(const string& fileName, uint64* lastWrite, uint64* size) {
+   WIN32_FILE_ATTRIBUTE_DATA fad;
+   if (!GetFileAttributesEx(fileName.c_str(), GetFileExInfoStandard, &fad)) return(FALSE);
+   *lastWrite = (uint64)fad.ftLastWriteTime.dwHighDateTime << 32 | fad.ftLastWriteTime.dwLowDateTime;
+   *size      = (uint64)fad.nFileSizeHigh << 32 | fad.nFileSizeLow;
+   return(TRUE);
+}
+
+
+/**
+ * Parse a tester .ini file. Reads the trade directions ("positions") and the bar model ("model", if present) of section
+ * <common> and the input parameters of section <inputs>.
+ *
+ * @param  string      fileName
+ * @param  TESTER_INI& ini - struct receiving the settings (the file version is not modified)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI parseTesterIni(const string& fileName, TESTER_INI& ini) {
+   std::ifstream fs(fileName.c_str());
+   if (!fs) return(error(ERR_FILE_CANNOT_OPEN, "cannot open file %s", DoubleQuoteStr(fileName.c_str())));
+
+   string line, section, inputs;
+   ini.barModel        = EMPTY;
+   ini.tradeDirections = 0;
+
+   while (!getLine(fs, line).eof()) {
+      if (line.length() > 2 && line[0]=='<' && line[line.length()-1]=='>') {
+         section = (line[1] == '/') ? "" : line.substr(1, line.length()-2);
+         continue;
+      }
+      if (section == "inputs") {
+         inputs.append(line).append("\n");
+      }
+      else if (section == "common") {
+         size_t pos = line.find('=');
+         if (pos == string::npos) continue;
+         string name = trim(line.substr(0, pos));
+         int value = atoi(line.c_str() + pos + 1);
+
+         if (name == "positions") {                                  // 0=Long only, 1=Short only, 2=Long & Short
+            if (value >= 0 && value <= 2) ini.tradeDirections = value + TRADE_DIRECTIONS_LONG;
+         }
+         else if (name == "model") {
+            if (value >= BM_EVERYTICK && value <= BM_BAROPEN) ini.barModel = value;
+         }
+      }
+   }
+   ini.inputs = NormalizeInputs(inputs);
+   return(TRUE);
+}
+
+
+// bar model of an FXT file version
+struct FXT_MODEL {
+   uint64 lastWrite;
+   uint64 size;
+   int    barModel;
+};
+
+std::map<string, TESTER_INI> testerInis;                             // parsed tester .ini files (key: file name)
+std::map<string, FXT_MODEL>  fxtModels;                              // bar models of FXT files (key: file name)
+
+
+/**
+ * Return the settings of the tester .ini file "tester/{expert}.ini". A file is parsed only once per file version (modification
+ * time and size). Subsequent calls, e.g. of optimization passes, only check the file's attributes.
+ *
+ * @param  char*       expert - expert name
+ * @param  TESTER_INI& ini    - struct receiving the settings
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI GetTesterIni(const char* expert, TESTER_INI& ini) {
+   if ((uint)expert < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter expert = 0x%p (not a valid pointer)", expert));
+
+   string fileName = getTerminalPath() +"/tester/"+ expert +".ini";
+   uint64 lastWrite, size;
+   if (!getFileVersion(fileName, &lastWrite, &size)) return(error(ERR_FILE_NOT_FOUND, "file not found: %s", DoubleQuoteStr(fileName.c_str())));
+
+   EnterCriticalSection(&g_terminalLock);
+   BOOL success = TRUE;
+   std::map<string, TESTER_INI>::iterator it = testerInis.find(fileName);
+
+   if (it == testerInis.end() || it->second.lastWrite != lastWrite || it->second.size != size) {
+      TESTER_INI parsed;
+      parsed.lastWrite = lastWrite;
+      parsed.size      = size;
+      success = parseTesterIni(fileName, parsed);
+      if (success) {
+         testerInis[fileName] = parsed;
+         it = testerInis.find(fileName);
+      }
+   }
+   if (success) ini = it->second;
+   LeaveCriticalSection(&g_terminalLock);
+   return(success);
+}
+
+
+/**
+ * Read the input parameters of an expert from its tester settings file "tester/{expert}.ini".
+ *
+ * @param  char*   expert - expert name
+ * @param  string& inputs - string receiving the normalized inputs
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI ReadTesterInputs(const char* expert, string& inputs) {
+   TESTER_INI ini;
+   if (!GetTesterIni(expert, ini)) return(FALSE);
+   inputs = ini.inputs;
+   return(TRUE);
+}
+
+
+/**
+ * Return the name of the most recently modified FXT file of a symbol and timeframe. The tester (re)generates the FXT file of
+ * a test before the test starts, so this is the FXT file of the running test.
+ *
+ * @param  char* symbol
+ * @param  uint  timeframe
+ *
+ * @return string - full file name or an empty string if no FXT file was found
+ */
+string WINAPI FindTestFxtFile(const char* symbol, uint timeframe) {
+   string result;
+   uint64 latest = 0, lastWrite, size;
+
+   for (int model=BM_EVERYTICK; model <= BM_BAROPEN; ++model) {
+      string fileName = getTerminalPath() +"/tester/history/"+ symbol + to_string(timeframe) +"_"+ to_string(model) +".fxt";
+      if (getFileVersion(fileName, &lastWrite, &size) && lastWrite > latest) {
+         latest = lastWrite;
+         result = fileName;
+      }
+   }
+   return(result);
+}
+
+
+/**
+ * Return the bar model of an FXT file. The file header is read only once per file version.
+ *
+ * @param  string fileName
+ *
+ * @return int - bar model or EMPTY (-1) in case of errors
+ */
+int WINAPI GetFxtBarModel(const string& fileName) {
+   FXT_MODEL version;
+   if (!getFileVersion(fileName, &version.lastWrite, &version.size)) return(_EMPTY(error(ERR_FILE_NOT_FOUND, "file not found: %s", DoubleQuoteStr(fileName.c_str()))));
+
+   EnterCriticalSection(&g_terminalLock);
+   std::map<string, FXT_MODEL>::iterator it = fxtModels.find(fileName);
+
+   if (it == fxtModels.end() || it->second.lastWrite != version.lastWrite || it->second.size != version.size) {
+      FXT_HEADER fh = {};
+      std::ifstream fs(fileName.c_str(), std::ios::binary);
+      fs.read((char*)&fh, sizeof(fh));
+      version.barModel = (fs && fh.version==405) ? (int)fh.modelType : EMPTY;
+      fxtModels[fileName] = version;
+      it = fxtModels.find(fileName);
+   }
+   int model = it->second.barModel;
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (model == EMPTY) return(_EMPTY(error(ERR_FILE_INCOMPATIBLE, "not an FXT file: %s", DoubleQuoteStr(fileName.c_str()))));
+   return(model);
+}
@@ -0,0 +1,671 @@
+#include "expander.h"
+#include "tester/teststore.h"
+#include "util/helper.h"
+#include "util/toString.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+
+/**
+ * The test store keeps the results of all tests in append-only segment files "tester/files/testresults/store/segment.NNNN.dat".
+ * A segment consists of records. A record is a TEST_STORE_RECORD header followed by a payload: a TEST struct, the test's
+ * orders and its normalized input parameters, the id of a deleted test or the highest assigned id. Appends of multiple
+ * terminals are serialized by a lock file, a record is written with a single write. An incomplete record at the end of a
+ * segment (a running write or a crash) is ignored until it's complete.
+ *
+ * The secondary index (strategy, symbol, timeframe, reportingId, time) is kept in memory together with the stored TEST
+ * structs, so a query reads no records. Before each access the segment directory is listed and the last segment is checked for
+ * records appended since the last scan. Only the last segment can grow, older ones are scanned once. A compaction starts the new segments with the highest id ever assigned, so ids of deleted tests are never reused.
+ *
+ * The in-memory state is guarded by the store's own lock, the file I/O never runs under the application wide lock.
+ */
+#define TEST_STORE_MAGIC          0x31535254                         // "TRS1"
+#define TEST_STORE_SEGMENT_LIMIT  (64*1024*1024)                     // segment size limit (a new segment is started when exceeded)
+#define TSR_TEST                  1                                  // record types
+#define TSR_DELETE                2
+#define TSR_MAXID                 3                                  // highest assigned test id (written by a compaction)
+
+
+#pragma pack(push, 1)
+struct TEST_STORE_RECORD {                                           // record header
+   uint magic;                                                       // TEST_STORE_MAGIC
+   uint type;                                                        // TSR_TEST | TSR_DELETE | TSR_MAXID
+   uint size;                                                        // size of the payload following the header
+   uint testSize;                                                    // size of the TEST struct in the payload (sizeof(TEST) when written)
+   uint orders;                                                      // number of ORDER structs following the TEST struct
+   uint checksum;                                                    // FNV-1a hash of the payload
+};
+#pragma pack(pop)
+
+
+// index entry of a stored test
+struct TEST_INDEX_ENTRY {
+   string   strategy;
+   TEST     test;                                                    // the stored TEST struct (orders are NULL)
+   uint     segment;                                                 // segment number
+   uint     offset;                                                  // offset of the record in the segment
+};
+
+// scan state of a segment file
+struct TEST_SEGMENT {
+   uint number;
+   uint scanned;                                                     // bytes scanned so far
+   BOOL complete;                                                    // whether the segment was scanned after a newer one existed
+};
+
+std::vector<TEST_INDEX_ENTRY> testIndex;                             // index of all stored tests sorted by key
+uint                          testIndexSorted;                       // size of the sorted part of the index during a refresh
+std::vector<TEST_SEGMENT>     testSegments;                          // all known segments in ascending order
+std::set<int>                 testIds;                               // ids of all indexed or deleted tests
+int                           testMaxId;                             // highest id ever assigned
+CRITICAL_SECTION              testStoreLock;                         // guards the in-memory state of the store
+
+
+/**
+ * Initialize the test store. Called on DLL_PROCESS_ATTACH.
+ */
+void WINAPI InitTestStore() {
+   InitializeCriticalSection(&testStoreLock);
+}
+
+
+/**
+ * Release the test store. Called on DLL_PROCESS_DETACH.
+ */
+void WINAPI ReleaseTestStore() {
+   DeleteCriticalSection(&testStoreLock);
+}
+
+
+/**
+ * Key order of the secondary index.
+ */
+bool operator< (const TEST_INDEX_ENTRY& a, const TEST_INDEX_ENTRY& b) {
+   int cmp = a.strategy.compare(b.strategy);     if (cmp) return(cmp < 0);
+   cmp = strcmp(a.test.symbol, b.test.symbol);    if (cmp) return(cmp < 0);
+   if (a.test.timeframe   != b.test.timeframe)   return(a.test.timeframe   < b.test.timeframe);
+   if (a.test.reportingId != b.test.reportingId) return(a.test.reportingId < b.test.reportingId);
+   if (a.test.time        != b.test.time)        return(a.test.time        < b.test.time);
+   return(a.test.id < b.test.id);
+}
+
+
+/**
+ * Return the FNV-1a hash of a buffer.
+ */
+uint WINAPI fnv1a(const void* data, uint size) {
+   const BYTE* p = (const BYTE*)data;
+   uint hash = 2166136261U;
+   for (uint i=0; i < size; ++i) {
+      hash = (hash ^ p[i]) * 16777619U;
+   }
+   return(hash);
+}
+
+
+/**
+ * Return the directory of the test store.
+ */
+const string& WINAPI testStoreDirectory() {
+   static string dir;
+   if (dir.empty()) dir = getTerminalPath() +"/tester/files/testresults/store";
+   return(dir);
+}
+
+
+/**
+ * Return the full file name of a segment.
+ */
+string WINAPI segmentFileName(uint number, const char* extension = "dat") {
+   char name[32];
+   sprintf(name, "/segment.%04u.%s", number, extension);
+   return(testStoreDirectory() + name);
+}
+
+
+/**
+ * Acquire the exclusive lock of the test store shared by all terminals. Creates the store directory if it doesn't exist.
+ *
+ * @return HANDLE - handle of the lock file or INVALID_HANDLE_VALUE in case of errors
+ */
+HANDLE WINAPI lockTestStore() {
+   const string& dir = testStoreDirectory();
+   if (!CreateDirectory(dir.c_str(), NULL) && GetLastError()!=ERROR_ALREADY_EXISTS) {
+      error(ERR_WIN32_ERROR+GetLastError(), "CreateDirectory(%s) failed", DoubleQuoteStr(dir.c_str()));
+      return(INVALID_HANDLE_VALUE);
+   }
+   string lockFile = dir +"/store.lock";
+   HANDLE hFile = CreateFile(lockFile.c_str(), GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE) {
+      error(ERR_WIN32_ERROR+GetLastError(), "CreateFile(%s) failed", DoubleQuoteStr(lockFile.c_str()));
+      return(INVALID_HANDLE_VALUE);
+   }
+   OVERLAPPED ov = {};
+   if (!LockFileEx(hFile, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov)) {  // blocks until the lock is released by other terminals
+      error(ERR_WIN32_ERROR+GetLastError(), "LockFileEx(%s) failed", DoubleQuoteStr(lockFile.c_str()));
+      CloseHandle(hFile);
+      return(INVALID_HANDLE_VALUE);
+   }
+   return(hFile);
+}
+
+
+/**
+ * Release the lock of the test store.
+ */
+void WINAPI unlockTestStore(HANDLE hLock) {
+   OVERLAPPED ov = {};
+   UnlockFileEx(hLock, 0, 1, 0, &ov);
+   CloseHandle(hLock);
+}
+
+
+/**
+ * Return the numbers of all existing segments in ascending order.
+ */
+std::vector<uint> WINAPI listSegments() {
+   std::vector<uint> numbers;
+   WIN32_FIND_DATA wfd;
+   string pattern = testStoreDirectory() +"/segment.*.dat";
+
+   HANDLE hFind = FindFirstFile(pattern.c_str(), &wfd);
+   if (hFind != INVALID_HANDLE_VALUE) {
+      do {
+         uint number;
+         if (sscanf(wfd.cFileName, "segment.%u.dat", &number) == 1) numbers.push_back(number);
+      } while (FindNextFile(hFind, &wfd));
+      FindClose(hFind);
+   }
+   std::sort(numbers.begin(), numbers.end());
+   return(numbers);
+}
+
+
+/**
+ * Read the records of a segment appended since the last scan and add them to the index.
+ *
+ * @param  TEST_SEGMENT& segment
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI scanSegment(TEST_SEGMENT& segment) {
+   string fileName = segmentFileName(segment.number);
+   HANDLE hFile = CreateFile(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE) return(error(ERR_WIN32_ERROR+GetLastError(), "CreateFile(%s) failed", DoubleQuoteStr(fileName.c_str())));
+
+   DWORD size = GetFileSize(hFile, NULL), bytes;
+   uint offset = segment.scanned;
+   TEST_STORE_RECORD record;
+
+   while (offset + sizeof(record) <= size) {
+      SetFilePointer(hFile, offset, NULL, FILE_BEGIN);
+      if (!ReadFile(hFile, &record, sizeof(record), &bytes, NULL) || bytes!=sizeof(record)) break;
+      if (record.magic != TEST_STORE_MAGIC) {
+         warn(ERR_FILE_INCOMPATIBLE, "invalid record at offset %d of %s (skipping the rest of the segment)", offset, DoubleQuoteStr(fileName.c_str()));
+         offset = size;
+         break;
+      }
+      if (offset + sizeof(record) + record.size > size) break;       // incomplete record
+
+      if (record.type == TSR_TEST) {
+         TEST_INDEX_ENTRY entry = {};
+         ReadFile(hFile, &entry.test, std::min(record.testSize, (uint)sizeof(TEST)), &bytes, NULL);
+         entry.test.orders = NULL;
+
+         if (testIds.insert(entry.test.id).second) {                 // skip duplicates left over by an interrupted compaction
+            entry.strategy = entry.test.strategy;
+            entry.segment  = segment.number;
+            entry.offset   = offset;
+            testIndex.push_back(entry);
+            testMaxId = std::max(testMaxId, entry.test.id);
+         }
+      }
+      else if (record.type == TSR_DELETE) {
+         int id = 0;
+         ReadFile(hFile, &id, sizeof(id), &bytes, NULL);
+         testIds.insert(id);
+         testMaxId = std::max(testMaxId, id);
+         for (uint i=0; i < testIndex.size(); ++i) {
+            if (testIndex[i].test.id == id) {
+               testIndex.erase(testIndex.begin() + i);
+               if (i < testIndexSorted) testIndexSorted--;
+               break;
+            }
+         }
+      }
+      else if (record.type == TSR_MAXID) {
+         int id = 0;
+         ReadFile(hFile, &id, sizeof(id), &bytes, NULL);
+         testMaxId = std::max(testMaxId, id);
+      }
+      offset += sizeof(record) + record.size;
+   }
+   CloseHandle(hFile);
+   segment.scanned = offset;
+   return(TRUE);
+}
+
+
+/**
+ * Bring the index up-to-date with the segment files. Rebuilds the index if segments were removed by a compaction.
+ * The caller must hold testStoreLock and the lock file.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI refreshTestIndex() {
+   std::vector<uint> numbers = listSegments();
+
+   for (uint i=0; i < testSegments.size(); ++i) {
+      if (!std::binary_search(numbers.begin(), numbers.end(), testSegments[i].number)) {
+         testIndex.clear();                                          // a known segment was compacted: rebuild the index
+         testSegments.clear();
+         testIds.clear();
+         testMaxId = 0;
+         break;
+      }
+   }
+   testIndexSorted = testIndex.size();
+
+   for (uint i=0; i < numbers.size(); ++i) {
+      if (i == testSegments.size()) {
+         TEST_SEGMENT segment = { numbers[i], 0, FALSE };
+         testSegments.push_back(segment);
+      }
+      TEST_SEGMENT& segment = testSegments[i];
+      if (segment.complete) continue;                                // only the last segment is appended to
+      if (!scanSegment(segment)) return(FALSE);
+      segment.complete = (i+1 < numbers.size());
+   }
+
+   if (testIndexSorted < testIndex.size()) {                         // sort the new entries and merge them into the sorted part
+      std::sort(testIndex.begin() + testIndexSorted, testIndex.end());
+      std::inplace_merge(testIndex.begin(), testIndex.begin() + testIndexSorted, testIndex.end());
+      testIndexSorted = testIndex.size();
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Compose the payload of a test record: the TEST struct, its orders and its input parameters.
+ *
+ * @param  TEST*              test
+ * @param  OrderHistory&      orders
+ * @param  string&            inputs
+ * @param  std::vector<BYTE>& payload - vector receiving the payload
+ */
+void WINAPI composeTestPayload(const TEST* test, const OrderHistory& orders, const string& inputs, std::vector<BYTE>& payload) {
+   uint ordersSize = orders.size() * sizeof(ORDER);
+   payload.resize(sizeof(TEST) + ordersSize + inputs.length());
+
+   TEST* copy = (TEST*)&payload[0];
+   memcpy(copy, test, sizeof(TEST));
+   copy->orders = NULL;                                              // pointers are meaningless in the store
+   if (ordersSize)     memcpy(&payload[sizeof(TEST)], &orders[0], ordersSize);
+   if (inputs.length()) memcpy(&payload[sizeof(TEST) + ordersSize], inputs.data(), inputs.length());
+}
+
+
+/**
+ * Read a stored test record.
+ *
+ * @param  TEST_INDEX_ENTRY& entry
+ * @param  TEST*             test   - struct receiving the test (orders are set to NULL)
+ * @param  OrderHistory*     orders - vector receiving the test's orders (NULL: orders are not read)
+ * @param  string*           inputs - string receiving the test's input parameters (NULL: inputs are not read)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI readTestRecord(const TEST_INDEX_ENTRY& entry, TEST* test, OrderHistory* orders, string* inputs = NULL) {
+   string fileName = segmentFileName(entry.segment);
+   HANDLE hFile = CreateFile(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE) return(error(ERR_WIN32_ERROR+GetLastError(), "CreateFile(%s) failed", DoubleQuoteStr(fileName.c_str())));
+
+   TEST_STORE_RECORD record;
+   DWORD bytes;
+   SetFilePointer(hFile, entry.offset, NULL, FILE_BEGIN);
+   BOOL success = ReadFile(hFile, &record, sizeof(record), &bytes, NULL) && bytes==sizeof(record);
+
+   std::vector<BYTE> payload(success ? record.size : 0);
+   if (success && record.size) {
+      success = ReadFile(hFile, &payload[0], record.size, &bytes, NULL) && bytes==record.size;
+   }
+   CloseHandle(hFile);
+
+   if (success) success = (record.testSize + record.orders*sizeof(ORDER) <= record.size);
+   if (!success || fnv1a(payload.empty() ? NULL : &payload[0], payload.size()) != record.checksum)
+      return(error(ERR_FILE_INCOMPATIBLE, "corrupted record of test id %d at offset %d of %s", entry.test.id, entry.offset, DoubleQuoteStr(fileName.c_str())));
+
+   if (test) {
+      ZeroMemory(test, sizeof(TEST));
+      memcpy(test, &payload[0], std::min(record.testSize, (uint)sizeof(TEST)));
+      test->orders = NULL;
+   }
+   if (orders) {
+      const ORDER* first = (const ORDER*)&payload[record.testSize];
+      orders->assign(first, first + record.orders);
+   }
+   if (inputs) {
+      uint offset = record.testSize + record.orders*sizeof(ORDER);   // empty for tests without inputs
+      inputs->assign((const char*)&payload[0] + offset, record.size - offset);
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Compose a record: header and payload in a single buffer (a record is written at once).
+ *
+ * @param  uint               type     - record type
+ * @param  void*              payload  - record payload
+ * @param  uint               size     - payload size
+ * @param  uint               testSize
+ * @param  uint               orders
+ * @param  std::vector<BYTE>& buffer   - vector receiving the record
+ */
+void WINAPI composeTestRecord(uint type, const void* payload, uint size, uint testSize, uint orders, std::vector<BYTE>& buffer) {
+   buffer.resize(sizeof(TEST_STORE_RECORD) + size);
+   TEST_STORE_RECORD* record = (TEST_STORE_RECORD*)&buffer[0];
+   record->magic    = TEST_STORE_MAGIC;
+   record->type     = type;
+   record->size     = size;
+   record->testSize = testSize;
+   record->orders   = orders;
+   record->checksum = fnv1a(payload, size);
+   if (size) memcpy(&buffer[sizeof(TEST_STORE_RECORD)], payload, size);
+}
+
+
+/**
+ * Append a record to the last segment (or to a new segment if the last one is full). The caller must hold testStoreLock and
+ * the lock file.
+ *
+ * @param  uint  type    - record type
+ * @param  void* payload - record payload
+ * @param  uint  size    - payload size
+ * @param  uint  testSize
+ * @param  uint  orders
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI appendTestRecord(uint type, const void* payload, uint size, uint testSize, uint orders) {
+   std::vector<BYTE> buffer;
+   composeTestRecord(type, payload, size, testSize, orders, buffer);
+
+   uint number = testSegments.empty() ? 1 : testSegments.back().number;
+   if (!testSegments.empty() && testSegments.back().scanned + buffer.size() > TEST_STORE_SEGMENT_LIMIT) number++;
+
+   string fileName = segmentFileName(number);
+   HANDLE hFile = CreateFile(fileName.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE) return(error(ERR_WIN32_ERROR+GetLastError(), "CreateFile(%s) failed", DoubleQuoteStr(fileName.c_str())));
+
+   DWORD written;
+   BOOL success = WriteFile(hFile, &buffer[0], buffer.size(), &written, NULL) && written==buffer.size();
+   if (!success) error(ERR_WIN32_ERROR+GetLastError(), "WriteFile(%s) failed", DoubleQuoteStr(fileName.c_str()));
+   CloseHandle(hFile);
+   return(success);
+}
+
+
+/**
+ * Save a TEST, its orders and its input parameters in the test store. Assigns a new unique test id.
+ *
+ * @param  TEST*   test
+ * @param  string& inputs - normalized input parameters of the test
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI StoreTest(TEST* test, const string& inputs) {
+   if ((uint)test < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter test = 0x%p (not a valid pointer)", test));
+   uint orders = test->orders ? test->orders->size() : 0;
+
+   EnterCriticalSection(&testStoreLock);
+   HANDLE hLock = lockTestStore();
+   BOOL success = (hLock != INVALID_HANDLE_VALUE) && refreshTestIndex();
+
+   if (success) {
+      test_SetId(test, testMaxId + 1);
+
+      std::vector<BYTE> payload;
+      composeTestPayload(test, test->orders ? *test->orders : OrderHistory(), inputs, payload);
+
+      success = appendTestRecord(TSR_TEST, &payload[0], payload.size(), sizeof(TEST), orders) && refreshTestIndex();
+   }
+   if (hLock != INVALID_HANDLE_VALUE) unlockTestStore(hLock);
+   LeaveCriticalSection(&testStoreLock);
+   return(success);
+}
+
+
+/**
+ * Load a stored test.
+ *
+ * @param  int           testId
+ * @param  TEST*         test   - struct receiving the test (NULL: not read)
+ * @param  OrderHistory* orders - vector receiving the orders (NULL: not read)
+ * @param  string*       inputs - string receiving the normalized input parameters (NULL: not read)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI LoadStoredTest(int testId, TEST* test, OrderHistory* orders, string* inputs) {
+   EnterCriticalSection(&testStoreLock);
+   HANDLE hLock = lockTestStore();
+   BOOL success = (hLock != INVALID_HANDLE_VALUE) && refreshTestIndex(), found = FALSE;
+
+   for (uint i=0; success && i < testIndex.size(); ++i) {
+      if (testIndex[i].test.id == testId) {
+         success = readTestRecord(testIndex[i], test, orders, inputs);
+         found = TRUE;
+         break;
+      }
+   }
+   if (hLock != INVALID_HANDLE_VALUE) unlockTestStore(hLock);
+   LeaveCriticalSection(&testStoreLock);
+
+   if (success && !found) return(error(ERR_INVALID_PARAMETER, "test id %d not found", testId));
+   return(success);
+}
+
+
+/**
+ * Query the test store for tests matching the specified criteria. Results are returned in index order (strategy, symbol,
+ * timeframe, reportingId, time) and are read from the index. The orders of the returned tests can be read with
+ * TestStore_GetOrders().
+ *
+ * @param  char*    strategy    - strategy name   (NULL or empty: all strategies)
+ * @param  char*    symbol      - tested symbol   (NULL or empty: all symbols)
+ * @param  uint     timeframe   - tested timeframe (0: all timeframes)
+ * @param  int      reportingId - reporting id    (0: all reporting ids)
+ * @param  datetime from        - first test time (0: no limit)
+ * @param  datetime to          - last test time  (0: no limit)
+ * @param  TEST     results[]   - array receiving the matching tests (TEST.orders is NULL)
+ * @param  int      size        - size of the results array (additional matches are counted but not returned)
+ *
+ * @return int - number of matching tests or EMPTY (-1) in case of errors
+ */
+int WINAPI TestStore_Query(const char* strategy, const char* symbol, uint timeframe, int reportingId, datetime from, datetime to, TEST results[], int size) {
+   if (strategy && (uint)strategy < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter strategy = 0x%p (not a valid pointer)", strategy)));
+   if (symbol   && (uint)symbol   < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter symbol = 0x%p (not a valid pointer)", symbol)));
+   if (size && (uint)results < MIN_VALID_POINTER)      return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter results = 0x%p (not a valid pointer)", results)));
+   if (!to) to = INT_MAX;
+   BOOL anyStrategy = (!strategy || !*strategy), anySymbol = (!symbol || !*symbol);
+
+   EnterCriticalSection(&testStoreLock);
+   HANDLE hLock = lockTestStore();
+   BOOL success = (hLock != INVALID_HANDLE_VALUE) && refreshTestIndex();
+   int matches = 0;
+
+   if (success) {
+      std::vector<TEST_INDEX_ENTRY>::const_iterator it = testIndex.begin(), end = testIndex.end();
+      if (!anyStrategy) {
+         TEST_INDEX_ENTRY probe = {};                                // the smallest key of the strategy
+         probe.strategy         = strategy;
+         probe.test.reportingId = INT_MIN;
+         probe.test.time        = INT_MIN;
+         probe.test.id          = INT_MIN;
+         it = std::lower_bound(testIndex.begin(), testIndex.end(), probe);
+      }
+      for (; it != end; ++it) {
+         const TEST& test = it->test;
+         if (!anyStrategy && it->strategy != strategy)          break;
+         if (!anySymbol   && strcmp(test.symbol, symbol) != 0)  continue;
+         if (timeframe    && test.timeframe   != timeframe)     continue;
+         if (reportingId  && test.reportingId != reportingId)   continue;
+         if (test.time < from || test.time > to)                continue;
+
+         if (matches < size) results[matches] = test;
+         matches++;
+      }
+   }
+   if (hLock != INVALID_HANDLE_VALUE) unlockTestStore(hLock);
+   LeaveCriticalSection(&testStoreLock);
+
+   if (!success) return(EMPTY);
+   return(matches);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the orders of a stored test.
+ *
+ * @param  int   testId
+ * @param  ORDER orders[] - array receiving the orders
+ * @param  int   size     - size of the array (the orders are copied only if the array is large enough)
+ *
+ * @return int - number of orders of the test or EMPTY (-1) in case of errors
+ */
+int WINAPI TestStore_GetOrders(int testId, ORDER orders[], int size) {
+   if (size && (uint)orders < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter orders = 0x%p (not a valid pointer)", orders)));
+
+   OrderHistory history;
+   if (!LoadStoredTest(testId, NULL, &history, NULL)) return(EMPTY);
+
+   int ordersSize = history.size();
+   if (ordersSize && size >= ordersSize) memcpy(orders, &history[0], ordersSize * sizeof(ORDER));
+   return(ordersSize);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the normalized input parameters of a stored test ("name=value" pairs separated by line breaks). The inputs of
+ * optimization passes are unknown and empty.
+ *
+ * @param  int   testId
+ * @param  char* buffer     - buffer receiving the input parameters
+ * @param  int   bufferSize - size of the buffer (the inputs are copied only if the buffer is large enough)
+ *
+ * @return int - length of the input parameters (without the terminating null character) or EMPTY (-1) in case of errors
+ */
+int WINAPI TestStore_GetInputs(int testId, char* buffer, int bufferSize) {
+   if (bufferSize && (uint)buffer < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter buffer = 0x%p (not a valid pointer)", buffer)));
+
+   string inputs;
+   if (!LoadStoredTest(testId, NULL, NULL, &inputs)) return(EMPTY);
+
+   int length = inputs.length();
+   if (bufferSize > length) memcpy(buffer, inputs.c_str(), length+1);
+   return(length);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Delete a stored test. The test is removed from the index immediately and from the segment files with the next compaction.
+ *
+ * @param  int testId
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI TestStore_DeleteTest(int testId) {
+   EnterCriticalSection(&testStoreLock);
+   HANDLE hLock = lockTestStore();
+   BOOL success = (hLock != INVALID_HANDLE_VALUE) && refreshTestIndex(), found = FALSE;
+
+   for (uint i=0; success && !found && i < testIndex.size(); ++i) {
+      found = (testIndex[i].test.id == testId);
+   }
+   if (success && found) {
+      success = appendTestRecord(TSR_DELETE, &testId, sizeof(testId), 0, 0) && refreshTestIndex();
+   }
+   if (hLock != INVALID_HANDLE_VALUE) unlockTestStore(hLock);
+   LeaveCriticalSection(&testStoreLock);
+
+   if (success && !found) return(error(ERR_INVALID_PARAMETER, "test id %d not found", testId));
+   return(success);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Compact the test store: rewrite all live tests in index order into new segments and remove the old segments (including
+ * deleted tests and invalid records). The first new segment starts with the highest assigned test id. New segments are
+ * written to temporary files and renamed when complete, so an interrupted compaction leaves the store in a valid state.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI TestStore_Compact() {
+   EnterCriticalSection(&testStoreLock);
+   HANDLE hLock = lockTestStore();
+   BOOL success = (hLock != INVALID_HANDLE_VALUE) && refreshTestIndex();
+
+   if (success) {
+      std::vector<uint> oldSegments = listSegments(), newSegments;
+      uint number = oldSegments.empty() ? 1 : oldSegments.back() + 1, size = TEST_STORE_SEGMENT_LIMIT;
+      HANDLE hFile = INVALID_HANDLE_VALUE;
+      TEST test;
+      OrderHistory orders;
+      string inputs;
+      std::vector<BYTE> payload, buffer;
+
+      for (int i=-1; success && i < (int)testIndex.size(); ++i) {    // i = -1: the id high-water mark
+         if (i < 0) {
+            composeTestRecord(TSR_MAXID, &testMaxId, sizeof(testMaxId), 0, 0, buffer);
+         }
+         else {
+            success = readTestRecord(testIndex[i], &test, &orders, &inputs);
+            if (!success) break;
+            composeTestPayload(&test, orders, inputs, payload);
+            composeTestRecord(TSR_TEST, &payload[0], payload.size(), sizeof(TEST), orders.size(), buffer);
+         }
+
+         if (size + buffer.size() > TEST_STORE_SEGMENT_LIMIT && size) {
+            if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+            string fileName = segmentFileName(number, "tmp");
+            hFile = CreateFile(fileName.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (hFile == INVALID_HANDLE_VALUE) {
+               success = error(ERR_WIN32_ERROR+GetLastError(), "CreateFile(%s) failed", DoubleQuoteStr(fileName.c_str()));
+               break;
+            }
+            newSegments.push_back(number++);
+            size = 0;
+         }
+         DWORD written;
+         success = WriteFile(hFile, &buffer[0], buffer.size(), &written, NULL) && written==buffer.size();
+         if (!success) error(ERR_WIN32_ERROR+GetLastError(), "WriteFile() failed");
+         size += buffer.size();
+      }
+      if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+
+      for (uint i=0; i < newSegments.size(); ++i) {
+         string tmpName = segmentFileName(newSegments[i], "tmp"), fileName = segmentFileName(newSegments[i]);
+         if (success && !MoveFile(tmpName.c_str(), fileName.c_str()))
+            success = error(ERR_WIN32_ERROR+GetLastError(), "MoveFile(%s) failed", DoubleQuoteStr(tmpName.c_str()));
+         if (!success) DeleteFile(tmpName.c_str());
+      }
+      if (success) {
+         for (uint i=0; i < oldSegments.size(); ++i) {
+            string fileName = segmentFileName(oldSegments[i]);
+            if (!DeleteFile(fileName.c_str())) warn(ERR_WIN32_ERROR+GetLastError(), "DeleteFile(%s) failed", DoubleQuoteStr(fileName.c_str()));
+         }
+         success = refreshTestIndex();
+      }
+   }
+   if (hLock != INVALID_HANDLE_VALUE) unlockTestStore(hLock);
+   LeaveCriticalSection(&testStoreLock);
+   return(success);
+   #pragma EXPANDER_EXPORT
+}
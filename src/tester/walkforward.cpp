@@ -0,0 +1,301 @@
+#include "expander.h"
+#include "tester/metrics.h"
+#include "tester/walkforward.h"
+#include "util/toString.h"
+
+#include <algorithm>
+#include <math.h>
+
+
+// shared state of the worker threads of an in-sample sweep
+struct WF_SWEEP {
+   const PriceSeries*        prices;
+   const WF_CONFIG*          config;
+   uint                      from;                                   // sample range of the in-sample window
+   uint                      to;
+   const double*             combinations;                           // all parameter combinations (one after another)
+   uint                      dimensions;                             // number of parameters per combination
+   uint                      size;                                   // number of combinations
+   volatile LONG             next;                                   // index of the next combination to test
+   volatile LONG             failed;                                 // whether a strategy run failed
+   std::vector<PASS_METRICS> metrics;                                // metrics per combination
+};
+
+
+// comparator for binary searches of a sample time
+struct PriceBarTimeLess {
+   bool operator()(const PRICE_BAR& bar, datetime time) const { return(bar.time < time); }
+};
+
+
+/**
+ * Return the value of a selection metric (higher values are better).
+ */
+double WINAPI selectionValue(const PASS_METRICS& metrics, WalkForwardMetric metric) {
+   switch (metric) {
+      case WFM_PROFIT:       return(metrics.profit);
+      case WFM_PROFITFACTOR: return(metrics.grossLoss ? metrics.profitFactor : (metrics.grossProfit ? INT_MAX : 0));
+      case WFM_RECOVERY:     return(metrics.maxDrawdown ? metrics.profit/metrics.maxDrawdown : (metrics.profit > 0 ? INT_MAX : metrics.profit));
+      case WFM_WINRATE:      return(metrics.winRate);
+   }
+   return(0);
+}
+
+
+/**
+ * Worker thread of an in-sample sweep. Tests parameter combinations until all combinations are taken.
+ *
+ * @param  LPVOID arg - WF_SWEEP*
+ *
+ * @return DWORD - 0
+ */
+DWORD WINAPI sweepWorker(LPVOID arg) {
+   WF_SWEEP& sweep = *(WF_SWEEP*)arg;
+   const WF_CONFIG& config = *sweep.config;
+   OrderHistory orders;
+
+   for (;;) {
+      LONG i = InterlockedIncrement(&sweep.next) - 1;
+      if (i >= (LONG)sweep.size) break;
+
+      orders.clear();
+      if (!config.strategy(*sweep.prices, sweep.from, sweep.to, &sweep.combinations[i * sweep.dimensions], sweep.dimensions, orders, config.context)) {
+         InterlockedExchange(&sweep.failed, TRUE);
+         break;
+      }
+      CalculatePassMetrics(orders, &sweep.metrics[i]);
+   }
+   return(0);
+}
+
+
+/**
+ * Enumerate all parameter combinations of a parameter grid.
+ *
+ * @param  std::vector<WF_PARAMETER>& grid
+ * @param  std::vector<double>&       combinations - vector receiving the combinations (one after another)
+ *
+ * @return uint - number of combinations or 0 in case of errors
+ */
+uint WINAPI enumerateGrid(const std::vector<WF_PARAMETER>& grid, std::vector<double>& combinations) {
+   uint dimensions = grid.size(), size = 1;
+   std::vector<uint> steps(dimensions), counter(dimensions, 0);
+
+   for (uint d=0; d < dimensions; ++d) {
+      const WF_PARAMETER& param = grid[d];
+      if (param.step < 0 || param.to < param.from) return(error(ERR_INVALID_PARAMETER, "invalid grid parameter %d: from=%f, to=%f, step=%f", d, param.from, param.to, param.step));
+      steps[d] = param.step ? (uint)floor((param.to - param.from)/param.step + 1e-9) + 1 : 1;
+      if (size * (uint64)steps[d] > 1000000) return(error(ERR_INVALID_PARAMETER, "parameter grid too large (more than 1.000.000 combinations)"));
+      size *= steps[d];
+   }
+   combinations.resize(size * dimensions);
+
+   for (uint i=0; i < size; ++i) {                                   // count through the grid like an odometer
+      for (uint d=0; d < dimensions; ++d) {
+         combinations[i*dimensions + d] = grid[d].from + counter[d] * grid[d].step;
+      }
+      for (uint d=0; d < dimensions && ++counter[d] == steps[d]; ++d) {
+         counter[d] = 0;
+      }
+   }
+   return(size);
+}
+
+
+/**
+ * Test all parameter combinations over an in-sample window. Combinations are distributed dynamically over the worker threads.
+ *
+ * @param  WF_SWEEP& sweep
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI runSweep(WF_SWEEP& sweep) {
+   uint threads = sweep.config->threads;
+   if (!threads) {
+      SYSTEM_INFO si;
+      GetSystemInfo(&si);
+      threads = si.dwNumberOfProcessors;
+   }
+   threads = std::min(std::min(threads, sweep.size), (uint)MAXIMUM_WAIT_OBJECTS);
+
+   sweep.next   = 0;
+   sweep.failed = FALSE;
+   sweep.metrics.assign(sweep.size, PASS_METRICS());
+
+   if (threads <= 1) {
+      sweepWorker(&sweep);                                           // no thread overhead for a single worker
+   }
+   else {
+      std::vector<HANDLE> handles;
+      for (uint i=0; i < threads; ++i) {
+         HANDLE hThread = CreateThread(NULL, 0, sweepWorker, &sweep, 0, NULL);
+         if (!hThread) { warn(ERR_WIN32_ERROR+GetLastError(), "CreateThread() failed"); break; }
+         handles.push_back(hThread);
+      }
+      if (handles.empty()) sweepWorker(&sweep);
+      else {
+         WaitForMultipleObjects(handles.size(), &handles[0], TRUE, INFINITE);
+         for (uint i=0; i < handles.size(); ++i) CloseHandle(handles[i]);
+      }
+   }
+   if (sweep.failed) return(error(ERR_RUNTIME_ERROR, "strategy callback failed"));
+   return(TRUE);
+}
+
+
+/**
+ * Run a walk-forward analysis: the strategy is optimized over an in-sample window, the best parameter combination is tested
+ * over the following out-of-sample window, then both windows are moved forward by the out-of-sample length. The price samples
+ * are decoded once and shared by all windows and threads, windows are sample index ranges found by binary search.
+ *
+ * @param  PriceSeries& prices - price samples of the analysis (e.g. decoded from an FXT file by LoadPriceSeries())
+ * @param  WF_CONFIG&   config - analysis configuration
+ * @param  WF_RESULT&   result - struct receiving the results
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI RunWalkForward(const PriceSeries& prices, const WF_CONFIG& config, WF_RESULT& result) {
+   if (!config.strategy)                     return(error(ERR_INVALID_PARAMETER, "invalid parameter config.strategy = NULL"));
+   if (!config.inSample)                     return(error(ERR_INVALID_PARAMETER, "invalid parameter config.inSample = %d", config.inSample));
+   if (!config.outOfSample)                  return(error(ERR_INVALID_PARAMETER, "invalid parameter config.outOfSample = %d", config.outOfSample));
+   if (config.metric > WFM_WINRATE)          return(error(ERR_INVALID_PARAMETER, "invalid parameter config.metric = %d", config.metric));
+   if (prices.empty())                       return(error(ERR_INVALID_PARAMETER, "invalid parameter prices (empty)"));
+
+   result.windows.clear();
+   result.orders.clear();
+   result.metrics    = PASS_METRICS();
+   result.efficiency = 0;
+
+   std::vector<double> combinations;
+   WF_SWEEP sweep = {};
+   sweep.prices       = &prices;
+   sweep.config       = &config;
+   sweep.dimensions   = config.grid.size();
+   sweep.size         = enumerateGrid(config.grid, combinations);
+   sweep.combinations = combinations.empty() ? NULL : &combinations[0];
+   if (!sweep.size) return(FALSE);
+
+   datetime first = prices.front().time, last = prices.back().time;
+   double inSampleProfit=0, inSampleDays=0, outOfSampleProfit=0, outOfSampleDays=0;
+   OrderHistory orders;
+
+   for (datetime t=first; t + (datetime)config.inSample <= last; t += config.outOfSample) {
+      WF_WINDOW window = {};
+      window.inSampleFrom    = t;
+      window.outOfSampleFrom = t + config.inSample;
+      window.outOfSampleTo   = std::min(window.outOfSampleFrom + (datetime)config.outOfSample, last + 1);
+
+      sweep.from = std::lower_bound(prices.begin(), prices.end(), window.inSampleFrom,    PriceBarTimeLess()) - prices.begin();
+      sweep.to   = std::lower_bound(prices.begin(), prices.end(), window.outOfSampleFrom, PriceBarTimeLess()) - prices.begin();
+      uint oosTo = std::lower_bound(prices.begin(), prices.end(), window.outOfSampleTo,   PriceBarTimeLess()) - prices.begin();
+      if (sweep.to >= oosTo) continue;                               // no out-of-sample data (e.g. a weekend)
+
+      // in-sample optimization
+      if (!runSweep(sweep)) return(FALSE);
+      uint best = 0;
+      for (uint i=1; i < sweep.size; ++i) {
+         if (selectionValue(sweep.metrics[i], config.metric) > selectionValue(sweep.metrics[best], config.metric)) best = i;
+      }
+      window.params.assign(combinations.begin() + best*sweep.dimensions, combinations.begin() + (best+1)*sweep.dimensions);
+      window.inSampleMetrics = sweep.metrics[best];
+
+      // out-of-sample test
+      orders.clear();
+      if (!config.strategy(prices, sweep.to, oosTo, window.params.empty() ? NULL : &window.params[0], sweep.dimensions, orders, config.context))
+         return(error(ERR_RUNTIME_ERROR, "strategy callback failed"));
+      CalculatePassMetrics(orders, &window.outOfSampleMetrics);
+      result.orders.insert(result.orders.end(), orders.begin(), orders.end());
+
+      double isDays  = config.inSample / 86400.;
+      double oosDays = (window.outOfSampleTo - window.outOfSampleFrom) / 86400.;
+      if (window.inSampleMetrics.profit > 0)
+         window.efficiency = (window.outOfSampleMetrics.profit/oosDays) / (window.inSampleMetrics.profit/isDays);
+      inSampleProfit    += window.inSampleMetrics.profit;    inSampleDays    += isDays;
+      outOfSampleProfit += window.outOfSampleMetrics.profit; outOfSampleDays += oosDays;
+
+      result.windows.push_back(window);
+   }
+
+   CalculatePassMetrics(result.orders, &result.metrics);
+   if (inSampleProfit > 0 && outOfSampleDays)
+      result.efficiency = (outOfSampleProfit/outOfSampleDays) / (inSampleProfit/inSampleDays);
+   return(TRUE);
+}
+
+
+/**
+ * Run a walk-forward analysis over the prices of a history file (MQL interface of RunWalkForward()). The strategy is a function
+ * exported by a strategy module (a DLL) with the signature of WalkForwardStrategy. The module receives STL containers and must
+ * be built with the same compiler and runtime as the expander.
+ *
+ * @param  char*              priceFile   - full name of the history file with the prices (HST, FXT or "ticks.raw")
+ * @param  char*              symbol      - symbol to read from a "ticks.raw" file (NULL: all symbols)
+ * @param  char*              module      - file name of the strategy module
+ * @param  char*              function    - name of the strategy function exported by the module
+ * @param  WF_PARAMETER       grid[]      - parameter grid (from, to and step of each parameter)
+ * @param  int                gridSize    - number of parameters
+ * @param  uint               inSample    - length of the in-sample windows in seconds
+ * @param  uint               outOfSample - length of the out-of-sample windows in seconds
+ * @param  int                metric      - selection metric of the in-sample optimization: WalkForwardMetric
+ * @param  uint               threads     - number of worker threads (0: number of processors)
+ * @param  WALKFORWARD_WINDOW windows[]   - array receiving the results of the windows
+ * @param  double             params[]    - array receiving the selected parameters of the windows (gridSize values per window,
+ *                                          NULL: not returned)
+ * @param  int                size        - size of the windows array (results are written only if the array is large enough)
+ * @param  PASS_METRICS*      metrics     - struct receiving the metrics of the stitched out-of-sample orders (NULL: not returned)
+ * @param  double*            efficiency  - variable receiving the overall walk-forward efficiency (NULL: not returned)
+ *
+ * @return int - number of windows or EMPTY (-1) in case of errors
+ */
+int WINAPI Test_RunWalkForward(const char* priceFile, const char* symbol, const char* module, const char* function, const WF_PARAMETER grid[], int gridSize, uint inSample, uint outOfSample, int metric, uint threads, WALKFORWARD_WINDOW windows[], double params[], int size, PASS_METRICS* metrics, double* efficiency) {
+   if ((uint)module   < MIN_VALID_POINTER)                 return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter module = 0x%p (not a valid pointer)", module)));
+   if ((uint)function < MIN_VALID_POINTER)                 return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter function = 0x%p (not a valid pointer)", function)));
+   if (gridSize < 0)                                       return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter gridSize = %d", gridSize)));
+   if (gridSize && (uint)grid < MIN_VALID_POINTER)         return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter grid = 0x%p (not a valid pointer)", grid)));
+   if (metric < WFM_PROFIT || metric > WFM_WINRATE)        return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter metric = %d (not a WalkForwardMetric)", metric)));
+   if (size < 0)                                           return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+   if (size && (uint)windows < MIN_VALID_POINTER)          return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter windows = 0x%p (not a valid pointer)", windows)));
+   if (params  && (uint)params  < MIN_VALID_POINTER)       return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter params = 0x%p (not a valid pointer)", params)));
+   if (metrics && (uint)metrics < MIN_VALID_POINTER)       return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter metrics = 0x%p (not a valid pointer)", metrics)));
+   if (efficiency && (uint)efficiency < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter efficiency = 0x%p (not a valid pointer)", efficiency)));
+
+   PriceSeries prices;
+   if (!LoadPriceSeries(priceFile, symbol, 0, 0, prices)) return(EMPTY);
+
+   HMODULE hModule = LoadLibrary(module);
+   if (!hModule) return(_EMPTY(error(ERR_WIN32_ERROR+GetLastError(), "LoadLibrary(%s) failed", DoubleQuoteStr(module))));
+
+   WF_CONFIG config;
+   config.strategy    = (WalkForwardStrategy)GetProcAddress(hModule, function);
+   config.context     = NULL;
+   config.grid.assign(grid, grid + gridSize);
+   config.inSample    = inSample;
+   config.outOfSample = outOfSample;
+   config.metric      = (WalkForwardMetric)metric;
+   config.threads     = threads;
+
+   WF_RESULT result;
+   BOOL success;
+   if (!config.strategy) success = error(ERR_WIN32_ERROR+GetLastError(), "GetProcAddress(%s) failed in module %s", DoubleQuoteStr(function), DoubleQuoteStr(module));
+   else                  success = RunWalkForward(prices, config, result);
+   FreeLibrary(hModule);
+   if (!success) return(EMPTY);
+
+   int windowsSize = result.windows.size();
+   if (windowsSize && size >= windowsSize) {
+      for (int i=0; i < windowsSize; ++i) {
+         const WF_WINDOW& window = result.windows[i];
+         windows[i].inSampleFrom       = window.inSampleFrom;
+         windows[i].outOfSampleFrom    = window.outOfSampleFrom;
+         windows[i].outOfSampleTo      = window.outOfSampleTo;
+         windows[i].efficiency         = window.efficiency;
+         windows[i].inSampleMetrics    = window.inSampleMetrics;
+         windows[i].outOfSampleMetrics = window.outOfSampleMetrics;
+         if (params && gridSize) memcpy(&params[i * gridSize], &window.params[0], gridSize * sizeof(double));
+      }
+   }
+   if (metrics)    *metrics    = result.metrics;
+   if (efficiency) *efficiency = result.efficiency;
+   return(windowsSize);
+   #pragma EXPANDER_EXPORT
+}
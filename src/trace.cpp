@@ -0,0 +1,203 @@
+#include "expander.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <intrin.h>
+#include <vector>
+
+
+#define TRACE_RING_SIZE    1024                                      // events per thread (a power of 2)
+
+
+// trace ring of a single thread (written only by the owning thread)
+struct TRACE_RING {
+   DWORD         threadId;
+   volatile uint next;                                               // total number of recorded events
+   TRACE_EVENT   events[TRACE_RING_SIZE];
+};
+
+
+// The ring list and the error dump file are guarded by a separate lock, as rings are released on DLL_THREAD_DETACH under the
+// loader lock. The trace lock is never held while calling into the loader or while taking another lock.
+DWORD                    traceTlsIndex = TLS_OUT_OF_INDEXES;         // TLS slot holding the current thread's ring
+CRITICAL_SECTION         traceLock;
+std::vector<TRACE_RING*> traceRings;                                 // rings of all live threads
+string                   traceErrorDumpFile;                         // file to dump to on errors (empty: no dump)
+volatile LONG            traceErrorDumping;                          // recursion guard of the error dump
+
+
+// comparator for merging the events of all rings
+struct TraceEventTimeLess {
+   bool operator()(const TRACE_EVENT& a, const TRACE_EVENT& b) const { return(a.timestamp < b.timestamp); }
+};
+
+
+/**
+ * Initialize tracing. Called on DLL_PROCESS_ATTACH.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI InitTrace() {
+   InitializeCriticalSection(&traceLock);
+   traceTlsIndex = TlsAlloc();
+   if (traceTlsIndex == TLS_OUT_OF_INDEXES) return(error(ERR_WIN32_ERROR+GetLastError(), "TlsAlloc() failed"));
+   return(TRUE);
+}
+
+
+/**
+ * Release all trace rings. Called on DLL_PROCESS_DETACH.
+ */
+void WINAPI ReleaseTrace() {
+   if (traceTlsIndex != TLS_OUT_OF_INDEXES) {
+      TlsFree(traceTlsIndex);
+      traceTlsIndex = TLS_OUT_OF_INDEXES;
+   }
+   for (uint i=0; i < traceRings.size(); i++) {
+      delete traceRings[i];
+   }
+   traceRings.clear();
+   DeleteCriticalSection(&traceLock);
+}
+
+
+/**
+ * Release the trace ring of the current thread. Called on DLL_THREAD_DETACH, the events of the thread are discarded.
+ */
+void WINAPI ReleaseThreadTrace() {
+   if (traceTlsIndex == TLS_OUT_OF_INDEXES) return;
+
+   TRACE_RING* ring = (TRACE_RING*)TlsGetValue(traceTlsIndex);
+   if (!ring) return;
+   TlsSetValue(traceTlsIndex, NULL);
+
+   EnterCriticalSection(&traceLock);
+   std::vector<TRACE_RING*>::iterator it = std::find(traceRings.begin(), traceRings.end(), ring);
+   if (it != traceRings.end()) traceRings.erase(it);
+   LeaveCriticalSection(&traceLock);
+   delete ring;
+}
+
+
+/**
+ * Record a context transition in the current thread's trace ring. Tracing is always on: recording needs no lock and no
+ * system call (only the ring of a thread's first event is allocated under the trace lock). Each thread keeps its last
+ * TRACE_RING_SIZE events.
+ *
+ * @param  TraceEventType     type - event type
+ * @param  EXECUTION_CONTEXT* ec   - context of the transition
+ */
+void WINAPI TraceContext(TraceEventType type, const EXECUTION_CONTEXT* ec) {
+   if (traceTlsIndex == TLS_OUT_OF_INDEXES) return;
+
+   TRACE_RING* ring = (TRACE_RING*)TlsGetValue(traceTlsIndex);
+   if (!ring) {
+      ring = new TRACE_RING();
+      ring->threadId = GetCurrentThreadId();
+      TlsSetValue(traceTlsIndex, ring);
+      EnterCriticalSection(&traceLock);
+      traceRings.push_back(ring);
+      LeaveCriticalSection(&traceLock);
+   }
+
+   TRACE_EVENT& event = ring->events[ring->next & (TRACE_RING_SIZE-1)];
+   event.timestamp    = __rdtsc();
+   event.threadId     = ring->threadId;
+   event.programId    = ec->programId;
+   event.type         = (BYTE)type;
+   event.moduleType   = (BYTE)ec->moduleType;
+   event.rootFunction = (BYTE)ec->rootFunction;
+   event.initReason   = (BYTE)ec->initReason;
+   event.uninitReason = (BYTE)ec->uninitReason;
+   ring->next++;                                                     // publish the event
+}
+
+
+/**
+ * Write the events of all trace rings to a file, merged in timestamp order. Rings of threads executing while dumping may
+ * contribute a partially written last event, events of exited threads are not included.
+ *
+ * @param  char* fileName - full file name (an existing file is replaced)
+ *
+ * @return BOOL - success status (no error is reported)
+ */
+BOOL WINAPI writeTraceDump(const char* fileName) {
+   std::vector<TRACE_EVENT> events;
+
+   EnterCriticalSection(&traceLock);
+   for (uint i=0; i < traceRings.size(); i++) {
+      const TRACE_RING* ring = traceRings[i];
+      uint next  = ring->next;
+      uint count = std::min(next, (uint)TRACE_RING_SIZE);
+      for (uint n=next-count; n != next; n++) {
+         events.push_back(ring->events[n & (TRACE_RING_SIZE-1)]);
+      }
+   }
+   LeaveCriticalSection(&traceLock);
+   std::stable_sort(events.begin(), events.end(), TraceEventTimeLess());
+
+   TRACE_DUMP_HEADER header = {};
+   memcpy(header.magic, "TRC1", 4);
+   header.events    = events.size();
+   header.timestamp = __rdtsc();
+   header.tickCount = GetTickCount();
+
+   std::ofstream fs;
+   fs.open(fileName, std::ios::binary|std::ios::trunc); if (!fs.is_open()) return(FALSE);
+   fs.write((const char*)&header, sizeof(header));
+   if (!events.empty()) fs.write((const char*)&events[0], events.size() * sizeof(TRACE_EVENT));
+   BOOL success = fs.good();
+   fs.close();
+   return(success);
+}
+
+
+/**
+ * Dump the events of all trace rings to a file (see TRACE_DUMP_HEADER for the file format).
+ *
+ * @param  char* fileName - full file name (an existing file is replaced)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Trace_Dump(const char* fileName) {
+   if ((uint)fileName < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter fileName = 0x%p (not a valid pointer)", fileName));
+   if (!*fileName)                         return(error(ERR_INVALID_PARAMETER, "invalid parameter fileName = \"\""));
+
+   if (!writeTraceDump(fileName)) return(error(ERR_FILE_WRITE_ERROR, "writing of \"%s\" failed", fileName));
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Set the file the trace rings are dumped to whenever an error is reported. Each error replaces the previous dump.
+ *
+ * @param  char* fileName - full file name or NULL to disable dumping on errors
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI Trace_SetErrorDump(const char* fileName) {
+   if (fileName && (uint)fileName < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter fileName = 0x%p (not a valid pointer)", fileName));
+
+   EnterCriticalSection(&traceLock);
+   traceErrorDumpFile = fileName ? fileName : "";
+   LeaveCriticalSection(&traceLock);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Dump the trace rings to the configured error dump file. Called for every reported error.
+ */
+void WINAPI OnTraceError() {
+   if (InterlockedExchange(&traceErrorDumping, TRUE)) return;        // no recursion
+
+   EnterCriticalSection(&traceLock);
+   string fileName = traceErrorDumpFile;
+   LeaveCriticalSection(&traceLock);
+
+   if (!fileName.empty()) writeTraceDump(fileName.c_str());
+   InterlockedExchange(&traceErrorDumping, FALSE);
+}
@@ -426,6 +426,41 @@ uint WINAPI MT4InternalMsg() {
 }
 
 
+/**
+ * Create a worker thread holding a reference to this DLL. The DLL stays loaded while the thread runs, so the thread never
+ * executes code of an unloaded module and DLL_PROCESS_DETACH never has to wait for it. The thread must end by calling
+ * ExitWorkerThread().
+ *
+ * @param  LPTHREAD_START_ROUTINE worker - thread function
+ * @param  LPVOID                 arg    - argument passed to the thread function
+ *
+ * @return HANDLE - thread handle or NULL in case of errors
+ */
+HANDLE WINAPI CreateWorkerThread(LPTHREAD_START_ROUTINE worker, LPVOID arg) {
+   HMODULE hModule;
+   if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCTSTR)worker, &hModule))
+      return((HANDLE)error(ERR_WIN32_ERROR+GetLastError(), "GetModuleHandleEx() failed"));
+
+   HANDLE hThread = CreateThread(NULL, 0, worker, arg, 0, NULL);
+   if (!hThread) {
+      error(ERR_WIN32_ERROR+GetLastError(), "CreateThread() failed");
+      FreeLibrary(hModule);
+   }
+   return(hThread);
+}
+
+
+/**
+ * End a worker thread created by CreateWorkerThread() and release its reference to the DLL. If it was the last reference the
+ * DLL is unloaded by this call, the thread doesn't return to its code.
+ */
+void WINAPI ExitWorkerThread() {
+   HMODULE hModule;
+   GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS|GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCTSTR)ExitWorkerThread, &hModule);
+   FreeLibraryAndExitThread(hModule, 0);
+}
+
+
 /**
  * Return a terminal configuration value as a boolean. Queries the global and the local configuration with the local configu-
  * ration superseding the global one. Boolean values can be expressed by "0" or "1", "On" or "Off", "Yes" or "No" and "true" or
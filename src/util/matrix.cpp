@@ -0,0 +1,362 @@
+#include "expander.h"
+#include "util/matrix.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+#include <functional>
+#include <math.h>
+#include <vector>
+
+
+#define COVARIANCE_BLOCK 512                                         // samples per block of CalculateCovariance() (even)
+
+
+/**
+ * Calculate the dot products of two pairs of rows (a 2x2 block of a matrix product). Each loaded value is used twice, which
+ * halves the loads compared to single dot products.
+ *
+ * @param  double a0[]   - first row of the first pair
+ * @param  double a1[]   - second row of the first pair
+ * @param  double b0[]   - first row of the second pair
+ * @param  double b1[]   - second row of the second pair
+ * @param  uint   size   - row length (even)
+ * @param  double sums[] - array receiving the sums a0*b0, a0*b1, a1*b0 and a1*b1 (values are added)
+ */
+inline void dotProducts2x2(const double a0[], const double a1[], const double b0[], const double b1[], uint size, double sums[]) {
+   __m128d s00=_mm_setzero_pd(), s01=_mm_setzero_pd(), s10=_mm_setzero_pd(), s11=_mm_setzero_pd();
+
+   for (uint i=0; i < size; i += 2) {
+      __m128d x0 = _mm_loadu_pd(a0 + i), x1 = _mm_loadu_pd(a1 + i);
+      __m128d y0 = _mm_loadu_pd(b0 + i), y1 = _mm_loadu_pd(b1 + i);
+      s00 = _mm_add_pd(s00, _mm_mul_pd(x0, y0));
+      s01 = _mm_add_pd(s01, _mm_mul_pd(x0, y1));
+      s10 = _mm_add_pd(s10, _mm_mul_pd(x1, y0));
+      s11 = _mm_add_pd(s11, _mm_mul_pd(x1, y1));
+   }
+   __m128d r0 = _mm_add_pd(_mm_unpacklo_pd(s00, s01), _mm_unpackhi_pd(s00, s01));
+   __m128d r1 = _mm_add_pd(_mm_unpacklo_pd(s10, s11), _mm_unpackhi_pd(s10, s11));
+   _mm_storeu_pd(sums,   _mm_add_pd(_mm_loadu_pd(sums),   r0));
+   _mm_storeu_pd(sums+2, _mm_add_pd(_mm_loadu_pd(sums+2), r1));
+}
+
+
+/**
+ * Project a vector onto the probability simplex (all elements >= 0, sum = 1), i.e. find the closest vector of weights of a
+ * fully invested long-only portfolio.
+ *
+ * @param  double values[] - vector to project
+ * @param  int    size     - vector length
+ * @param  double result[] - array receiving the projection (may be the same as 'values')
+ */
+void WINAPI projectToSimplex(const double values[], int size, double result[]) {
+   double sorted[MAX_PORTFOLIO_ASSETS];
+   std::copy(values, values + size, sorted);
+   std::sort(sorted, sorted + size, std::greater<double>());
+
+   double sum=0, theta=0;
+   for (int i=0; i < size; ++i) {
+      sum += sorted[i];
+      double t = (sum - 1) / (i+1);
+      if (sorted[i] - t > 0) theta = t;
+   }
+   for (int i=0; i < size; ++i) {
+      result[i] = std::max(values[i] - theta, 0.);
+   }
+}
+
+
+/**
+ * Validate a covariance matrix passed to a weight solver.
+ *
+ * @param  double covariance[] - matrix to validate
+ * @param  int    assets       - number of assets
+ *
+ * @return BOOL - whether the matrix is usable
+ */
+BOOL WINAPI checkCovariance(const double covariance[], int assets) {
+   if ((uint)covariance < MIN_VALID_POINTER)        return(error(ERR_INVALID_PARAMETER, "invalid parameter covariance = 0x%p (not a valid pointer)", covariance));
+   if (assets < 1 || assets > MAX_PORTFOLIO_ASSETS) return(error(ERR_INVALID_PARAMETER, "invalid parameter assets = %d (must be 1...%d)", assets, MAX_PORTFOLIO_ASSETS));
+
+   for (int i=0; i < assets; ++i) {
+      if (!(covariance[i*assets + i] > 0)) return(error(ERR_INVALID_PARAMETER, "invalid covariance[%d][%d] = %f (variance must be positive)", i, i, covariance[i*assets + i]));
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Calculate the sample covariance matrix of the returns of a set of assets. The returns are centered and transposed to one row
+ * per asset. The matrix products are calculated in 2x2 blocks of assets over blocks of samples which stay in the cache while
+ * all asset pairs are processed. The summation order is fixed, so results are reproducible.
+ *
+ * @param  double returns[]    - returns in a flat array of 'samples' rows with 'assets' columns (one row per bar)
+ * @param  int    samples      - number of samples (min. 2)
+ * @param  int    assets       - number of assets (max. MAX_PORTFOLIO_ASSETS)
+ * @param  double covariance[] - array receiving the covariance matrix, 'assets' rows with 'assets' columns
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CalculateCovariance(const double returns[], int samples, int assets, double covariance[]) {
+   if ((uint)returns    < MIN_VALID_POINTER)        return(error(ERR_INVALID_PARAMETER, "invalid parameter returns = 0x%p (not a valid pointer)", returns));
+   if (samples < 2)                                 return(error(ERR_INVALID_PARAMETER, "invalid parameter samples = %d (min. 2)", samples));
+   if (assets < 1 || assets > MAX_PORTFOLIO_ASSETS) return(error(ERR_INVALID_PARAMETER, "invalid parameter assets = %d (must be 1...%d)", assets, MAX_PORTFOLIO_ASSETS));
+   if ((uint)covariance < MIN_VALID_POINTER)        return(error(ERR_INVALID_PARAMETER, "invalid parameter covariance = 0x%p (not a valid pointer)", covariance));
+
+   uint rows   = (assets + 1) & ~1;                                  // rows and row length padded to even with zeros
+   uint stride = (samples + 1) & ~1;
+
+   double means[MAX_PORTFOLIO_ASSETS] = {};
+   for (int t=0; t < samples; ++t) {
+      const double* row = returns + t*assets;
+      for (int a=0; a < assets; ++a) means[a] += row[a];
+   }
+   for (int a=0; a < assets; ++a) means[a] /= samples;
+
+   std::vector<double> data(rows * stride, 0);                       // centered returns, one row per asset
+   for (int t=0; t < samples; ++t) {
+      const double* row = returns + t*assets;
+      for (int a=0; a < assets; ++a) data[a*stride + t] = row[a] - means[a];
+   }
+
+   std::vector<double> sums(rows * rows, 0);                         // 2x2 blocks of the lower triangle
+   const double* d = &data[0];
+
+   for (uint from=0; from < stride; from += COVARIANCE_BLOCK) {
+      uint size = std::min(stride - from, (uint)COVARIANCE_BLOCK);
+      for (uint i=0; i < rows; i += 2) {
+         const double* a0 = d + i*stride + from;
+         for (uint j=0; j <= i; j += 2) {
+            const double* b0 = d + j*stride + from;
+            dotProducts2x2(a0, a0 + stride, b0, b0 + stride, size, &sums[i*rows + j*2]);
+         }
+      }
+   }
+
+   for (uint i=0; i < rows; i += 2) {                                // unpack the blocks and mirror the lower triangle
+      for (uint j=0; j <= i; j += 2) {
+         const double* block = &sums[i*rows + j*2];
+         for (uint bi=0; bi < 2; ++bi) {
+            for (uint bj=0; bj < 2; ++bj) {
+               uint r=i+bi, c=j+bj;
+               if (r >= (uint)assets || c >= (uint)assets || c > r) continue;
+               double value = block[bi*2 + bj] / (samples-1);
+               covariance[r*assets + c] = value;
+               covariance[c*assets + r] = value;
+            }
+         }
+      }
+   }
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate the Cholesky decomposition A = L*L' of a symmetric positive definite matrix.
+ *
+ * @param  double matrix[] - matrix of 'size' rows with 'size' columns (only the lower triangle is used)
+ * @param  int    size     - matrix dimension (max. MAX_PORTFOLIO_ASSETS)
+ * @param  double lower[]  - array receiving the lower triangular matrix L (the upper triangle is set to 0)
+ *
+ * @return BOOL - success status; FALSE if the matrix is not positive definite
+ */
+BOOL WINAPI CholeskyDecompose(const double matrix[], int size, double lower[]) {
+   if ((uint)matrix < MIN_VALID_POINTER)       return(error(ERR_INVALID_PARAMETER, "invalid parameter matrix = 0x%p (not a valid pointer)", matrix));
+   if (size < 1 || size > MAX_PORTFOLIO_ASSETS) return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d (must be 1...%d)", size, MAX_PORTFOLIO_ASSETS));
+   if ((uint)lower < MIN_VALID_POINTER)        return(error(ERR_INVALID_PARAMETER, "invalid parameter lower = 0x%p (not a valid pointer)", lower));
+
+   for (int i=0; i < size; ++i) {
+      double* li = lower + i*size;
+      for (int j=0; j <= i; ++j) {
+         const double* lj = lower + j*size;
+         double sum = matrix[i*size + j];
+         for (int k=0; k < j; ++k) sum -= li[k] * lj[k];
+
+         if (i == j) {
+            if (!(sum > 0)) return(error(ERR_INVALID_PARAMETER, "matrix is not positive definite (pivot %d = %.8g)", i, sum));
+            li[i] = sqrt(sum);
+         }
+         else li[j] = sum / lj[j];
+      }
+      for (int j=i+1; j < size; ++j) li[j] = 0;
+   }
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Solve the linear equation system L*L'*x = b for a Cholesky decomposition L (forward and back substitution).
+ *
+ * @param  double lower[] - lower triangular matrix as returned by CholeskyDecompose()
+ * @param  int    size    - matrix dimension (max. MAX_PORTFOLIO_ASSETS)
+ * @param  double b[]     - right-hand side
+ * @param  double x[]     - array receiving the solution (may be the same as 'b')
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CholeskySolve(const double lower[], int size, const double b[], double x[]) {
+   if ((uint)lower < MIN_VALID_POINTER)        return(error(ERR_INVALID_PARAMETER, "invalid parameter lower = 0x%p (not a valid pointer)", lower));
+   if (size < 1 || size > MAX_PORTFOLIO_ASSETS) return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d (must be 1...%d)", size, MAX_PORTFOLIO_ASSETS));
+   if ((uint)b < MIN_VALID_POINTER)            return(error(ERR_INVALID_PARAMETER, "invalid parameter b = 0x%p (not a valid pointer)", b));
+   if ((uint)x < MIN_VALID_POINTER)            return(error(ERR_INVALID_PARAMETER, "invalid parameter x = 0x%p (not a valid pointer)", x));
+
+   double y[MAX_PORTFOLIO_ASSETS];
+   for (int i=0; i < size; ++i) {                                    // L*y = b
+      double sum = b[i];
+      for (int k=0; k < i; ++k) sum -= lower[i*size + k] * y[k];
+      y[i] = sum / lower[i*size + i];
+   }
+   for (int i=size-1; i >= 0; --i) {                                 // L'*x = y
+      double sum = y[i];
+      for (int k=i+1; k < size; ++k) sum -= lower[k*size + i] * x[k];
+      x[i] = sum / lower[i*size + i];
+   }
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate the weights of the fully invested minimum-variance portfolio.
+ *
+ * Without constraints the weights are w = inv(C)*1 / (1'*inv(C)*1) (Cholesky solve) and may be negative (short positions).
+ * Long-only weights are found by accelerated projected gradient descent (FISTA) on the simplex, starting from equal weights
+ * with the step size 1/(max. absolute row sum), an upper bound of the matrix' largest eigenvalue.
+ *
+ * @param  double covariance[] - covariance matrix of 'assets' rows with 'assets' columns
+ * @param  int    assets       - number of assets (max. MAX_PORTFOLIO_ASSETS)
+ * @param  BOOL   longOnly     - whether to restrict the weights to >= 0
+ * @param  double weights[]    - array receiving the weights (sum = 1)
+ *
+ * @return int - number of solver iterations (0 without constraints) or EMPTY (-1) in case of errors
+ */
+int WINAPI MinVarianceWeights(const double covariance[], int assets, BOOL longOnly, double weights[]) {
+   if (!checkCovariance(covariance, assets)) return(EMPTY);
+   if ((uint)weights < MIN_VALID_POINTER)    return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter weights = 0x%p (not a valid pointer)", weights)));
+
+   if (!longOnly) {
+      std::vector<double> lower(assets * assets);
+      double ones[MAX_PORTFOLIO_ASSETS], w[MAX_PORTFOLIO_ASSETS];
+      std::fill(ones, ones + assets, 1.);
+      if (!CholeskyDecompose(covariance, assets, &lower[0])) return(EMPTY);
+      CholeskySolve(&lower[0], assets, ones, w);
+
+      double sum = 0;
+      for (int i=0; i < assets; ++i) sum += w[i];
+      if (!(sum > 0)) return(_EMPTY(error(ERR_RUNTIME_ERROR, "invalid sum of the unscaled weights: %.8g", sum)));
+      for (int i=0; i < assets; ++i) weights[i] = w[i] / sum;
+      return(0);
+   }
+
+   double maxRowSum = 0;
+   for (int i=0; i < assets; ++i) {
+      double sum = 0;
+      for (int j=0; j < assets; ++j) sum += fabs(covariance[i*assets + j]);
+      maxRowSum = std::max(maxRowSum, sum);
+   }
+   double step = 1/maxRowSum, t = 1;
+   double w[MAX_PORTFOLIO_ASSETS], y[MAX_PORTFOLIO_ASSETS], next[MAX_PORTFOLIO_ASSETS];
+   std::fill(w, w + assets, 1./assets);
+   std::copy(w, w + assets, y);
+
+   int iterations = 0;
+   BOOL converged = FALSE;
+
+   while (iterations < MAX_SOLVER_ITERATIONS && !converged) {
+      iterations++;
+      for (int i=0; i < assets; ++i) {                               // gradient step: y - step*C*y
+         const double* row = covariance + i*assets;
+         double g = 0;
+         for (int j=0; j < assets; ++j) g += row[j] * y[j];
+         next[i] = y[i] - step * g;
+      }
+      projectToSimplex(next, assets, next);
+
+      double restart = 0;                                            // (y - next)'(next - w) > 0: the momentum points uphill
+      for (int i=0; i < assets; ++i) restart += (y[i] - next[i]) * (next[i] - w[i]);
+      if (restart > 0) t = 1;
+
+      double tNext = (1 + sqrt(1 + 4*t*t)) / 2, momentum = (t-1) / tNext, change = 0;
+      for (int i=0; i < assets; ++i) {
+         double delta = next[i] - w[i];
+         change = std::max(change, fabs(delta));
+         y[i] = next[i] + momentum * delta;
+         w[i] = next[i];
+      }
+      t = tNext;
+      converged = (change < SOLVER_TOLERANCE);
+   }
+   if (!converged) warn(ERR_RUNTIME_ERROR, "no convergence after %d iterations", iterations);
+
+   std::copy(w, w + assets, weights);
+   return(iterations);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate the weights of a risk parity (risk budgeting) portfolio, i.e. the long-only weights where each asset's risk
+ * contribution w[i]*(C*w)[i] is proportional to its risk budget. The solver uses cyclical coordinate descent on the convex
+ * function x'*C*x/2 - sum(b[i]*ln(x[i])): each coordinate update is the positive root of a quadratic equation, and C*x is
+ * updated in O(n) per coordinate. The result is scaled to a sum of 1.
+ *
+ * @param  double covariance[] - covariance matrix of 'assets' rows with 'assets' columns
+ * @param  int    assets       - number of assets (max. MAX_PORTFOLIO_ASSETS)
+ * @param  double budgets[]    - risk budgets of the assets (all > 0) or NULL for equal risk contributions
+ * @param  double weights[]    - array receiving the weights (sum = 1)
+ *
+ * @return int - number of solver iterations (sweeps over all assets) or EMPTY (-1) in case of errors
+ */
+int WINAPI RiskParityWeights(const double covariance[], int assets, const double budgets[], double weights[]) {
+   if (!checkCovariance(covariance, assets))         return(EMPTY);
+   if (budgets && (uint)budgets < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter budgets = 0x%p (not a valid pointer)", budgets)));
+   if ((uint)weights < MIN_VALID_POINTER)            return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter weights = 0x%p (not a valid pointer)", weights)));
+
+   double b[MAX_PORTFOLIO_ASSETS], x[MAX_PORTFOLIO_ASSETS], cx[MAX_PORTFOLIO_ASSETS];
+   double budgetSum = 0;
+   for (int i=0; i < assets; ++i) {
+      b[i] = budgets ? budgets[i] : 1;
+      if (!(b[i] > 0)) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid budgets[%d] = %f (must be positive)", i, b[i])));
+      budgetSum += b[i];
+   }
+   for (int i=0; i < assets; ++i) {                                  // start with inverse volatility weights
+      b[i] /= budgetSum;
+      x[i]  = b[i] / sqrt(covariance[i*assets + i]);
+   }
+   for (int i=0; i < assets; ++i) {
+      const double* row = covariance + i*assets;
+      double sum = 0;
+      for (int j=0; j < assets; ++j) sum += row[j] * x[j];
+      cx[i] = sum;
+   }
+
+   int iterations = 0;
+   BOOL converged = FALSE;
+
+   while (iterations < MAX_SOLVER_ITERATIONS && !converged) {
+      iterations++;
+      double change = 0;
+
+      for (int i=0; i < assets; ++i) {
+         const double* row = covariance + i*assets;                  // the matrix is symmetric: row i = column i
+         double cii = row[i];
+         double c   = cx[i] - cii * x[i];                            // (C*x)[i] without the own term
+         double xi  = (sqrt(c*c + 4*cii*b[i]) - c) / (2*cii);        // positive root of cii*x^2 + c*x - b = 0
+         double delta = xi - x[i];
+         if (delta) {
+            for (int j=0; j < assets; ++j) cx[j] += row[j] * delta;
+            x[i] = xi;
+            change = std::max(change, fabs(delta) / xi);
+         }
+      }
+      converged = (change < SOLVER_TOLERANCE);
+   }
+   if (!converged) warn(ERR_RUNTIME_ERROR, "no convergence after %d iterations", iterations);
+
+   double sum = 0;
+   for (int i=0; i < assets; ++i) sum += x[i];
+   for (int i=0; i < assets; ++i) weights[i] = x[i] / sum;
+   return(iterations);
+   #pragma EXPANDER_EXPORT
+}
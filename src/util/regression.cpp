@@ -0,0 +1,288 @@
+#include "expander.h"
+#include "history.h"
+#include "util/regression.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+
+/**
+ * Calculate a least-squares fit from the sums of a window. x runs from 0 (oldest value) to n-1 (newest value), so sum(x) and
+ * sum(x^2) are constants of n and the sums of y are the only state. All y are taken relative to 'origin'.
+ *
+ * @param  int        n      - number of values in the window
+ * @param  double     sumY   - sum(y - origin)
+ * @param  double     sumXY  - sum(x * (y - origin))
+ * @param  double     sumYY  - sum((y - origin)^2)
+ * @param  double     origin - offset of the values
+ * @param  LINREG_FIT fit    - struct receiving the result
+ */
+void WINAPI linRegFit(int n, double sumY, double sumXY, double sumYY, double origin, LINREG_FIT* fit) {
+   fit->count = n;
+   if (n < 2) {
+      fit->slope    = 0;
+      fit->value    = n ? origin + sumY : 0;
+      fit->stdError = 0;
+      fit->r2       = 0;
+      return;
+   }
+   double meanX = (n-1) / 2.;
+   double meanY = sumY / n;
+   double cxx   = n * ((double)n*n - 1) / 12;                        // sum((x - meanX)^2)
+   double cxy   = sumXY - meanX * sumY;                              // sum((x - meanX) * (y - meanY))
+   double cyy   = sumYY - meanY * sumY;                              // sum((y - meanY)^2)
+   double slope = cxy / cxx;
+   double sse   = std::max(cyy - slope * cxy, 0.);                   // sum of the squared residuals
+
+   fit->slope    = slope;
+   fit->value    = origin + meanY + slope * meanX;                   // the line at x = n-1
+   fit->stdError = (n > 2) ? sqrt(sse / (n-2)) : 0;
+   fit->r2       = (cyy > 0) ? 1 - sse/cyy : 0;
+}
+
+
+/**
+ * Recalculate the sums of a sliding window from the values. The origin is moved to the window's mean, which keeps the sums
+ * small and discards accumulated rounding errors.
+ *
+ * @param  LINREG_STATE* state
+ * @param  double        values[] - values in ascending time order
+ * @param  int           newest   - array index of the newest value of the window
+ */
+void WINAPI linRegRebuild(LINREG_STATE* state, const double values[], int newest) {
+   int first = std::max(0, newest - state->period + 1);
+   int count = newest - first + 1;
+
+   double origin = 0;
+   for (int i=first; i <= newest; ++i) origin += values[i];
+   origin /= count;
+
+   double sumY=0, sumXY=0, sumYY=0;
+   for (int i=first, x=0; i <= newest; ++i, ++x) {
+      double y = values[i] - origin;
+      sumY  += y;
+      sumXY += x * y;
+      sumYY += y * y;
+   }
+   state->last      = newest;
+   state->count     = count;
+   state->slides    = 0;
+   state->origin    = origin;
+   state->lastValue = values[newest];
+   state->sumY      = sumY;
+   state->sumXY     = sumXY;
+   state->sumYY     = sumYY;
+}
+
+
+/**
+ * Calculate the least-squares fits of all windows of 'period' values ending at each value of an array. The sums of each window
+ * are taken from prefix sums (one pass over the array), so a window costs O(1) independent of its length. Prefix sums over a
+ * long history lose precision when they are subtracted, so they restart with every block of 'period' values and are taken
+ * relative to the block's first value (recentering). A window covers the end of one block and the start of the next.
+ *
+ * @param  double     values[] - values in ascending time order
+ * @param  int        size     - number of values
+ * @param  int        period   - window length
+ * @param  LINREG_FIT fits[]   - array receiving the fits, one element per value; windows at the start of the array hold
+ *                               less than 'period' values (see LINREG_FIT.count)
+ */
+void WINAPI linRegBatch(const double values[], int size, int period, LINREG_FIT fits[]) {
+   if (size <= 0) return;
+
+   std::vector<double> prefix(3 * size);                             // interleaved block prefix sums of y, x*y and y^2 (inclusive)
+   std::vector<double> origins((size-1)/period + 1);                 // block origins
+   double* p = &prefix[0];
+
+   for (int i=0, x=0, block=0; i < size; ++i, ++x, p += 3) {
+      if (x == period) {
+         x = 0;
+         block++;
+      }
+      if (!x) {
+         origins[block] = values[i];
+         p[0] = p[1] = p[2] = 0;
+      }
+      else {
+         p[0] = p[-3];
+         p[1] = p[-2];
+         p[2] = p[-1];
+      }
+      double y = values[i] - origins[block];
+      p[0] += y;
+      p[1] += x * y;
+      p[2] += y * y;
+   }
+   const double* ps = &prefix[0];
+
+   for (int i=0; i < size; ++i) {
+      const double* b = ps + 3*i;
+      int block = i / period, first = std::max(0, i - period + 1);
+      double sumY, sumXY, sumYY;
+
+      if (first/period == block) {                                   // the window starts at the block start
+         sumY  = b[0];
+         sumXY = b[1];
+         sumYY = b[2];
+      }
+      else {                                                         // the window covers the end of the previous block
+         int x0 = first % period, n = period - x0;
+         const double* a   = ps + 3*(first-1);
+         const double* end = ps + 3*(block*period - 1);
+         double y  = end[0] - a[0];
+         double xy = end[1] - a[1] - x0 * y;
+         double yy = end[2] - a[2];
+         double d  = origins[block-1] - origins[block];              // move the previous block to the current origin
+
+         sumY  = y + n*d + b[0];
+         sumXY = xy + d * n*(n-1)/2 + b[1] + n * b[0];
+         sumYY = yy + 2*d*y + n*d*d + b[2];
+      }
+      linRegFit(i - first + 1, sumY, sumXY, sumYY, origins[block], &fits[i]);
+   }
+}
+
+
+/**
+ * Initialize the state of a sliding regression window.
+ *
+ * @param  LINREG_STATE* state  - state to initialize
+ * @param  int           period - window length (min. 2)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI LinReg_Init(LINREG_STATE* state, int period) {
+   if ((uint)state < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter state = 0x%p (not a valid pointer)", state));
+   if (period < 2)                      return(error(ERR_INVALID_PARAMETER, "invalid parameter period = %d (min. 2)", period));
+
+   memset(state, 0, sizeof(LINREG_STATE));
+   state->period = period;
+   state->last   = -1;
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Update a sliding regression window with the values added to an array since the last call and calculate the fit of the
+ * window ending at the array's newest value. Each new value costs O(1): it enters the running sums and the value leaving the
+ * window is taken from the array. A change of the newest value since the last call (e.g. the close of an unfinished bar) is
+ * applied as a correction. Every 'period' updates the sums are recalculated around the window's mean (recentering).
+ *
+ * The array may only grow at its end. If earlier values change the state must be reinitialized by LinReg_Init().
+ *
+ * @param  LINREG_STATE* state    - state of the window, initialized by LinReg_Init()
+ * @param  double        values[] - values in ascending time order (index 0 = oldest value)
+ * @param  int           size     - number of values
+ * @param  LINREG_FIT*   fit      - struct receiving the fit of the newest window
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI LinReg_Update(LINREG_STATE* state, const double values[], int size, LINREG_FIT* fit) {
+   if ((uint)state < MIN_VALID_POINTER)          return(error(ERR_INVALID_PARAMETER, "invalid parameter state = 0x%p (not a valid pointer)", state));
+   if (state->period < 2)                        return(error(ERR_INVALID_PARAMETER, "invalid state.period = %d (not initialized)", state->period));
+   if (size < 0)                                 return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if (size && (uint)values < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if ((uint)fit < MIN_VALID_POINTER)            return(error(ERR_INVALID_PARAMETER, "invalid parameter fit = 0x%p (not a valid pointer)", fit));
+
+   int period = state->period, newest = size-1, last = state->last;
+
+   if (!size) {
+      LinReg_Init(state, period);
+   }
+   else if (last < 0 || newest < last || newest-last >= period) {    // new, shrunk or fully replaced window
+      linRegRebuild(state, values, newest);
+   }
+   else {
+      double origin = state->origin;
+
+      if (values[last] != state->lastValue) {                        // correct a changed newest value
+         double prev = state->lastValue - origin, y = values[last] - origin;
+         state->sumY  += y - prev;
+         state->sumXY += (state->count-1) * (y - prev);
+         state->sumYY += y*y - prev*prev;
+      }
+      for (int i=last+1; i <= newest; ++i) {
+         double y = values[i] - origin;
+         if (state->count < period) {
+            state->sumXY += state->count * y;
+            state->count++;
+         }
+         else {                                                      // slide: all x decrease by 1, the oldest value leaves
+            double old = values[i-period] - origin;
+            state->sumXY += (period-1) * y - (state->sumY - old);
+            state->sumY  -= old;
+            state->sumYY -= old * old;
+            state->slides++;
+         }
+         state->sumY  += y;
+         state->sumYY += y * y;
+      }
+      state->last      = newest;
+      state->lastValue = values[newest];
+
+      if (state->slides >= period) linRegRebuild(state, values, newest);
+   }
+   linRegFit(state->count, state->sumY, state->sumXY, state->sumYY, state->origin, fit);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate the least-squares fits of a sliding window over a whole array (batch version of LinReg_Update()).
+ *
+ * @param  double     values[] - values in ascending time order (index 0 = oldest value)
+ * @param  int        size     - number of values
+ * @param  int        period   - window length (min. 2)
+ * @param  LINREG_FIT fits[]   - array receiving the fits of the windows ending at each value (same size as 'values'); the
+ *                               first period-1 windows hold less than 'period' values (see LINREG_FIT.count)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI LinReg_Array(const double values[], int size, int period, LINREG_FIT fits[]) {
+   if (size < 0)                                 return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if (size && (uint)values < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if (size && (uint)fits   < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter fits = 0x%p (not a valid pointer)", fits));
+   if (period < 2)                               return(error(ERR_INVALID_PARAMETER, "invalid parameter period = %d (min. 2)", period));
+
+   linRegBatch(values, size, period, fits);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate the least-squares fits of a sliding window over the close prices of a history span. The file is read via a file
+ * mapping (see LoadPriceSeries()).
+ *
+ * @param  char*      fileName - full name of a history file (HST, FXT or "ticks.raw")
+ * @param  char*      symbol   - symbol to read from a "ticks.raw" file (NULL: all symbols; ignored for other files)
+ * @param  datetime   from     - start time of the span (0: start of the file)
+ * @param  datetime   to       - end time of the span (0: end of the file)
+ * @param  int        period   - window length (min. 2)
+ * @param  LINREG_FIT fits[]   - array receiving the fits of the windows ending at each bar of the span
+ * @param  int        size     - size of the passed array
+ *
+ * @return int - number of bars in the span (fits are written only if the array is large enough) or EMPTY (-1) in case of
+ *               errors
+ */
+int WINAPI LinReg_History(const char* fileName, const char* symbol, datetime from, datetime to, int period, LINREG_FIT fits[], int size) {
+   if (period < 2)                             return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter period = %d (min. 2)", period)));
+   if (size < 0)                               return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+   if (size && (uint)fits < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter fits = 0x%p (not a valid pointer)", fits)));
+
+   PriceSeries prices;
+   if (!LoadPriceSeries(fileName, symbol, from, to, prices)) return(EMPTY);
+
+   int bars = prices.size();
+   if (!bars || size < bars) return(bars);
+
+   std::vector<double> closes(bars);
+   for (int i=0; i < bars; ++i) closes[i] = prices[i].close;
+
+   linRegBatch(&closes[0], bars, period, fits);
+   return(bars);
+   #pragma EXPANDER_EXPORT
+}
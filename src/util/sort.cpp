@@ -0,0 +1,305 @@
+#include "expander.h"
+#include "util/sort.h"
+
+#include <algorithm>
+#include <vector>
+
+
+/**
+ * Convert an int to an unsigned radix key with the same order.
+ */
+inline uint intKey(int value) {
+   return((uint)value ^ 0x80000000);
+}
+
+
+/**
+ * Convert a double to an unsigned radix key with the same order (IEEE-754: negative values have all bits inverted, positive
+ * values the sign bit set). -0 sorts before +0, NaNs sort to the ends.
+ */
+inline uint64 doubleKey(double value) {
+   uint64 bits = *(uint64*)&value;
+   return((bits & 0x8000000000000000ULL) ? ~bits : bits | 0x8000000000000000ULL);
+}
+
+
+/**
+ * Convert a radix key back to the double it was created from.
+ */
+inline double keyToDouble(uint64 key) {
+   uint64 bits = (key & 0x8000000000000000ULL) ? key & ~0x8000000000000000ULL : ~key;
+   return(*(double*)&bits);
+}
+
+
+/**
+ * Stable LSD radix sort of unsigned keys with 8-bit digits. The histograms of all digits are collected in a single pass and
+ * passes over digits which are equal for all keys are skipped (e.g. the high bytes of timestamps). If 'indexes' is passed the
+ * indexes are permuted together with the keys.
+ *
+ * @param  KEY  keys[]    - keys to sort
+ * @param  uint indexes[] - indexes to permute with the keys or NULL
+ * @param  uint size      - number of keys
+ */
+template <class KEY>
+void WINAPI radixSort(KEY keys[], uint indexes[], uint size) {
+   const uint DIGITS = sizeof(KEY);
+   std::vector<uint> counts(DIGITS * 256, 0);
+
+   for (uint i=0; i < size; ++i) {
+      KEY key = keys[i];
+      for (uint d=0; d < DIGITS; ++d) {
+         counts[d*256 + (uint)((key >> (d*8)) & 0xFF)]++;
+      }
+   }
+
+   std::vector<KEY>  keysTmp(size);
+   std::vector<uint> indexesTmp(indexes ? size : 0);
+   KEY*  srcKeys = keys,  *dstKeys = &keysTmp[0];
+   uint* srcIdx  = indexes, *dstIdx = indexes ? &indexesTmp[0] : NULL;
+
+   for (uint d=0; d < DIGITS; ++d) {
+      uint* count = &counts[d*256];
+      uint shift = d*8;
+      if (count[(uint)((srcKeys[0] >> shift) & 0xFF)] == size) continue;    // all keys have the same digit
+
+      uint offsets[256];                                             // exclusive prefix sums
+      for (uint b=0, sum=0; b < 256; ++b) {
+         offsets[b] = sum;
+         sum += count[b];
+      }
+      for (uint i=0; i < size; ++i) {
+         uint pos = offsets[(uint)((srcKeys[i] >> shift) & 0xFF)]++;
+         dstKeys[pos] = srcKeys[i];
+         if (srcIdx) dstIdx[pos] = srcIdx[i];
+      }
+      std::swap(srcKeys, dstKeys);
+      std::swap(srcIdx, dstIdx);
+   }
+
+   if (srcKeys != keys) {                                            // odd number of passes: copy the result back
+      memcpy(keys, srcKeys, size * sizeof(KEY));
+      if (indexes) memcpy(indexes, srcIdx, size * sizeof(uint));
+   }
+}
+
+
+/**
+ * Sort an MQL int[] or datetime[] array in ascending order (radix sort).
+ *
+ * @param  int values[] - array
+ * @param  int size     - number of elements to sort
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI SortInts(int values[], int size) {
+   if (size && (uint)values < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if (size < 0)                                 return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if (size < 2) return(TRUE);
+
+   uint* keys = (uint*)values;                                       // convert in place
+   for (int i=0; i < size; ++i) keys[i] = intKey(values[i]);
+   radixSort(keys, (uint*)NULL, size);
+   for (int i=0; i < size; ++i) keys[i] ^= 0x80000000;
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Sort an MQL double[] array in ascending order (radix sort).
+ *
+ * @param  double values[] - array
+ * @param  int    size     - number of elements to sort
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI SortDoubles(double values[], int size) {
+   if (size && (uint)values < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if (size < 0)                                 return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if (size < 2) return(TRUE);
+
+   uint64* keys = (uint64*)values;                                   // convert in place
+   for (int i=0; i < size; ++i) keys[i] = doubleKey(values[i]);
+   radixSort(keys, (uint*)NULL, size);
+   for (int i=0; i < size; ++i) values[i] = keyToDouble(keys[i]);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the permutation of indexes which sorts an MQL int[] or datetime[] array in ascending order. The sort is stable, the
+ * array is not modified.
+ *
+ * @param  int values[]  - array
+ * @param  int size      - number of elements
+ * @param  int indexes[] - array receiving the indexes (same size)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI ArgSortInts(const int values[], int size, int indexes[]) {
+   if (size && (uint)values  < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if (size && (uint)indexes < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter indexes = 0x%p (not a valid pointer)", indexes));
+   if (size < 0)                                  return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+
+   std::vector<uint> keys(size);
+   for (int i=0; i < size; ++i) {
+      keys[i]    = intKey(values[i]);
+      indexes[i] = i;
+   }
+   if (size > 1) radixSort(&keys[0], (uint*)indexes, size);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return the permutation of indexes which sorts an MQL double[] array in ascending order. The sort is stable, the array is
+ * not modified.
+ *
+ * @param  double values[]  - array
+ * @param  int    size      - number of elements
+ * @param  int    indexes[] - array receiving the indexes (same size)
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI ArgSortDoubles(const double values[], int size, int indexes[]) {
+   if (size && (uint)values  < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if (size && (uint)indexes < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter indexes = 0x%p (not a valid pointer)", indexes));
+   if (size < 0)                                  return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+
+   std::vector<uint64> keys(size);
+   for (int i=0; i < size; ++i) {
+      keys[i]    = doubleKey(values[i]);
+      indexes[i] = i;
+   }
+   if (size > 1) radixSort(&keys[0], (uint*)indexes, size);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+// comparator sorting indexes of strings (ORDER.symbol or ORDER.comment)
+struct OrderStringLess {
+   const ORDER* orders;
+   uint         offset;                                              // offset of the string field in ORDER
+   OrderStringLess(const ORDER* orders, uint offset) : orders(orders), offset(offset) {}
+   bool operator()(uint a, uint b) const { return(strcmp((const char*)&orders[a] + offset, (const char*)&orders[b] + offset) < 0); }
+};
+
+
+/**
+ * Convert the string field of all orders to ranks in alphabetical order. Equal strings get equal ranks.
+ *
+ * @param  ORDER orders[] - orders
+ * @param  uint  size     - number of orders
+ * @param  uint  offset   - offset of the string field in ORDER
+ * @param  uint  ranks[]  - array receiving the ranks
+ */
+void WINAPI rankOrderStrings(const ORDER orders[], uint size, uint offset, uint ranks[]) {
+   std::vector<uint> order(size);
+   for (uint i=0; i < size; ++i) order[i] = i;
+   std::sort(order.begin(), order.end(), OrderStringLess(orders, offset));
+
+   uint rank = 0;
+   for (uint i=0; i < size; ++i) {
+      if (i && strcmp((const char*)&orders[order[i]] + offset, (const char*)&orders[order[i-1]] + offset)) rank++;
+      ranks[order[i]] = rank;
+   }
+}
+
+
+/**
+ * Return the permutation of indexes which sorts an ORDER array by multiple keys. The keys are applied from the last to the
+ * first with stable radix passes (LSD order), so the first key is the primary one. Strings are sorted alphabetically by
+ * ranking them first. The sort is stable, the array is not modified.
+ *
+ * @param  ORDER orders[]  - array
+ * @param  int   size      - number of orders
+ * @param  int   keys[]    - sort keys (OrderSortKey, negative values sort descending)
+ * @param  int   keysSize  - number of keys
+ * @param  int   indexes[] - array receiving the indexes (same size as the orders)
+ *
+ * @return BOOL - success status
+ *
+ * @example  sort by symbol, then descending by open time: keys = {OSK_SYMBOL, -OSK_OPENTIME}
+ */
+BOOL WINAPI ArgSortOrders(const ORDER orders[], int size, const int keys[], int keysSize, int indexes[]) {
+   if (size && (uint)orders  < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter orders = 0x%p (not a valid pointer)", orders));
+   if (size && (uint)indexes < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter indexes = 0x%p (not a valid pointer)", indexes));
+   if (size < 0)                                  return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if ((uint)keys < MIN_VALID_POINTER)            return(error(ERR_INVALID_PARAMETER, "invalid parameter keys = 0x%p (not a valid pointer)", keys));
+   if (keysSize <= 0)                             return(error(ERR_INVALID_PARAMETER, "invalid parameter keysSize = %d", keysSize));
+   for (int k=0; k < keysSize; ++k) {
+      int key = abs(keys[k]);
+      if (key < OSK_TICKET || key > OSK_COMMENT)  return(error(ERR_INVALID_PARAMETER, "invalid parameter keys[%d] = %d (not an OrderSortKey)", k, keys[k]));
+   }
+   for (int i=0; i < size; ++i) indexes[i] = i;
+   if (size < 2) return(TRUE);
+
+   std::vector<uint>   keys32(size), ranks;
+   std::vector<uint64> keys64;
+   uint* perm = (uint*)indexes;                                      // current permutation
+
+   for (int k=keysSize-1; k >= 0; --k) {
+      OrderSortKey key = (OrderSortKey)abs(keys[k]);
+      BOOL descending = (keys[k] < 0);
+
+      if (key==OSK_LOTS || key==OSK_OPENPRICE || key==OSK_CLOSEPRICE || key==OSK_PROFIT) {
+         keys64.resize(size);
+         for (int i=0; i < size; ++i) {
+            const ORDER& order = orders[perm[i]];
+            double value = (key==OSK_LOTS) ? order.lots : (key==OSK_OPENPRICE) ? order.openPrice : (key==OSK_CLOSEPRICE) ? order.closePrice : order.profit + order.swap + order.commission;
+            keys64[i] = descending ? ~doubleKey(value) : doubleKey(value);
+         }
+         radixSort(&keys64[0], perm, size);
+         continue;
+      }
+
+      if (key==OSK_SYMBOL || key==OSK_COMMENT) {
+         if (ranks.empty()) ranks.resize(size);
+         rankOrderStrings(orders, size, (key==OSK_SYMBOL) ? offsetof(ORDER, symbol) : offsetof(ORDER, comment), &ranks[0]);
+      }
+      for (int i=0; i < size; ++i) {
+         const ORDER& order = orders[perm[i]];
+         uint value;
+         switch (key) {
+            case OSK_TICKET:      value = intKey(order.ticket);      break;
+            case OSK_TYPE:        value = intKey(order.type);        break;
+            case OSK_OPENTIME:    value = intKey(order.openTime);    break;
+            case OSK_CLOSETIME:   value = intKey(order.closeTime);   break;
+            case OSK_MAGICNUMBER: value = intKey(order.magicNumber); break;
+            default:              value = ranks[perm[i]];            // OSK_SYMBOL, OSK_COMMENT
+         }
+         keys32[i] = descending ? ~value : value;
+      }
+      radixSort(&keys32[0], perm, size);
+   }
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Sort an ORDER array by multiple keys. The sort is stable. See ArgSortOrders() for the keys.
+ *
+ * @param  ORDER orders[] - array
+ * @param  int   size     - number of orders
+ * @param  int   keys[]   - sort keys (OrderSortKey, negative values sort descending)
+ * @param  int   keysSize - number of keys
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI SortOrders(ORDER orders[], int size, const int keys[], int keysSize) {
+   std::vector<int> indexes(size > 0 ? size : 1);
+   if (!ArgSortOrders(orders, size, keys, keysSize, &indexes[0])) return(FALSE);
+
+   std::vector<ORDER> sorted(size);
+   for (int i=0; i < size; ++i) {
+      sorted[i] = orders[indexes[i]];
+   }
+   if (size) memcpy(orders, &sorted[0], size * sizeof(ORDER));
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
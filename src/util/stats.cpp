@@ -0,0 +1,266 @@
+#include "expander.h"
+#include "util/stats.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+#include <math.h>
+#include <vector>
+
+
+// per-lane accumulators of calculateStats()
+struct STATS_LANES {
+   __m128d count;
+   __m128d sum;                                                      // sum of the shifted values
+   __m128d sumSq;                                                    // sum of the squared shifted values
+   __m128d min, minIndex;
+   __m128d max, maxIndex;
+};
+
+
+/**
+ * Add two values to a set of lane accumulators. A new minimum or maximum is rare after the first values, so the indexes are
+ * updated only if a lane's extreme changes.
+ *
+ * @param  STATS_LANES& lanes
+ * @param  __m128d      v     - values
+ * @param  __m128d      valid - mask of the values to add
+ * @param  __m128d      index - array indexes of the values
+ * @param  __m128d      shift - shift subtracted from the values (the first evaluated value)
+ */
+inline void accumulateStats(STATS_LANES& lanes, __m128d v, __m128d valid, __m128d index, __m128d shift) {
+   v = _mm_or_pd(_mm_and_pd(valid, v), _mm_andnot_pd(valid, shift)); // invalid values become the shift which changes nothing
+   __m128d d = _mm_sub_pd(v, shift);
+   lanes.count = _mm_add_pd(lanes.count, _mm_and_pd(valid, _mm_set1_pd(1)));
+   lanes.sum   = _mm_add_pd(lanes.sum, d);
+   lanes.sumSq = _mm_add_pd(lanes.sumSq, _mm_mul_pd(d, d));
+
+   __m128d isLess = _mm_cmplt_pd(v, lanes.min);                      // strict comparison keeps the lowest index per lane
+   if (_mm_movemask_pd(isLess)) {
+      lanes.min      = _mm_min_pd(v, lanes.min);
+      lanes.minIndex = _mm_or_pd(_mm_and_pd(isLess, index), _mm_andnot_pd(isLess, lanes.minIndex));
+   }
+   __m128d isGreater = _mm_cmpgt_pd(v, lanes.max);
+   if (_mm_movemask_pd(isGreater)) {
+      lanes.max      = _mm_max_pd(v, lanes.max);
+      lanes.maxIndex = _mm_or_pd(_mm_and_pd(isGreater, index), _mm_andnot_pd(isGreater, lanes.maxIndex));
+   }
+}
+
+
+/**
+ * Calculate count, sum, variance, minimum and maximum of an array in a single pass. Two values are processed per SSE2
+ * instruction. A single set of accumulators is used as a second set doesn't fit into the 8 XMM registers of the 32-bit
+ * target and is slower. The variance is calculated from sums of the values shifted by the first evaluated value, which
+ * avoids the cancellation of the naive sum-of-squares formula for values far away from zero (e.g. prices).
+ *
+ * @param  double       values[]   - values
+ * @param  int          size       - number of values
+ * @param  BOOL         skipEmpty  - whether to skip values equal to 'emptyValue'
+ * @param  double       emptyValue - value marking an empty element
+ * @param  ARRAY_STATS* stats      - struct receiving the results
+ */
+void WINAPI calculateStats(const double values[], int size, BOOL skipEmpty, double emptyValue, ARRAY_STATS* stats) {
+   memset(stats, 0, sizeof(ARRAY_STATS));
+   stats->minIndex = stats->maxIndex = EMPTY;
+
+   int first = 0;                                                    // the first evaluated value is the shift
+   if (skipEmpty) while (first < size && values[first]==emptyValue) first++;
+   if (first >= size) return;
+   double shift = values[first];
+
+   __m128d vShift = _mm_set1_pd(shift), vEmpty = _mm_set1_pd(emptyValue), vAll = _mm_cmpeq_pd(vShift, vShift);
+   STATS_LANES lanes = {};
+   lanes.min      = lanes.max      = vShift;                         // both lanes start with the first value
+   lanes.minIndex = lanes.maxIndex = _mm_set1_pd(first);
+   __m128d index  = _mm_set_pd(first+1, first), vTwo = _mm_set1_pd(2);
+   int i = first;
+
+   for (; i+2 <= size; i += 2) {
+      __m128d v = _mm_loadu_pd(&values[i]);
+      accumulateStats(lanes, v, skipEmpty ? _mm_cmpneq_pd(v, vEmpty) : vAll, index, vShift);
+      index = _mm_add_pd(index, vTwo);
+   }
+
+   __declspec(align(16)) double count[2], sum[2], sumSq[2], min[2], max[2], minIndex[2], maxIndex[2];
+   _mm_store_pd(count, lanes.count);                                 // combine the lanes
+   _mm_store_pd(sum,   lanes.sum);
+   _mm_store_pd(sumSq, lanes.sumSq);
+   _mm_store_pd(min,   lanes.min); _mm_store_pd(minIndex, lanes.minIndex);
+   _mm_store_pd(max,   lanes.max); _mm_store_pd(maxIndex, lanes.maxIndex);
+
+   double n = count[0] + count[1], sumD = sum[0] + sum[1], sumSqD = sumSq[0] + sumSq[1];
+   double minD = min[0], maxD = max[0];
+   int    iMin = (int)minIndex[0], iMax = (int)maxIndex[0];
+   if (min[1] < minD || (min[1]==minD && minIndex[1] < iMin)) { minD = min[1]; iMin = (int)minIndex[1]; }
+   if (max[1] > maxD || (max[1]==maxD && maxIndex[1] < iMax)) { maxD = max[1]; iMax = (int)maxIndex[1]; }
+
+   if (i < size) {                                                   // remaining value
+      double v = values[i];
+      if (!skipEmpty || v!=emptyValue) {
+         double d = v - shift;
+         n++;
+         sumD   += d;
+         sumSqD += d*d;
+         if (v < minD) { minD = v; iMin = i; }
+         if (v > maxD) { maxD = v; iMax = i; }
+      }
+   }
+
+   double mean     = sumD/n;                                         // mean of the shifted values
+   stats->count    = (int)n;
+   stats->sum      = sumD + shift*n;
+   stats->mean     = mean + shift;
+   stats->variance = std::max(sumSqD/n - mean*mean, 0.);
+   stats->stdDev   = sqrt(stats->variance);
+   stats->min      = minD;
+   stats->max      = maxD;
+   stats->minIndex = iMin;
+   stats->maxIndex = iMax;
+}
+
+
+/**
+ * Calculate descriptive statistics of an MQL double[] array in a single pass (count, sum, mean, variance, standard deviation,
+ * minimum and maximum with their indexes). Replaces MQL loops and ArrayMinimum()/ArrayMaximum() calls over large arrays.
+ *
+ * @param  double       values[] - MQL double array (e.g. an indicator buffer)
+ * @param  int          size     - number of values to evaluate
+ * @param  ARRAY_STATS* stats    - struct receiving the results
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CalculateStats(const double values[], int size, ARRAY_STATS* stats) {
+   if (size && (uint)values < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if (size < 0)                                 return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if ((uint)stats < MIN_VALID_POINTER)          return(error(ERR_INVALID_PARAMETER, "invalid parameter stats = 0x%p (not a valid pointer)", stats));
+
+   calculateStats(values, size, FALSE, 0, stats);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate descriptive statistics of an MQL double[] array ignoring empty elements (e.g. EMPTY_VALUE in indicator buffers).
+ *
+ * @param  double       values[]   - MQL double array (e.g. an indicator buffer)
+ * @param  int          size       - number of values to evaluate
+ * @param  double       emptyValue - value of empty elements to skip
+ * @param  ARRAY_STATS* stats      - struct receiving the results
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CalculateStatsEx(const double values[], int size, double emptyValue, ARRAY_STATS* stats) {
+   if (size && (uint)values < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if (size < 0)                                 return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if ((uint)stats < MIN_VALID_POINTER)          return(error(ERR_INVALID_PARAMETER, "invalid parameter stats = 0x%p (not a valid pointer)", stats));
+
+   calculateStats(values, size, TRUE, emptyValue, stats);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate percentiles by selection instead of sorting. The values are copied once, each percentile then costs a linear
+ * partial partitioning of the part of the copy above the previous (lower) percentile. Percentiles are interpolated linearly
+ * between the closest ranks (rank = percent/100 * (n-1)).
+ *
+ * @param  double values[]   - values
+ * @param  int    size       - number of values
+ * @param  BOOL   skipEmpty  - whether to skip values equal to 'emptyValue'
+ * @param  double emptyValue - value marking an empty element
+ * @param  double percents[] - percentiles to calculate (0...100)
+ * @param  int    count      - number of percentiles
+ * @param  double results[]  - array receiving the percentiles in the order of 'percents' (0 if there are no values)
+ */
+void WINAPI calculatePercentiles(const double values[], int size, BOOL skipEmpty, double emptyValue, const double percents[], int count, double results[]) {
+   std::vector<double> data;
+   data.reserve(size);
+   for (int i=0; i < size; ++i) {
+      if (!skipEmpty || values[i]!=emptyValue) data.push_back(values[i]);
+   }
+   int n = data.size();
+   if (!n) {
+      std::fill(results, results+count, 0.);
+      return;
+   }
+
+   std::vector<std::pair<double, int> > order(count);                // process percentiles in ascending order
+   for (int i=0; i < count; ++i) {
+      order[i] = std::make_pair(percents[i], i);
+   }
+   std::sort(order.begin(), order.end());
+
+   std::vector<double>::iterator begin = data.begin();               // everything before 'begin' is <= the last selected value
+   int selected = -1;
+   for (int i=0; i < count; ++i) {
+      double rank = order[i].first/100 * (n-1);
+      int    lo   = (int)rank;
+      double frac = rank - lo;
+
+      if (lo != selected) {
+         std::nth_element(begin, data.begin()+lo, data.end());
+         begin    = data.begin()+lo+1;
+         selected = lo;
+      }
+      double value = data[lo];
+      if (frac > 0 && lo+1 < n)
+         value += frac * (*std::min_element(data.begin()+lo+1, data.end()) - value);
+      results[order[i].second] = value;
+   }
+}
+
+
+/**
+ * Calculate percentiles of an MQL double[] array (e.g. the median with percent 50). Multiple percentiles are calculated in
+ * a single call, see calculatePercentiles().
+ *
+ * @param  double values[]   - MQL double array
+ * @param  int    size       - number of values to evaluate
+ * @param  double percents[] - percentiles to calculate (0...100)
+ * @param  int    count      - number of percentiles
+ * @param  double results[]  - array receiving the percentiles (same order as 'percents')
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CalculatePercentiles(const double values[], int size, const double percents[], int count, double results[]) {
+   if (size && (uint)values < MIN_VALID_POINTER)    return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if (size < 0)                                    return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if (count && (uint)percents < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter percents = 0x%p (not a valid pointer)", percents));
+   if (count && (uint)results  < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter results = 0x%p (not a valid pointer)", results));
+   if (count < 0)                                   return(error(ERR_INVALID_PARAMETER, "invalid parameter count = %d", count));
+   for (int i=0; i < count; ++i) {
+      if (!(percents[i]>=0 && percents[i]<=100))   return(error(ERR_INVALID_PARAMETER, "invalid parameter percents[%d] = %f (must be 0...100)", i, percents[i]));
+   }
+   calculatePercentiles(values, size, FALSE, 0, percents, count, results);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Calculate percentiles of an MQL double[] array ignoring empty elements (e.g. EMPTY_VALUE in indicator buffers).
+ *
+ * @param  double values[]   - MQL double array
+ * @param  int    size       - number of values to evaluate
+ * @param  double emptyValue - value of empty elements to skip
+ * @param  double percents[] - percentiles to calculate (0...100)
+ * @param  int    count      - number of percentiles
+ * @param  double results[]  - array receiving the percentiles (same order as 'percents')
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI CalculatePercentilesEx(const double values[], int size, double emptyValue, const double percents[], int count, double results[]) {
+   if (size && (uint)values < MIN_VALID_POINTER)    return(error(ERR_INVALID_PARAMETER, "invalid parameter values = 0x%p (not a valid pointer)", values));
+   if (size < 0)                                    return(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size));
+   if (count && (uint)percents < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter percents = 0x%p (not a valid pointer)", percents));
+   if (count && (uint)results  < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter results = 0x%p (not a valid pointer)", results));
+   if (count < 0)                                   return(error(ERR_INVALID_PARAMETER, "invalid parameter count = %d", count));
+   for (int i=0; i < count; ++i) {
+      if (!(percents[i]>=0 && percents[i]<=100))   return(error(ERR_INVALID_PARAMETER, "invalid parameter percents[%d] = %f (must be 0...100)", i, percents[i]));
+   }
+   calculatePercentiles(values, size, TRUE, emptyValue, percents, count, results);
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
+}
@@ -1,5 +1,152 @@
 #include "expander.h"
 #include "struct/mt4/MqlStr.h"
+#include "util/string.h"
+
+#include <emmintrin.h>
+#include <intrin.h>
+#include <vector>
+
+
+/**
+ * Return the index of the lowest set bit of a non-zero value.
+ *
+ * @param  uint value
+ *
+ * @return uint
+ */
+inline uint ctz(uint value) {
+   DWORD index;
+   _BitScanForward(&index, value);
+   return(index);
+}
+
+
+/**
+ * Convert an upper case ASCII letter to lower case. Other characters are not modified (same as simdToLower()).
+ *
+ * @param  char c
+ *
+ * @return char
+ */
+inline char asciiToLower(char c) {
+   return((c >= 'A' && c <= 'Z') ? c|0x20 : c);
+}
+
+
+/**
+ * Convert the upper case ASCII letters of 16 bytes to lower case. Other bytes are not modified.
+ *
+ * @param  __m128i v
+ *
+ * @return __m128i
+ */
+inline __m128i simdToLower(__m128i v) {
+   __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A'-1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z'+1)));
+   return(_mm_or_si128(v, _mm_and_si128(isUpper, _mm_set1_epi8(0x20))));
+}
+
+
+/**
+ * Return the length of a C string. The string is scanned 16 bytes at a time with aligned loads which never cross a page
+ * boundary, so bytes after the terminating null character are read but never beyond the page holding it.
+ *
+ * @param  char* s
+ *
+ * @return size_t
+ */
+size_t WINAPI simdStrLen(const char* s) {
+   const char* block = (const char*)((uint)s & ~15);                 // align down to 16 bytes
+   __m128i zero = _mm_setzero_si128();
+   uint mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)block), zero)) >> (s-block);
+
+   while (!mask) {
+      block += 16;
+      mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)block), zero));
+      if (mask) return(block - s + ctz(mask));
+   }
+   return(ctz(mask));
+}
+
+
+/**
+ * Whether two byte ranges of the same length are equal.
+ *
+ * @param  char*  a
+ * @param  char*  b
+ * @param  size_t len        - length of both ranges
+ * @param  BOOL   ignoreCase - whether to ignore the case of ASCII letters
+ *
+ * @return BOOL
+ */
+BOOL WINAPI simdEquals(const char* a, const char* b, size_t len, BOOL ignoreCase) {
+   size_t i = 0;
+   if (ignoreCase) {
+      for (; i+16 <= len; i += 16) {
+         __m128i va = simdToLower(_mm_loadu_si128((const __m128i*)(a+i)));
+         __m128i vb = simdToLower(_mm_loadu_si128((const __m128i*)(b+i)));
+         if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF) return(FALSE);
+      }
+      for (; i < len; ++i) {
+         if (a[i]!=b[i] && asciiToLower(a[i])!=asciiToLower(b[i])) return(FALSE);
+      }
+   }
+   else {
+      for (; i+16 <= len; i += 16) {
+         __m128i va = _mm_loadu_si128((const __m128i*)(a+i));
+         __m128i vb = _mm_loadu_si128((const __m128i*)(b+i));
+         if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF) return(FALSE);
+      }
+      for (; i < len; ++i) {
+         if (a[i] != b[i]) return(FALSE);
+      }
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Find the first occurrence of a substring in a string of known length. Candidate positions are found 16 at a time by
+ * comparing the first and the last character of the substring, only candidates are verified byte by byte.
+ *
+ * @param  char*  str        - string
+ * @param  size_t strLen     - length of the string
+ * @param  char*  substr     - substring to find
+ * @param  size_t subLen     - length of the substring (greater than zero)
+ * @param  size_t start      - offset in the string to start searching at
+ * @param  BOOL   ignoreCase - whether to ignore the case of ASCII letters
+ *
+ * @return int - offset of the substring or EMPTY (-1) if the substring was not found
+ */
+int WINAPI simdFind(const char* str, size_t strLen, const char* substr, size_t subLen, size_t start, BOOL ignoreCase) {
+   if (start+subLen > strLen) return(EMPTY);
+   size_t last = strLen - subLen;                                    // last possible match position
+
+   char firstChar = ignoreCase ? asciiToLower(substr[0])        : substr[0];
+   char lastChar  = ignoreCase ? asciiToLower(substr[subLen-1]) : substr[subLen-1];
+   __m128i vFirst = _mm_set1_epi8(firstChar);
+   __m128i vLast  = _mm_set1_epi8(lastChar);
+   size_t i = start;
+
+   for (; i+15 <= last; i += 16) {                                   // all 16 candidates and their last bytes are in range
+      __m128i blockFirst = _mm_loadu_si128((const __m128i*)(str+i));
+      __m128i blockLast  = _mm_loadu_si128((const __m128i*)(str+i+subLen-1));
+      if (ignoreCase) {
+         blockFirst = simdToLower(blockFirst);
+         blockLast  = simdToLower(blockLast);
+      }
+      uint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, vFirst), _mm_cmpeq_epi8(blockLast, vLast)));
+      while (mask) {
+         uint bit = ctz(mask);
+         if (subLen <= 2 || simdEquals(str+i+bit+1, substr+1, subLen-2, ignoreCase))
+            return(i + bit);
+         mask &= mask-1;
+      }
+   }
+   for (; i <= last; ++i) {                                          // remaining candidates
+      if (simdEquals(str+i, substr, subLen, ignoreCase)) return(i);
+   }
+   return(EMPTY);
+}
 
 
 /**
@@ -73,7 +220,27 @@ BOOL WINAPI StringIsNull(const char* value) {
 BOOL WINAPI StringCompare(const char* s1, const char* s2) {
    if ( s1 ==  s2) return(TRUE);                                     // if pointers are equal values are too
    if (!s1 || !s2) return(FALSE);                                    // if one is a NULL pointer the other can't
-   return(strcmp(s1, s2) == 0);                                      // both are not NULL pointers
+
+   size_t len = simdStrLen(s1);                                      // both are not NULL pointers
+   return(len==simdStrLen(s2) && simdEquals(s1, s2, len, FALSE));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Whether or not two strings are considered equal, ignoring the case of ASCII letters.
+ *
+ * @param  char* s1
+ * @param  char* s2
+ *
+ * @return BOOL
+ */
+BOOL WINAPI StringCompareI(const char* s1, const char* s2) {
+   if ( s1 ==  s2) return(TRUE);
+   if (!s1 || !s2) return(FALSE);
+
+   size_t len = simdStrLen(s1);
+   return(len==simdStrLen(s2) && simdEquals(s1, s2, len, TRUE));
    #pragma EXPANDER_EXPORT
 }
 
@@ -90,12 +257,137 @@ BOOL WINAPI StringEndsWith(const char* str, const char* suffix) {
    if (!str)    return(FALSE);
    if (!suffix) return(warn(ERR_INVALID_PARAMETER, "invalid parameter suffix=%s", suffix));
 
-   size_t strLen    = strlen(str);
-   size_t suffixLen = strlen(suffix);
+   size_t strLen    = simdStrLen(str);
+   size_t suffixLen = simdStrLen(suffix);
    if (!suffixLen) return(warn(ERR_INVALID_PARAMETER, "illegal parameter suffix=\"\""));
 
    if (strLen >= suffixLen)
-      return(strncmp(str + strLen - suffixLen, suffix, suffixLen) == 0);
+      return(simdEquals(str + strLen - suffixLen, suffix, suffixLen, FALSE));
    return(FALSE);
    #pragma EXPANDER_EXPORT
 }
+
+
+/**
+ * Find the first occurrence of a substring in a string. A replacement of MQL::StringFind() for large strings.
+ *
+ * @param  char* str        - string to search in
+ * @param  char* substr     - substring to search for
+ * @param  int   start      - offset in the string to start searching at
+ * @param  BOOL  ignoreCase - whether to ignore the case of ASCII letters
+ *
+ * @return int - offset of the first occurrence, EMPTY (-1) if the substring was not found or in case of errors
+ */
+int WINAPI StringFindEx(const char* str, const char* substr, int start, BOOL ignoreCase) {
+   if ((uint)str    < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter str = 0x%p (not a valid pointer)", str)));
+   if ((uint)substr < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter substr = 0x%p (not a valid pointer)", substr)));
+   if (!*substr)                         return(_EMPTY(error(ERR_INVALID_PARAMETER, "illegal parameter substr = \"\"")));
+   if (start < 0)                        return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter start = %d (must be non-negative)", start)));
+
+   return(simdFind(str, simdStrLen(str), substr, simdStrLen(substr), start, ignoreCase));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Count the non-overlapping occurrences of a substring in a string.
+ *
+ * @param  char* str        - string to search in
+ * @param  char* substr     - substring to count
+ * @param  BOOL  ignoreCase - whether to ignore the case of ASCII letters
+ *
+ * @return int - number of occurrences or EMPTY (-1) in case of errors
+ */
+int WINAPI StringCount(const char* str, const char* substr, BOOL ignoreCase) {
+   if ((uint)str    < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter str = 0x%p (not a valid pointer)", str)));
+   if ((uint)substr < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter substr = 0x%p (not a valid pointer)", substr)));
+   if (!*substr)                         return(_EMPTY(error(ERR_INVALID_PARAMETER, "illegal parameter substr = \"\"")));
+
+   size_t strLen = simdStrLen(str), subLen = simdStrLen(substr);
+   int count = 0;
+   for (int pos=simdFind(str, strLen, substr, subLen, 0, ignoreCase); pos != EMPTY; pos=simdFind(str, strLen, substr, subLen, pos+subLen, ignoreCase)) {
+      count++;
+   }
+   return(count);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Replace all non-overlapping occurrences of a substring in a string and copy the result to a buffer. A replacement of
+ * MQL::StringReplace() for large strings.
+ *
+ * @param  char* str        - source string
+ * @param  char* search     - substring to replace
+ * @param  char* replace    - replacement (may be empty)
+ * @param  BOOL  ignoreCase - whether to ignore the case of ASCII letters when searching
+ * @param  char* buffer     - buffer receiving the result
+ * @param  int   bufferSize - size of the buffer (the result is copied only if the buffer is large enough)
+ *
+ * @return int - length of the result (without the terminating null character) or EMPTY (-1) in case of errors
+ */
+int WINAPI StringReplaceAll(const char* str, const char* search, const char* replace, BOOL ignoreCase, char* buffer, int bufferSize) {
+   if ((uint)str     < MIN_VALID_POINTER)               return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter str = 0x%p (not a valid pointer)", str)));
+   if ((uint)search  < MIN_VALID_POINTER)               return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter search = 0x%p (not a valid pointer)", search)));
+   if (!*search)                                        return(_EMPTY(error(ERR_INVALID_PARAMETER, "illegal parameter search = \"\"")));
+   if ((uint)replace < MIN_VALID_POINTER)               return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter replace = 0x%p (not a valid pointer)", replace)));
+   if (bufferSize && (uint)buffer < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter buffer = 0x%p (not a valid pointer)", buffer)));
+
+   size_t strLen = simdStrLen(str), searchLen = simdStrLen(search), replaceLen = simdStrLen(replace);
+
+   std::vector<int> matches;                                         // first pass: find all occurrences
+   for (int pos=simdFind(str, strLen, search, searchLen, 0, ignoreCase); pos != EMPTY; pos=simdFind(str, strLen, search, searchLen, pos+searchLen, ignoreCase)) {
+      matches.push_back(pos);
+   }
+   int length = strLen + matches.size() * (replaceLen - searchLen);
+   if (bufferSize <= length) return(length);
+
+   char* dest = buffer;                                              // second pass: copy segments and replacements
+   size_t from = 0;
+   for (size_t i=0; i < matches.size(); ++i) {
+      memcpy(dest, str+from, matches[i]-from); dest += matches[i]-from;
+      memcpy(dest, replace, replaceLen);       dest += replaceLen;
+      from = matches[i] + searchLen;
+   }
+   memcpy(dest, str+from, strLen-from+1);                            // including the terminating null character
+   return(length);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Split a string at a separator and return the offsets of the resulting fields. Each field is described by two integers:
+ * its start offset and its length. E.g. for parsing a CSV line with MQL::StringSubstr() without creating intermediate strings.
+ * The offsets of as many fields as fit into the array are copied, remaining fields are only counted. If the returned number of
+ * fields exceeds size/2 the array was too small and the call can be repeated with a larger array.
+ *
+ * @param  char* str       - string to split
+ * @param  char* separator - field separator
+ * @param  int   offsets[] - array receiving the start offset and the length of each field
+ * @param  int   size      - size of the array (two elements per field)
+ *
+ * @return int - number of fields or EMPTY (-1) in case of errors
+ */
+int WINAPI StringSplitOffsets(const char* str, const char* separator, int offsets[], int size) {
+   if ((uint)str       < MIN_VALID_POINTER)       return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter str = 0x%p (not a valid pointer)", str)));
+   if ((uint)separator < MIN_VALID_POINTER)       return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter separator = 0x%p (not a valid pointer)", separator)));
+   if (!*separator)                               return(_EMPTY(error(ERR_INVALID_PARAMETER, "illegal parameter separator = \"\"")));
+   if (size && (uint)offsets < MIN_VALID_POINTER) return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter offsets = 0x%p (not a valid pointer)", offsets)));
+   if (size < 0)                                  return(_EMPTY(error(ERR_INVALID_PARAMETER, "invalid parameter size = %d", size)));
+
+   size_t strLen = simdStrLen(str), sepLen = simdStrLen(separator);
+   int fields=0, from=0;
+
+   for (int pos=simdFind(str, strLen, separator, sepLen, 0, FALSE);; pos=simdFind(str, strLen, separator, sepLen, from, FALSE)) {
+      int end = (pos == EMPTY) ? strLen : pos;
+      if (2*fields+1 < size) {
+         offsets[2*fields]   = from;
+         offsets[2*fields+1] = end - from;
+      }
+      fields++;
+      if (pos == EMPTY) break;
+      from = pos + sepLen;
+   }
+   return(fields);
+   #pragma EXPANDER_EXPORT
+}
@@ -1,6 +1,10 @@
 #include "expander.h"
 #include "util/helper.h"
+#include "util/ticktimer.h"
 
+#include <intrin.h>
+#include <math.h>
+#include <mmsystem.h>
 #include <vector>
 
 
@@ -14,6 +18,82 @@ struct TICK_TIMER_DATA {
    DWORD userdata3;
 };
 std::vector<TICK_TIMER_DATA> tickTimers;                             // Daten aller aktiven TickTimer
+volatile LONG                lastTickTimerId = 10000;             // ID's sind mindestens 5-stellig und beginnen bei 10001
+
+
+extern CRITICAL_SECTION g_terminalLock;                              // application wide lock
+
+
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION  0x00000002            // Windows 10 1803 and later
+
+
+// a tick timer of the high-resolution timer thread
+struct HIGHRES_TICK_TIMER {
+   uint          id;
+   HWND          hWnd;
+   DWORD         flags;
+   uint          millis;
+   uint64        period;                                             // period in QPC ticks
+   uint64        due;                                                // QPC time of the next tick
+   volatile BOOL removed;                                            // set by RemoveTickTimer(), released by the timer thread
+   uint          ticks;
+   uint          missed;
+   double        sumJitter;                                          // in microseconds
+   double        sumSqJitter;
+   double        maxJitter;
+   uint          jitters[TICK_JITTER_BUCKETS];
+};
+
+
+// High-resolution timers are served by a single thread waiting on a waitable timer. Ticks are scheduled at absolute QPC times
+// (start + n * period), so wake-up delays don't accumulate. The thread works on a copy of the timer list which it refreshes
+// when signaled. It never holds g_terminalLock while it waits or sends ticks. The thread runs only while timers are installed
+// and holds a reference to the DLL, so the DLL stays loaded until the last timer was removed.
+std::vector<HIGHRES_TICK_TIMER*> highResTimers;                      // guarded by g_terminalLock
+volatile LONG                    highResTimersChanged;               // whether the thread must refresh its copy of the list
+HANDLE                           hHighResThread;                     // the current or last timer thread
+HANDLE                           hHighResWakeup;                     // auto-reset event waking the timer thread
+HANDLE                           hHighResTimer;                      // waitable timer of the thread
+BOOL                             highResTimerPeriod;                 // whether the thread raises the system timer resolution
+uint64                           qpcFrequency;                       // QPC ticks per second
+BOOL                             highResActive;                      // whether a timer thread runs and serves new timers
+
+
+/**
+ * Send a synthetic tick to a chart window as configured by the flags of a timer. Called by TimerCallback() and by the
+ * high-resolution timer thread.
+ *
+ * @param  HWND  hWnd  - chart window
+ * @param  DWORD flags - tick flags of the timer
+ */
+void WINAPI sendTick(HWND hWnd, DWORD flags) {
+   if (flags & TICK_IF_VISIBLE) {
+      RECT rect;                                   // check if chart is (partially) visible
+      HDC hDC = GetDC(hWnd);
+      int rgn = GetClipBox(hDC, &rect);
+      ReleaseDC(hWnd, hDC);
+
+      if (rgn == NULLREGION)                       // skip timer event if chart is not visible
+         return;
+      if (rgn == RGN_ERROR) {
+         warn(ERR_WIN32_ERROR+GetLastError(), "GetClipBox(hDC=%p) => RGN_ERROR", hDC);
+         return;
+      }
+   }
+   if (flags & TICK_PAUSE_ON_WEEKEND) {
+      // skip timer event if on weekend: not yet implemented
+   }
+
+   if (flags & TICK_CHART_REFRESH) {
+      PostMessageA(hWnd, WM_COMMAND, ID_CHART_REFRESH, 0);
+   }
+   else if (flags & TICK_TESTER) {
+      PostMessageA(hWnd, WM_COMMAND, ID_CHART_STEPFORWARD, 0);
+   }
+   else {
+      PostMessageA(hWnd, MT4InternalMsg(), MT4_TICK, TICK_OFFLINE_EA);  // default tick
+   }
+}
 
 
 /**
@@ -30,34 +110,7 @@ VOID CALLBACK TimerCallback(HWND hWnd, UINT msg, UINT_PTR timerId, DWORD time) {
 
    for (int i=0; i < size; i++) {
       if (tickTimers[i].id == timerId) {
-         TICK_TIMER_DATA& ttd = tickTimers[i];
-
-         if (ttd.flags & TICK_IF_VISIBLE) {
-            RECT rect;                                   // check if chart is (partially) visible
-            HDC hDC = GetDC(hWnd);
-            int rgn = GetClipBox(hDC, &rect);
-            ReleaseDC(hWnd, hDC);
-
-            if (rgn == NULLREGION)                       // skip timer event if chart is not visible
-               return;
-            if (rgn == RGN_ERROR) {
-               warn(ERR_WIN32_ERROR+GetLastError(), "GetClipBox(hDC=%p) => RGN_ERROR", hDC);
-               return;
-            }
-         }
-         if (ttd.flags & TICK_PAUSE_ON_WEEKEND) {
-            // skip timer event if on weekend: not yet implemented
-         }
-
-         if (ttd.flags & TICK_CHART_REFRESH) {
-            PostMessageA(hWnd, WM_COMMAND, ID_CHART_REFRESH, 0);
-         }
-         else if (ttd.flags & TICK_TESTER) {
-            PostMessageA(hWnd, WM_COMMAND, ID_CHART_STEPFORWARD, 0);
-         }
-         else {
-            PostMessageA(hWnd, MT4InternalMsg(), MT4_TICK, TICK_OFFLINE_EA);  // default tick
-         }
+         sendTick(hWnd, tickTimers[i].flags);
          return;
       }
    }
@@ -93,28 +146,224 @@ uint WINAPI SetupTickTimer(HWND hWnd, int millis, DWORD flags/*=NULL*/) {
    if (flags & TICK_PAUSE_ON_WEEKEND)                     warn(ERR_NOT_IMPLEMENTED, "flag TICK_PAUSE_ON_WEEKEND not yet implemented");
 
    // neue Timer-ID erzeugen
-   static uint s_timerId = 10000;                     // ID's sind mindestens 5-stellig und beginnen bei 10000
-   s_timerId++;
+   uint timerId = InterlockedIncrement(&lastTickTimerId);
 
    // Timer setzen
-   uint result = SetTimer(hWnd, s_timerId, millis, (TIMERPROC)TimerCallback);
-   if (result != s_timerId)                           // mu stimmen, da hWnd immer != NULL
-      return(error(ERR_WIN32_ERROR+GetLastError(), "SetTimer(hWnd=%p, timerId=%d, millis=%d) failed with %d", hWnd, s_timerId, millis, result));
+   uint result = SetTimer(hWnd, timerId, millis, (TIMERPROC)TimerCallback);
+   if (result != timerId)                             // mu stimmen, da hWnd immer != NULL
+      return(error(ERR_WIN32_ERROR+GetLastError(), "SetTimer(hWnd=%p, timerId=%d, millis=%d) failed with %d", hWnd, timerId, millis, result));
    //debug("SetTimer(hWnd=%d, timerId=%d, millis=%d) success", hWnd, timerId, millis);
 
    // Timerdaten speichern
-   TICK_TIMER_DATA ttd = {s_timerId, hWnd, flags};
+   TICK_TIMER_DATA ttd = {timerId, hWnd, flags};
    tickTimers.push_back(ttd);
 
-   return(s_timerId);
+   return(timerId);
    #pragma EXPANDER_EXPORT
 }
 
 
 /**
- * Deinstalliert einen mit SetupTickTimer() installierten Timer.
+ * Add the delay of a tick after its scheduled time to the jitter statistics of a timer. Called by the timer thread.
  *
- * @param  int timerId - ID des Timers, wie von SetupTickTimer() zurckgegeben.
+ * @param  HIGHRES_TICK_TIMER* timer
+ * @param  double              jitter - delay in microseconds
+ */
+void WINAPI recordJitter(HIGHRES_TICK_TIMER* timer, double jitter) {
+   timer->ticks++;
+   timer->sumJitter   += jitter;
+   timer->sumSqJitter += jitter * jitter;
+   if (jitter > timer->maxJitter) timer->maxJitter = jitter;
+
+   uint micros = (uint)jitter;                                       // bucket = number of significant bits of the microseconds
+   DWORD bucket = 0;
+   if (micros) {
+      _BitScanReverse(&bucket, micros);
+      bucket = std::min(bucket+1, (DWORD)TICK_JITTER_BUCKETS-1);
+   }
+   timer->jitters[bucket]++;
+}
+
+
+/**
+ * High-resolution timer thread. Sleeps on the waitable timer until the next tick of any timer is due and sends the due ticks.
+ * If the thread wakes up more than a period late the missed periods are skipped instead of sent in a burst, and the timer
+ * keeps its phase. Timers of destroyed windows are removed. The thread ends as soon as the last timer was removed. If the
+ * system timer resolution must be raised it's raised while timers are installed.
+ *
+ * @param  LPVOID arg - unused
+ *
+ * @return DWORD - 0
+ */
+DWORD WINAPI highResTimerWorker(LPVOID arg) {
+   std::vector<HIGHRES_TICK_TIMER*> timers;                          // the thread's copy of highResTimers
+   HANDLE handles[] = {hHighResWakeup, hHighResTimer};
+   BOOL periodRaised = FALSE;
+
+   for (;;) {
+      if (timers.empty() || highResTimersChanged) {                  // on start or if signaled
+         EnterCriticalSection(&g_terminalLock);
+         InterlockedExchange(&highResTimersChanged, FALSE);
+         for (int i=highResTimers.size()-1; i >= 0; i--) {          // release removed timers
+            if (highResTimers[i]->removed) {
+               delete highResTimers[i];
+               highResTimers.erase(highResTimers.begin() + i);
+            }
+         }
+         timers = highResTimers;
+         if (timers.empty()) highResActive = FALSE;                  // new timers start a new thread
+         LeaveCriticalSection(&g_terminalLock);
+
+         if (timers.empty()) break;
+         if (highResTimerPeriod && !periodRaised) {
+            periodRaised = (timeBeginPeriod(1) == TIMERR_NOERROR);
+         }
+      }
+
+      uint64 next = timers[0]->due;
+      for (uint i=1; i < timers.size(); i++) {
+         next = std::min(next, timers[i]->due);
+      }
+      LARGE_INTEGER now;
+      QueryPerformanceCounter(&now);
+      if ((uint64)now.QuadPart < next) {
+         LARGE_INTEGER dueTime;                                      // relative due time in 100 nanosecond intervals
+         dueTime.QuadPart = -(LONGLONG)std::max((next - now.QuadPart) * 10000000 / qpcFrequency, (uint64)1);
+         SetWaitableTimer(hHighResTimer, &dueTime, 0, NULL, NULL, FALSE);
+         WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+         continue;                                                   // the timer may fire slightly early, check again
+      }
+
+      for (uint i=0; i < timers.size(); i++) {
+         HIGHRES_TICK_TIMER* timer = timers[i];
+         if (timer->removed || timer->due > (uint64)now.QuadPart) continue;
+
+         if (!IsWindow(timer->hWnd)) {
+            warn(ERR_RUNTIME_ERROR, "removing tickTimer with id = %d (window hWnd = %p was destroyed)", timer->id, timer->hWnd);
+            timer->removed = TRUE;
+            InterlockedExchange(&highResTimersChanged, TRUE);
+            continue;
+         }
+         sendTick(timer->hWnd, timer->flags);
+         recordJitter(timer, (now.QuadPart - timer->due) * 1000000. / qpcFrequency);
+
+         timer->due += timer->period;
+         if (timer->due <= (uint64)now.QuadPart) {                   // skip missed periods
+            uint64 missed = (now.QuadPart - timer->due) / timer->period + 1;
+            timer->due    += missed * timer->period;
+            timer->missed += (uint)missed;
+         }
+      }
+   }
+
+   if (periodRaised) timeEndPeriod(1);
+   ExitWorkerThread();                                               // releases the DLL reference, doesn't return
+   return(0);
+}
+
+
+/**
+ * Create the waitable timer and the wakeup event of the high-resolution timer thread. Must be called with g_terminalLock held.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI createHighResTimerHandles() {
+   LARGE_INTEGER frequency;
+   if (!QueryPerformanceFrequency(&frequency)) return(error(ERR_WIN32_ERROR+GetLastError(), "QueryPerformanceFrequency() failed"));
+   qpcFrequency = frequency.QuadPart;
+
+   typedef HANDLE (WINAPI *CreateWaitableTimerExWFunc)(LPSECURITY_ATTRIBUTES, LPCWSTR, DWORD, DWORD);
+   CreateWaitableTimerExWFunc createWaitableTimerExW = (CreateWaitableTimerExWFunc)GetProcAddress(GetModuleHandleA("kernel32.dll"), "CreateWaitableTimerExW");
+   if (createWaitableTimerExW) {                                     // Vista and later
+      hHighResTimer = createWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+   }
+   highResTimerPeriod = !hHighResTimer;
+   if (!hHighResTimer) hHighResTimer = CreateWaitableTimer(NULL, FALSE, NULL);
+   if (!hHighResTimer)  return(error(ERR_WIN32_ERROR+GetLastError(), "CreateWaitableTimer() failed"));
+
+   hHighResWakeup = CreateEvent(NULL, FALSE, FALSE, NULL);
+   if (!hHighResWakeup) {
+      error(ERR_WIN32_ERROR+GetLastError(), "CreateEvent() failed");
+      CloseHandle(hHighResTimer);
+      hHighResTimer = NULL;
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/**
+ * Start the high-resolution timer thread if it isn't running. Uses a high-resolution waitable timer if supported by the system.
+ * Otherwise the thread raises the system timer resolution to 1 millisecond while timers are installed. Must be called with
+ * g_terminalLock held.
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI startHighResTimerThread() {
+   if (highResActive) return(TRUE);
+   if (hHighResThread) {                                             // a previous thread which ended when idle
+      CloseHandle(hHighResThread);
+      hHighResThread = NULL;
+   }
+   if (!hHighResTimer && !createHighResTimerHandles()) return(FALSE);
+
+   hHighResThread = CreateWorkerThread(highResTimerWorker, NULL);
+   if (!hHighResThread) return(FALSE);
+
+   SetThreadPriority(hHighResThread, THREAD_PRIORITY_TIME_CRITICAL);
+   highResActive = TRUE;
+   return(TRUE);
+}
+
+
+/**
+ * Install a high-resolution timer sending synthetic ticks to a window. Other than SetupTickTimer() the ticks are sent by a
+ * dedicated thread instead of WM_TIMER messages, so they are neither limited to the 10-16 msec resolution of the system timer
+ * nor delayed by a busy message queue. The sent messages are the same. Use GetTickTimerStats() to query the actual jitter.
+ *
+ * @param  HWND  hWnd   - window to send the ticks to
+ * @param  int   millis - tick period in milliseconds
+ * @param  DWORD flags  - tick flags as for SetupTickTimer() (default: none)
+ *
+ * @return uint - timer id to pass to RemoveTickTimer() or 0 in case of errors
+ */
+uint WINAPI SetupHighResTickTimer(HWND hWnd, int millis, DWORD flags/*=NULL*/) {
+   if (!IsWindow(hWnd))                                   return(error(ERR_INVALID_PARAMETER, "invalid parameter hWnd = %p (not a window)", hWnd));
+   if (millis <= 0)                                       return(error(ERR_INVALID_PARAMETER, "invalid parameter millis = %d", millis));
+   if (flags & TICK_CHART_REFRESH && flags & TICK_TESTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter flags combination: TICK_CHART_REFRESH & TICK_TESTER"));
+   if (flags & TICK_PAUSE_ON_WEEKEND)                     warn(ERR_NOT_IMPLEMENTED, "flag TICK_PAUSE_ON_WEEKEND not yet implemented");
+   MT4InternalMsg();                                                 // register the message outside of the timer thread
+
+   EnterCriticalSection(&g_terminalLock);
+   if (!startHighResTimerThread()) {
+      LeaveCriticalSection(&g_terminalLock);
+      return(NULL);
+   }
+   HIGHRES_TICK_TIMER* timer = new HIGHRES_TICK_TIMER();
+   ZeroMemory(timer, sizeof(HIGHRES_TICK_TIMER));
+   timer->id     = InterlockedIncrement(&lastTickTimerId);
+   timer->hWnd   = hWnd;
+   timer->flags  = flags;
+   timer->millis = millis;
+   timer->period = qpcFrequency * millis / 1000;
+
+   LARGE_INTEGER now;
+   QueryPerformanceCounter(&now);
+   timer->due = now.QuadPart + timer->period;
+
+   highResTimers.push_back(timer);
+   InterlockedExchange(&highResTimersChanged, TRUE);
+   SetEvent(hHighResWakeup);
+   LeaveCriticalSection(&g_terminalLock);
+   return(timer->id);
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Deinstalliert einen mit SetupTickTimer() oder SetupHighResTickTimer() installierten Timer.
+ *
+ * @param  int timerId - ID des Timers, wie von SetupTickTimer() oder SetupHighResTickTimer() zurckgegeben.
  *
  * @return BOOL - Erfolgsstatus
  */
@@ -131,6 +380,19 @@ BOOL WINAPI RemoveTickTimer(int timerId) {
       }
    }
 
+   EnterCriticalSection(&g_terminalLock);                            // high-resolution timers are released by the timer thread
+   BOOL found = FALSE;
+   for (uint i=0; i < highResTimers.size(); i++) {
+      if (highResTimers[i]->id == timerId && !highResTimers[i]->removed) {
+         highResTimers[i]->removed = found = TRUE;
+         InterlockedExchange(&highResTimersChanged, TRUE);
+         SetEvent(hHighResWakeup);
+         break;
+      }
+   }
+   LeaveCriticalSection(&g_terminalLock);
+   if (found) return(TRUE);
+
    return(error(ERR_RUNTIME_ERROR, "timer not found: id = %d", timerId));
    #pragma EXPANDER_EXPORT
 }
@@ -148,4 +410,58 @@ void WINAPI RemoveTickTimers() {
       warn(NO_ERROR, "removing orphaned tickTimer with id = %d", id);
       RemoveTickTimer(id);
    }
+
+   // The high-resolution timer thread can't be running at this point: it holds a reference to the DLL, so the DLL is unloaded
+   // either by the thread's own exit (no timers are left) or on process termination (where cleanup is skipped).
+   for (uint i=0; i < highResTimers.size(); i++) {
+      delete highResTimers[i];
+   }
+   highResTimers.clear();
+   if (hHighResThread) CloseHandle(hHighResThread);
+   if (hHighResWakeup) CloseHandle(hHighResWakeup);
+   if (hHighResTimer)  CloseHandle(hHighResTimer);
+   hHighResThread = hHighResWakeup = hHighResTimer = NULL;
+   highResActive  = FALSE;
+}
+
+
+/**
+ * Return the jitter statistics of a high-resolution tick timer. The statistics are updated by the timer thread without
+ * locking and may lag behind by a tick.
+ *
+ * @param  int               timerId - timer id as returned by SetupHighResTickTimer()
+ * @param  TICK_TIMER_STATS* stats   - struct receiving the statistics
+ *
+ * @return BOOL - success status
+ */
+BOOL WINAPI GetTickTimerStats(int timerId, TICK_TIMER_STATS* stats) {
+   if ((uint)stats < MIN_VALID_POINTER) return(error(ERR_INVALID_PARAMETER, "invalid parameter stats = 0x%p (not a valid pointer)", stats));
+
+   EnterCriticalSection(&g_terminalLock);
+   const HIGHRES_TICK_TIMER* timer = NULL;
+   for (uint i=0; i < highResTimers.size(); i++) {
+      if (highResTimers[i]->id == timerId && !highResTimers[i]->removed) {
+         timer = highResTimers[i];
+         break;
+      }
+   }
+   if (timer) {
+      uint ticks = timer->ticks;
+      double mean = ticks ? timer->sumJitter / ticks : 0;
+      double variance = ticks ? timer->sumSqJitter / ticks - mean * mean : 0;
+
+      stats->timerId      = timer->id;
+      stats->period       = timer->millis;
+      stats->ticks        = ticks;
+      stats->missed       = timer->missed;
+      stats->meanJitter   = mean;
+      stats->stdDevJitter = (variance > 0) ? sqrt(variance) : 0;
+      stats->maxJitter    = timer->maxJitter;
+      memcpy(stats->jitters, timer->jitters, sizeof(stats->jitters));
+   }
+   LeaveCriticalSection(&g_terminalLock);
+
+   if (!timer) return(error(ERR_INVALID_PARAMETER, "invalid parameter timerId = %d (not a high-resolution timer)", timerId));
+   return(TRUE);
+   #pragma EXPANDER_EXPORT
 }
@@ -2,6 +2,42 @@
 #include "util/format.h"
 
 
+/**
+ * Return a description of a Strategy Tester bar model.
+ *
+ * @param  int model - bar model id
+ *
+ * @return char* - description or NULL if the parameter is invalid
+ */
+const char* WINAPI BarModelDescription(int model) {
+   switch (model) {
+      case BM_EVERYTICK:     return("EveryTick"    );
+      case BM_CONTROLPOINTS: return("ControlPoints");
+      case BM_BAROPEN:       return("BarOpen"      );
+   }
+   return((char*)error(ERR_INVALID_PARAMETER, "invalid parameter model: %d (not a bar model)", model));
+   #pragma EXPANDER_EXPORT
+}
+
+
+/**
+ * Return a readable version of a Strategy Tester bar model.
+ *
+ * @param  int model - bar model id
+ *
+ * @return char* - readable version or NULL if the parameter is invalid
+ */
+const char* WINAPI BarModelToStr(int model) {
+   switch (model) {
+      case BM_EVERYTICK:     return("BM_EVERYTICK"    );
+      case BM_CONTROLPOINTS: return("BM_CONTROLPOINTS");
+      case BM_BAROPEN:       return("BM_BAROPEN"      );
+   }
+   return((char*)error(ERR_INVALID_PARAMETER, "invalid parameter model: %d (not a bar model)", model));
+   #pragma EXPANDER_EXPORT
+}
+
+
 /**
  * Convert a BOOL value to the string "TRUE" or "FALSE".
  *